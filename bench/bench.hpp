@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+#include <limits>
+
+namespace bench
+{
+    /// Runs FN ITERATIONS times and returns the fastest run in milliseconds.
+    template <typename F>
+    double Measure(int iterations, F fn)
+    {
+        auto best = std::numeric_limits<double>::max();
+        for (int i = 0; i < iterations; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+}
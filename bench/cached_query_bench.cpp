@@ -0,0 +1,88 @@
+// Running the same query every tick while few entities change, by scanning and by a cached query.
+//
+// Half of entities are on fire and half are wet, but few are both, so scans visit many entities per match.
+//
+// usage: cached_query_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Burning
+{
+    int ticks;
+};
+
+struct Wet
+{
+    int ticks;
+};
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+        {
+            auto name = backend == bent::StorageBackend::ComponentPools ? "pools" : "archetypes";
+            auto layout_name = layout == bent::MaskLayout::Rows ? "rows" : "columns";
+            bent::World world(backend, layout);
+            std::vector<bent::EntityHandle> handles;
+            world.Create(entities, std::back_inserter(handles));
+            for (std::size_t i = 0; i < handles.size(); i++)
+            {
+                if (i % 2 == 0 || i % 100 == 1)
+                {
+                    handles[i].Add<Burning>(Burning { 0 });
+                }
+                if (i % 2 == 1)
+                {
+                    handles[i].Add<Wet>(Wet { 0 });
+                }
+            }
+
+            // 0.1% of entities dry up or get wet again each tick.
+            std::size_t tick = 0;
+            auto churn = [&]
+            {
+                for (std::size_t i = tick++ % 1000 * 2 + 1; i < handles.size(); i += 2000)
+                {
+                    if (handles[i].Get<Wet>())
+                    {
+                        handles[i].Remove<Wet>();
+                    }
+                    else
+                    {
+                        handles[i].Add<Wet>(Wet { 0 });
+                    }
+                }
+            };
+            auto system = [](bent::EntityHandle, Burning& burning, Wet& wet)
+            {
+                ++burning.ticks;
+                ++wet.ticks;
+            };
+
+            auto churn_scanned = bench::Measure(5, churn);
+            auto scan = bench::Measure(5, [&]
+            {
+                world.query<bent::With<Burning, Wet>>().each(system);
+            });
+            auto query = world.cached_query<bent::With<Burning, Wet>>();
+            auto churn_cached = bench::Measure(5, churn);
+            auto cache = bench::Measure(5, [&]
+            {
+                query.each(system);
+            });
+            std::printf("%s, %s (%zu matches): scan %.3f ms, cached %.3f ms; churn %.3f ms, with cache %.3f ms\n",
+                name, layout_name, query.count(), scan, cache, churn_scanned, churn_cached);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+// Reacting to changed components each tick, by a Changed query and by visiting every entity.
+//
+// 3% of entities are written each tick, in runs of neighbouring entities, so most blocks of 64 entities are skipped.
+//
+// usage: change_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Transform
+{
+    float x, y;
+};
+
+struct Bounds
+{
+    float x, y;
+};
+
+namespace bent
+{
+    template <>
+    struct ComponentChanges<Transform>
+    {
+        using type = TrackedChanges;
+    };
+}
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+        {
+            auto name = backend == bent::StorageBackend::ComponentPools ? "pools" : "archetypes";
+            auto layout_name = layout == bent::MaskLayout::Rows ? "rows" : "columns";
+            bent::World world(backend, layout);
+            std::vector<bent::EntityHandle> handles;
+            world.Create(entities, std::back_inserter(handles));
+            for (std::size_t i = 0; i < handles.size(); i++)
+            {
+                handles[i].Add<Transform>(Transform { float(i), 0.0f });
+                handles[i].Add<Bounds>(Bounds { 0.0f, 0.0f });
+            }
+
+            std::size_t tick = 0;
+            auto last_run = world.Tick();
+            auto move = [&]
+            {
+                for (std::size_t block = tick++ % 32; block * 64 < handles.size(); block += 32)
+                {
+                    for (auto i = block * 64; i < std::min(handles.size(), block * 64 + 64); i++)
+                    {
+                        handles[i].Get<Transform>()->y += 1.0f;
+                    }
+                }
+            };
+            auto update = [](bent::EntityHandle, Transform& transform, Bounds& bounds)
+            {
+                bounds.x = transform.x + 1.0f;
+                bounds.y = transform.y + 1.0f;
+            };
+
+            std::size_t changed = 0;
+            auto reacting = bench::Measure(5, [&]
+            {
+                move();
+                world.query<bent::With<Transform, Bounds>, bent::Changed<Transform>>(last_run).each(update);
+                last_run = world.Tick();
+            });
+            move();
+            changed = world.query<bent::Changed<Transform>>(last_run).count();
+            auto all = bench::Measure(5, [&]
+            {
+                move();
+                world.query<bent::With<Transform, Bounds>>().each(update);
+            });
+            auto moving = bench::Measure(5, move);
+            std::printf("%s, %s (%zu changed): changed %.3f ms, all %.3f ms; moving alone %.3f ms\n",
+                name, layout_name, changed, reacting - moving, all - moving, moving);
+        }
+    }
+}
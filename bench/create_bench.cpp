@@ -0,0 +1,60 @@
+// Spawning entities with a Position each, one by one and in bulk.
+//
+// usage: create_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    Position(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 500000;
+
+    auto one_by_one = bench::Measure(5, [&]
+    {
+        bent::World world;
+        for (std::size_t i = 0; i < entities; i++)
+        {
+            world.Create().Add<Position>(0.0f, 0.0f);
+        }
+    });
+    std::printf("Create one by one: %.2f ms\n", one_by_one);
+
+    auto bulk = bench::Measure(5, [&]
+    {
+        bent::World world;
+        std::vector<bent::EntityHandle> handles;
+        handles.reserve(entities);
+        world.Create(entities, std::back_inserter(handles));
+        for (auto& entity : handles)
+        {
+            entity.Add<Position>(0.0f, 0.0f);
+        }
+    });
+    std::printf("Create in bulk: %.2f ms\n", bulk);
+
+    auto reserved = bench::Measure(5, [&]
+    {
+        bent::World world;
+        world.Reserve<Position>(entities);
+        std::vector<bent::EntityHandle> handles;
+        handles.reserve(entities);
+        world.Create(entities, std::back_inserter(handles));
+        for (auto& entity : handles)
+        {
+            entity.Add<Position>(0.0f, 0.0f);
+        }
+    });
+    std::printf("Create in bulk after Reserve: %.2f ms\n", reserved);
+}
@@ -0,0 +1,78 @@
+// Despawning entities with a few components each, one by one and in bulk.
+//
+// usage: destroy_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    Position(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+struct Velocity
+{
+    Velocity(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+struct Name
+{
+    std::string value;
+};
+
+static std::vector<bent::EntityHandle> Spawn(bent::World & world, std::size_t entities)
+{
+    std::vector<bent::EntityHandle> handles;
+    world.Create(entities, std::back_inserter(handles));
+    for (auto& entity : handles)
+    {
+        entity.Add<Position>(0.0f, 0.0f);
+        entity.Add<Velocity>(0.0f, 0.0f);
+        entity.Add<Name>();
+    }
+    return handles;
+}
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 500000;
+
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        auto name = backend == bent::StorageBackend::ComponentPools ? "pools" : "archetypes";
+        bent::World world(backend);
+
+        double one_by_one = 0.0;
+        double bulk = 0.0;
+        for (int i = 0; i < 5; i++)
+        {
+            auto handles = Spawn(world, entities);
+            auto time = bench::Measure(1, [&]
+            {
+                for (auto& entity : handles)
+                {
+                    entity.Destroy();
+                }
+            });
+            one_by_one = i == 0 ? time : std::min(one_by_one, time);
+
+            handles = Spawn(world, entities);
+            time = bench::Measure(1, [&]
+            {
+                world.Destroy(handles);
+            });
+            bulk = i == 0 ? time : std::min(bulk, time);
+        }
+        std::printf("%s Destroy one by one: %.2f ms\n", name, one_by_one);
+        std::printf("%s Destroy in bulk: %.2f ms\n", name, bulk);
+    }
+}
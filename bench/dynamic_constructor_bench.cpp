@@ -0,0 +1,63 @@
+// Relocating and destroying blocks of components through DynamicConstructorInterface, an object per call and a block per call.
+//
+// usage: dynamic_constructor_bench [objects]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Transform
+{
+    float x, y, z, w;
+};
+
+template <typename T>
+void Run(const char * name, std::size_t count, const T & value)
+{
+    auto & constructor = bent::ComponentManager::instance().dynamic_constructor(bent::ComponentManager::instance().id<T>());
+    std::allocator<T> alloc;
+    auto from = alloc.allocate(count);
+    auto to = alloc.allocate(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        new (from + i) T(value);
+    }
+
+    // relocates back and forth, so FROM holds objects after each run.
+    auto each = bench::Measure(5, [&]
+    {
+        for (std::size_t i = 0; i < count; i++)
+        {
+            constructor.MoveConstruct(to + i, from + i);
+            constructor.Destroy(from + i);
+        }
+        for (std::size_t i = 0; i < count; i++)
+        {
+            constructor.MoveConstruct(from + i, to + i);
+            constructor.Destroy(to + i);
+        }
+    });
+    auto bulk = bench::Measure(5, [&]
+    {
+        constructor.Relocate(to, from, count);
+        constructor.Relocate(from, to, count);
+    });
+    std::printf("%s: move and destroy each %.3f ms, relocate blocks %.3f ms\n", name, each, bulk);
+
+    constructor.Destroy(from, count);
+    alloc.deallocate(from, count);
+    alloc.deallocate(to, count);
+}
+
+int main(int argc, char * argv [])
+{
+    std::size_t count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    Run("trivially copyable", count, Transform { 0.0f, 0.0f, 0.0f, 1.0f });
+    Run("string", count, std::string("entity"));
+}
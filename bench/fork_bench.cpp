@@ -0,0 +1,78 @@
+// Forking a world for speculative simulation, then changing a few entities in the fork.
+//
+// Every entity has a position and a velocity; each fork moves 1% of entities.
+//
+// usage: fork_bench [entities] [forks]
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    float x, y;
+};
+
+struct Velocity
+{
+    float x, y;
+};
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::size_t forks = argc > 2 ? std::atoi(argv[2]) : 16;
+
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        auto name = backend == bent::StorageBackend::ComponentPools ? "pools" : "archetypes";
+        bent::World world(backend);
+        std::vector<bent::EntityHandle> handles;
+        world.Create(entities, std::back_inserter(handles));
+        for (auto & handle : handles)
+        {
+            handle.Add<Position>(Position { 0.0f, 0.0f });
+            handle.Add<Velocity>(Velocity { 1.0f, 1.0f });
+        }
+
+        std::vector<std::unique_ptr<bent::World>> worlds(forks);
+        auto fork = bench::Measure(5, [&]
+        {
+            for (auto & forked : worlds)
+            {
+                forked = world.Fork();
+            }
+        });
+        auto simulate = bench::Measure(5, [&]
+        {
+            for (auto & forked : worlds)
+            {
+                forked = world.Fork();
+                for (std::size_t i = 0; i < handles.size(); i += 100)
+                {
+                    auto entity = forked->entity(handles[i].id());
+                    auto velocity = entity.Get<Velocity>();
+                    auto position = entity.Get<Position>();
+                    position->x += velocity->x;
+                    position->y += velocity->y;
+                }
+            }
+        });
+        auto each = bench::Measure(5, [&]
+        {
+            world.each<Position, Velocity>([](bent::EntityHandle, Position& pos, Velocity& vel)
+            {
+                pos.x += vel.x;
+                pos.y += vel.y;
+            });
+        });
+        std::printf("%s: %zu forks %.3f ms (%.3f ms each); forking and moving 1%% %.3f ms; each over the origin %.3f ms\n",
+            name, forks, fork, fork / forks, simulate, each);
+    }
+}
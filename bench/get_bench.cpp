@@ -0,0 +1,63 @@
+// EntityHandle::Get<T>() over entities having a Position and a Velocity each.
+//
+// usage: get_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    Position(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+struct Velocity
+{
+    Velocity(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    bent::World world;
+    std::vector<bent::EntityHandle> handles;
+    world.Create(entities, std::back_inserter(handles));
+    for (auto& entity : handles)
+    {
+        entity.Add<Position>(0.0f, 0.0f);
+        entity.Add<Velocity>(1.0f, 1.0f);
+    }
+
+    auto get = bench::Measure(5, [&]
+    {
+        for (auto& entity : handles)
+        {
+            auto pos = entity.Get<Position>();
+            auto vel = entity.Get<Velocity>();
+            pos->x += vel->x;
+            pos->y += vel->y;
+        }
+    });
+    std::printf("Get<T>: %.2f ms (%.2f ns per call)\n", get, get * 1e6 / (entities * 2));
+
+    auto id = bench::Measure(5, [&]
+    {
+        std::uint32_t sum = 0;
+        for (std::size_t i = 0; i < entities; i++)
+        {
+            sum += bent::ComponentManager::instance().id<Position>();
+            sum += bent::ComponentManager::instance().id<Velocity>();
+        }
+        volatile std::uint32_t sink = sum;
+        (void) sink;
+    });
+    std::printf("id<T>: %.2f ms (%.2f ns per call)\n", id, id * 1e6 / (entities * 2));
+}
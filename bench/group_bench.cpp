@@ -0,0 +1,78 @@
+// Moving entities by `World::each` over packed pools, and by a group owning them.
+//
+// usage: group_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    float x, y;
+};
+
+struct Velocity
+{
+    float x, y;
+};
+
+namespace bent
+{
+    template <>
+    struct ComponentStorage<Position>
+    {
+        using type = PackedComponentPool<Position>;
+    };
+
+    template <>
+    struct ComponentStorage<Velocity>
+    {
+        using type = PackedComponentPool<Velocity>;
+    };
+}
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    bent::World world;
+    std::vector<bent::EntityHandle> handles;
+    world.Create(entities, std::back_inserter(handles));
+    for (std::size_t i = 0; i < handles.size(); i++)
+    {
+        // positions and velocities were added in different orders, so their pools don't line up.
+        handles[i].Add<Position>(Position { 0.0f, 0.0f });
+        if (i % 4 != 0)
+        {
+            handles[handles.size() - 1 - i].Add<Velocity>(Velocity { 1.0f, 1.0f });
+        }
+    }
+
+    auto each = bench::Measure(5, [&]
+    {
+        world.each<Position, Velocity>([](bent::EntityHandle, Position& pos, Velocity& vel)
+        {
+            pos.x += vel.x;
+            pos.y += vel.y;
+        });
+    });
+    auto grouping = bench::Measure(1, [&]
+    {
+        world.group<Position, Velocity>();
+    });
+    auto group = world.group<Position, Velocity>();
+    auto owned = bench::Measure(5, [&]
+    {
+        group.each([](Position& pos, Velocity& vel)
+        {
+            pos.x += vel.x;
+            pos.y += vel.y;
+        });
+    });
+    std::printf("%zu moving entities: each %.2f ms, group %.2f ms (grouped in %.2f ms)\n", group.size(), each, owned, grouping);
+}
@@ -0,0 +1,100 @@
+// Keeping an external index of entities having a component, by batched observers and by a callback per addition.
+//
+// Each iteration adds the component to every entity and removes it again.
+//
+// usage: observer_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <iterator>
+#include <functional>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Plain
+{
+    float x, y;
+};
+
+struct Body
+{
+    float x, y;
+};
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        auto name = backend == bent::StorageBackend::ComponentPools ? "pools" : "archetypes";
+        // slots of entities having bodies, by entity index.
+        std::vector<std::uint32_t> index(entities);
+
+        bent::World plain(backend);
+        std::vector<bent::EntityHandle> handles;
+        plain.Create(entities, std::back_inserter(handles));
+        std::function<void(std::uint64_t)> on_add = [&](std::uint64_t id) { index[std::uint32_t(id)] = std::uint32_t(id >> 32) + 1; };
+        std::function<void(std::uint64_t)> on_remove = [&](std::uint64_t id) { index[std::uint32_t(id)] = 0; };
+        auto wrapped = bench::Measure(5, [&]
+        {
+            for (auto & handle : handles)
+            {
+                handle.Add<Body>(Body { 0.0f, 0.0f });
+                on_add(handle.id());
+            }
+            for (auto & handle : handles)
+            {
+                handle.Remove<Body>();
+                on_remove(handle.id());
+            }
+        });
+
+        bent::World observed(backend);
+        handles.clear();
+        observed.Create(entities, std::back_inserter(handles));
+        observed.Observe<Body>(bent::ComponentEvent::Add, [&](const std::uint64_t * ids, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                index[std::uint32_t(ids[i])] = std::uint32_t(ids[i] >> 32) + 1;
+            }
+        });
+        observed.Observe<Body>(bent::ComponentEvent::Remove, [&](const std::uint64_t * ids, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                index[std::uint32_t(ids[i])] = 0;
+            }
+        });
+        auto batched = bench::Measure(5, [&]
+        {
+            for (auto & handle : handles)
+            {
+                handle.Add<Body>(Body { 0.0f, 0.0f });
+            }
+            observed.NotifyObservers();
+            for (auto & handle : handles)
+            {
+                handle.Remove<Body>();
+            }
+            observed.NotifyObservers();
+        });
+        auto unobserved = bench::Measure(5, [&]
+        {
+            for (auto & handle : handles)
+            {
+                handle.Add<Plain>(Plain { 0.0f, 0.0f });
+            }
+            for (auto & handle : handles)
+            {
+                handle.Remove<Plain>();
+            }
+        });
+        std::printf("%s: callback per event %.3f ms, batched %.3f ms, unobserved component %.3f ms\n", name, wrapped, batched, unobserved);
+    }
+}
@@ -0,0 +1,70 @@
+// Scaling of Position += Velocity over 10M entities, from 1 to N threads.
+//
+// usage: parallel_each_bench [entities] [max threads]
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    Position(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+struct Velocity
+{
+    Velocity(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+static void Run(const char * name, bent::World & world, std::size_t max_threads)
+{
+    auto serial = bench::Measure(5, [&]
+    {
+        world.each<Position, Velocity>([](bent::EntityHandle, Position& pos, Velocity& vel)
+        {
+            pos.x += vel.x;
+            pos.y += vel.y;
+        });
+    });
+    std::printf("%s each: %.2f ms\n", name, serial);
+
+    for (std::size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        bent::ThreadPool::instance().Resize(threads);
+        auto parallel = bench::Measure(5, [&]
+        {
+            world.parallel_each<Position, Velocity>([](bent::EntityHandle, Position& pos, Velocity& vel)
+            {
+                pos.x += vel.x;
+                pos.y += vel.y;
+            });
+        });
+        std::printf("%s parallel_each, %2zu threads: %.2f ms (x%.2f)\n", name, threads, parallel, serial / parallel);
+    }
+}
+
+int main(int argc, char * argv [])
+{
+    std::uint32_t entities = argc > 1 ? std::atoi(argv[1]) : 10000000;
+    std::size_t max_threads = argc > 2 ? std::atoi(argv[2]) : bent::ThreadPool::default_concurrency();
+
+    bent::World pools;
+    bent::World archetypes(bent::StorageBackend::Archetypes);
+    for (auto world : { &pools, &archetypes })
+    {
+        for (std::uint32_t i = 0; i < entities; i++)
+        {
+            auto entity = world->Create();
+            entity.Add<Position>(0.0f, 0.0f);
+            entity.Add<Velocity>(1.0f, 1.0f);
+        }
+    }
+
+    Run("pools", pools, max_threads);
+    Run("archetypes", archetypes, max_threads);
+}
@@ -0,0 +1,79 @@
+// Iterating entities without a component by filtering in the loop body, and by `Without` in the query.
+//
+// usage: query_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    float x, y;
+};
+
+struct Velocity
+{
+    float x, y;
+};
+
+struct Frozen
+{
+    int since;
+};
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+        {
+            auto name = backend == bent::StorageBackend::ComponentPools ? "pools" : "archetypes";
+            auto layout_name = layout == bent::MaskLayout::Rows ? "rows" : "columns";
+            bent::World world(backend, layout);
+            std::vector<bent::EntityHandle> handles;
+            world.Create(entities, std::back_inserter(handles));
+            for (std::size_t i = 0; i < handles.size(); i++)
+            {
+                handles[i].Add<Position>(Position { 0.0f, 0.0f });
+                handles[i].Add<Velocity>(Velocity { 1.0f, 1.0f });
+                // most entities are frozen, so filtering in the body visits them for nothing.
+                if (i % 8 != 0)
+                {
+                    handles[i].Add<Frozen>(Frozen { 0 });
+                }
+            }
+
+            std::size_t filtered = 0, excluded = 0;
+            auto filter = bench::Measure(5, [&]
+            {
+                filtered = 0;
+                world.each<Position, Velocity>([&](bent::EntityHandle entity, Position& pos, Velocity& vel)
+                {
+                    if (entity.Get<Frozen>() == nullptr)
+                    {
+                        pos.x += vel.x;
+                        ++filtered;
+                    }
+                });
+            });
+            auto without = bench::Measure(5, [&]
+            {
+                excluded = 0;
+                world.query<bent::With<Position, Velocity>, bent::Without<Frozen>>().each([&](bent::EntityHandle, Position& pos, Velocity& vel)
+                {
+                    pos.x += vel.x;
+                    ++excluded;
+                });
+            });
+            std::printf("%s, %s (%zu/%zu entities): Get<Frozen>() == nullptr %.2f ms, Without<Frozen> %.2f ms\n",
+                name, layout_name, filtered, excluded, filter, without);
+        }
+    }
+}
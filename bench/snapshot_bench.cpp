@@ -0,0 +1,106 @@
+// Restoring a checkpointed world from a snapshot, against rebuilding it entity by entity.
+//
+// Every entity has a position and a velocity, and every tenth a tag.
+// Loading maps blocks of components in place, so the first pass over them after loading pays for reading the file.
+//
+// usage: snapshot_bench [entities] [path]
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    float x, y;
+};
+
+struct Velocity
+{
+    float x, y;
+};
+
+struct Frozen
+{
+};
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 10000000;
+    const char * path = argc > 2 ? argv[2] : "snapshot_bench.snapshot";
+
+    bent::RegisterComponent<Position>("Position");
+    bent::RegisterComponent<Velocity>("Velocity");
+    bent::RegisterComponent<Frozen>("Frozen");
+
+    bent::World world;
+    std::vector<bent::EntityHandle> handles;
+    world.Create(entities, std::back_inserter(handles));
+    for (std::size_t i = 0; i < handles.size(); i++)
+    {
+        handles[i].Add<Position>(Position { float(i), 0.0f });
+        handles[i].Add<Velocity>(Velocity { 1.0f, 1.0f });
+        if (i % 10 == 0)
+        {
+            handles[i].Add<Frozen>();
+        }
+    }
+
+    auto save = bench::Measure(3, [&]
+    {
+        world.SaveSnapshot(path);
+    });
+
+    std::unique_ptr<bent::World> loaded;
+    auto load = bench::Measure(5, [&]
+    {
+        loaded.reset();
+        loaded.reset(new bent::World);
+        loaded->LoadSnapshot(path);
+    });
+    auto first_each = bench::Measure(1, [&]
+    {
+        loaded->each<Position, Velocity>([](bent::EntityHandle, Position& pos, Velocity& vel)
+        {
+            pos.x += vel.x;
+            pos.y += vel.y;
+        });
+    });
+    auto each = bench::Measure(5, [&]
+    {
+        loaded->each<Position, Velocity>([](bent::EntityHandle, Position& pos, Velocity& vel)
+        {
+            pos.x += vel.x;
+            pos.y += vel.y;
+        });
+    });
+    loaded.reset();
+
+    // what restoring took before: walking the entities and adding every component again.
+    std::unique_ptr<bent::World> rebuilt;
+    auto rebuild = bench::Measure(3, [&]
+    {
+        rebuilt.reset();
+        rebuilt.reset(new bent::World);
+        std::vector<bent::EntityHandle> created;
+        rebuilt->Create(handles.size(), std::back_inserter(created));
+        for (std::size_t i = 0; i < created.size(); i++)
+        {
+            created[i].Add<Position>(*handles[i].Get<Position>());
+            created[i].Add<Velocity>(*handles[i].Get<Velocity>());
+            if (handles[i].Get<Frozen>())
+            {
+                created[i].Add<Frozen>();
+            }
+        }
+    });
+    std::remove(path);
+
+    std::printf("%zu entities: save %.3f ms, load %.3f ms (first each %.3f ms, then %.3f ms); rebuilding by Add %.3f ms\n",
+        entities, save, load, first_each, each, rebuild);
+}
@@ -0,0 +1,95 @@
+// Visiting sprites in depth order every frame while a few of them move:
+// by sorting copied handles, and by sorting the packed pool in place.
+//
+// usage: sort_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Sprite
+{
+    float depth;
+    float x, y;
+};
+
+namespace bent
+{
+    template <>
+    struct ComponentStorage<Sprite>
+    {
+        using type = PackedComponentPool<Sprite>;
+    };
+}
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    bent::World world;
+    std::vector<bent::EntityHandle> handles;
+    world.Create(entities, std::back_inserter(handles));
+    for (std::size_t i = 0; i < handles.size(); i++)
+    {
+        handles[i].Add<Sprite>(Sprite { float(i * 7919 % entities), 0.0f, 0.0f });
+    }
+    auto by_depth = [](const Sprite & lhs, const Sprite & rhs)
+    {
+        return lhs.depth < rhs.depth;
+    };
+
+    // 1% of sprites change depth by a little each frame.
+    std::size_t frame = 0;
+    auto move = [&]
+    {
+        for (std::size_t i = frame++ % 100; i < handles.size(); i += 100)
+        {
+            handles[i].Get<Sprite>()->depth += (i % 2 == 0 ? 3.5f : -3.5f);
+        }
+    };
+
+    float sum = 0;
+    auto copied = bench::Measure(10, [&]
+    {
+        move();
+        std::vector<bent::EntityHandle> sorted;
+        for (auto& entity : world.entities_with<Sprite>())
+        {
+            sorted.push_back(entity);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](bent::EntityHandle & lhs, bent::EntityHandle & rhs)
+        {
+            return lhs.Get<Sprite>()->depth < rhs.Get<Sprite>()->depth;
+        });
+        for (auto& entity : sorted)
+        {
+            sum += entity.Get<Sprite>()->x;
+        }
+    });
+    world.sort<Sprite>(by_depth);
+    auto standard = bench::Measure(10, [&]
+    {
+        move();
+        world.sort<Sprite>(by_depth);
+        world.each<Sprite>([&](bent::EntityHandle, Sprite& sprite)
+        {
+            sum += sprite.x;
+        });
+    });
+    auto insertion = bench::Measure(10, [&]
+    {
+        move();
+        world.sort<Sprite>(by_depth, bent::SortAlgorithm::Insertion);
+        world.each<Sprite>([&](bent::EntityHandle, Sprite& sprite)
+        {
+            sum += sprite.x;
+        });
+    });
+    std::printf("%zu sprites (%g): sorted handles %.2f ms, sort<Sprite> %.2f ms, insertion %.2f ms\n", entities, sum, copied, standard, insertion);
+}
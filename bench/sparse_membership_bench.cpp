@@ -0,0 +1,91 @@
+// Querying a component a handful of entities spread over a large index space have,
+// with dense membership and with compressed membership.
+//
+// usage: sparse_membership_bench [entities] [owners]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Tagged
+{
+    int value;
+};
+
+struct DenseMarker
+{
+    int value;
+};
+
+struct CompressedMarker
+{
+    int value;
+};
+
+namespace bent
+{
+    template <>
+    struct ComponentMembership<CompressedMarker>
+    {
+        using type = CompressedMembership;
+    };
+}
+
+template <typename Marker>
+static void Run(bent::World & world, const char * layout, const char * name)
+{
+    std::size_t found = 0;
+    auto view = bench::Measure(5, [&]
+    {
+        found = 0;
+        for (auto& entity : world.entities_with<Tagged, Marker>())
+        {
+            (void) entity;
+            ++found;
+        }
+    });
+    auto each = bench::Measure(5, [&]
+    {
+        found = 0;
+        world.each<Tagged, Marker>([&](bent::EntityHandle, Tagged&, Marker&)
+        {
+            ++found;
+        });
+    });
+    auto count = bench::Measure(5, [&]
+    {
+        found = world.count<Tagged, Marker>();
+    });
+    std::printf("%s %s (%zu entities): entities_with %.3f ms, each %.3f ms, count %.3f ms\n", layout, name, found, view, each, count);
+}
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 30000000;
+    std::size_t owners = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+    {
+        auto name = layout == bent::MaskLayout::Rows ? "rows" : "columns";
+        bent::World world(bent::StorageBackend::ComponentPools, layout);
+        std::vector<bent::EntityHandle> handles;
+        world.Create(entities, std::back_inserter(handles));
+        for (std::size_t i = 0; i < handles.size(); i += 2)
+        {
+            handles[i].Add<Tagged>(Tagged { 1 });
+        }
+        for (std::size_t i = 0; i < owners; i++)
+        {
+            auto& handle = handles[i * (handles.size() / owners) / 2 * 2];
+            handle.Add<DenseMarker>(DenseMarker { 1 });
+            handle.Add<CompressedMarker>(CompressedMarker { 1 });
+        }
+        Run<DenseMarker>(world, name, "dense");
+        Run<CompressedMarker>(world, name, "compressed");
+    }
+}
@@ -0,0 +1,82 @@
+// Adding, iterating and removing empty tag components on every entity.
+//
+// usage: tag_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    float x, y;
+};
+
+struct Visible
+{
+};
+
+struct Selectable
+{
+};
+
+struct Networked
+{
+};
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        auto name = backend == bent::StorageBackend::ComponentPools ? "pools" : "archetypes";
+        bent::World world(backend);
+        std::vector<bent::EntityHandle> handles;
+        world.Create(entities, std::back_inserter(handles));
+        for (auto& handle : handles)
+        {
+            handle.Add<Position>(Position { 0.0f, 0.0f });
+        }
+
+        double add = 0, each = 0, remove = 0;
+        std::size_t found = 0;
+        for (int i = 0; i < 5; i++)
+        {
+            auto a = bench::Measure(1, [&]
+            {
+                for (auto& handle : handles)
+                {
+                    handle.Add<Visible>();
+                    handle.Add<Selectable>();
+                    handle.Add<Networked>();
+                }
+            });
+            auto e = bench::Measure(1, [&]
+            {
+                found = 0;
+                world.each<Position, Visible, Networked>([&](bent::EntityHandle, Position&, Visible&, Networked&)
+                {
+                    ++found;
+                });
+            });
+            auto r = bench::Measure(1, [&]
+            {
+                for (auto& handle : handles)
+                {
+                    handle.Remove<Visible>();
+                    handle.Remove<Selectable>();
+                    handle.Remove<Networked>();
+                }
+            });
+            add = i == 0 || a < add ? a : add;
+            each = i == 0 || e < each ? e : each;
+            remove = i == 0 || r < remove ? r : remove;
+        }
+        std::printf("%s (%zu entities): add 3 tags %.2f ms, each %.2f ms, remove 3 tags %.2f ms\n", name, found, add, each, remove);
+    }
+}
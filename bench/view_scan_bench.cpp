@@ -0,0 +1,110 @@
+// Scanning and counting entities for a dense, a sparse and a clustered query with entities_with, each and count,
+// with row-wise component masks and with column bitmaps.
+//
+// usage: view_scan_bench [entities]
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+
+#include <bent/bent.hpp>
+
+#include "bench.hpp"
+
+struct Position
+{
+    Position(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+struct Velocity
+{
+    Velocity(float x, float y) : x(x), y(y) {}
+    float x, y;
+};
+
+struct Rare
+{
+    int value;
+};
+
+struct Recent
+{
+    int value;
+};
+
+template <typename... Ts>
+static void Run(bent::World & world, const char * layout, const char * name)
+{
+    std::size_t found = 0;
+    auto view = bench::Measure(5, [&]
+    {
+        found = 0;
+        for (auto& entity : world.entities_with<Ts...>())
+        {
+            (void) entity;
+            ++found;
+        }
+    });
+    auto each = bench::Measure(5, [&]
+    {
+        found = 0;
+        world.each<Ts...>([&](bent::EntityHandle, Ts&...)
+        {
+            ++found;
+        });
+    });
+    auto count = bench::Measure(5, [&]
+    {
+        found = world.count<Ts...>();
+    });
+    std::printf("%s %s (%zu entities): entities_with %.2f ms, each %.2f ms, count %.2f ms\n", layout, name, found, view, each, count);
+}
+
+static void Populate(bent::World & world, std::size_t entities)
+{
+    std::vector<bent::EntityHandle> handles;
+    world.Create(entities, std::back_inserter(handles));
+    for (std::size_t i = 0; i < handles.size(); i++)
+    {
+        handles[i].Add<Position>(0.0f, 0.0f);
+        if (i % 3 != 0)
+        {
+            handles[i].Add<Velocity>(1.0f, 1.0f);
+        }
+        if (i % 100 == 99)
+        {
+            handles[i].Add<Rare>(Rare { 1 });
+        }
+        if (i % 1000 == 0 || i + 10000 >= handles.size())
+        {
+            handles[i].Add<Recent>(Recent { 1 });
+        }
+    }
+    // as after a big despawn, only the last entities keep Recent.
+    for (std::size_t i = 0; i + 10000 < handles.size(); i += 1000)
+    {
+        handles[i].Remove<Recent>();
+    }
+    // rare entities spread to the end, so the scan can't stop early.
+    if (handles.back().Get<Rare>() == nullptr)
+    {
+        handles.back().Add<Rare>(Rare { 1 });
+    }
+}
+
+int main(int argc, char * argv [])
+{
+    std::size_t entities = argc > 1 ? std::atoi(argv[1]) : 10000000;
+
+    for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+    {
+        auto name = layout == bent::MaskLayout::Rows ? "rows" : "columns";
+        bent::World world(bent::StorageBackend::ComponentPools, layout);
+        Populate(world, entities);
+        Run<Position, Velocity>(world, name, "dense");
+        Run<Position, Rare>(world, name, "sparse");
+        Run<Position, Recent>(world, name, "clustered");
+    }
+}
@@ -2,5 +2,9 @@
 
 #include "world.hpp"
 #include "view.hpp"
+#include "query.hpp"
 #include "component_manager.hpp"
+#include "component_storage.hpp"
 #include "entity_handle.hpp"
+#include "scheduler.hpp"
+#include "command_buffer.hpp"
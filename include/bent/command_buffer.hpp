@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "internal/definitions.hpp"
+#include "component_manager.hpp"
+#include "entity_handle.hpp"
+
+namespace bent
+{
+    struct World;
+
+    /// Records structural changes of a world to apply them later with `World::Flush`.
+    ///
+    /// Recording touches no world, so systems can record while iterating or from worker threads.
+    /// A buffer must be used by one thread at a time; use a buffer per thread.
+    struct CommandBuffer
+    {
+        /// An entity recorded to be created, usable in later commands of the same buffer.
+        struct Spawned
+        {
+            std::uint32_t number;
+        };
+
+        CommandBuffer() = default;
+
+        /// Takes commands recorded in OTHER, leaving it empty.
+        CommandBuffer(CommandBuffer&& other) :
+            commands_(std::move(other.commands_)),
+            spawned_(other.spawned_),
+            blocks_(std::move(other.blocks_)),
+            block_(other.block_),
+            used_(other.used_)
+        {
+            other.Release();
+        }
+
+        /// Discards commands recorded in this buffer and takes ones recorded in OTHER, leaving it empty.
+        CommandBuffer& operator=(CommandBuffer&& other)
+        {
+            if (this != &other)
+            {
+                Clear();
+                commands_ = std::move(other.commands_);
+                spawned_ = other.spawned_;
+                blocks_ = std::move(other.blocks_);
+                block_ = other.block_;
+                used_ = other.used_;
+                other.Release();
+            }
+            return *this;
+        }
+
+        ~CommandBuffer()
+        {
+            Clear();
+        }
+
+        /// Records creating an entity.
+        Spawned Create()
+        {
+            Spawned spawned { spawned_++ };
+            Record(CREATE, Target { spawned.number, 0, true }, 0, nullptr);
+            return spawned;
+        }
+
+        /// Records destroying an entity.
+        template <typename Entity>
+        void Destroy(const Entity & entity)
+        {
+            Record(DESTROY, target(entity), 0, nullptr);
+        }
+
+        /// Records adding a component by emplacing. The component is constructed now and moved at the flush.
+        template <typename T, typename Entity, typename... Args>
+        void Add(const Entity & entity, Args&&... args)
+        {
+            auto component_index = ComponentManager::instance().id<T>();
+            auto p = Allocate(sizeof(T), alignof(T));
+            new (p) T(std::forward<Args>(args)...);
+            Record(ADD, target(entity), component_index, p);
+        }
+
+        /// Records replacing a component, or adding it when the entity doesn't have it.
+        template <typename T, typename Entity, typename... Args>
+        void Replace(const Entity & entity, Args&&... args)
+        {
+            auto component_index = ComponentManager::instance().id<T>();
+            auto p = Allocate(sizeof(T), alignof(T));
+            new (p) T(std::forward<Args>(args)...);
+            Record(REPLACE, target(entity), component_index, p);
+        }
+
+        /// Records removing a component.
+        template <typename T, typename Entity>
+        void Remove(const Entity & entity)
+        {
+            Record(REMOVE, target(entity), ComponentManager::instance().id<T>(), nullptr);
+        }
+
+        /// Returns the number of commands recorded.
+        std::size_t size() const
+        {
+            return commands_.size();
+        }
+
+        bool empty() const
+        {
+            return commands_.empty();
+        }
+
+        /// Discards all commands recorded.
+        void Clear()
+        {
+            auto & manager = ComponentManager::instance();
+            for (auto & command : commands_)
+            {
+                if (command.payload)
+                {
+                    manager.dynamic_constructor(command.component_index).Destroy(command.payload);
+                }
+            }
+            commands_.clear();
+            spawned_ = 0;
+            used_ = 0;
+            block_ = 0;
+        }
+
+    private:
+        friend World;
+
+        enum Type : std::uint8_t
+        {
+            CREATE,
+            DESTROY,
+            ADD,
+            REPLACE,
+            REMOVE,
+        };
+
+        struct Target
+        {
+            std::uint32_t index;
+            std::uint32_t version;
+            bool spawned;
+        };
+
+        struct Command
+        {
+            Type type;
+            std::uint16_t component_index;
+            Target target;
+            void * payload;
+        };
+
+        using Element = std::aligned_storage<sizeof(std::max_align_t), alignof(std::max_align_t)>::type;
+
+        static Target target(const EntityHandle & entity)
+        {
+            return Target { entity.index_, entity.version_, false };
+        }
+
+        static Target target(const Spawned & entity)
+        {
+            return Target { entity.number, 0, true };
+        }
+
+        /// Forgets commands and blocks taken by another buffer, without destructing their payloads.
+        void Release()
+        {
+            commands_.clear();
+            blocks_.clear();
+            spawned_ = 0;
+            block_ = 0;
+            used_ = 0;
+        }
+
+        void Record(Type type, const Target & target, std::uint16_t component_index, void * payload)
+        {
+            Command command = { type, component_index, target, payload };
+            commands_.push_back(command);
+        }
+
+        /// Allocates SIZE bytes aligned to ALIGNMENT from the arena. Blocks are reused after Clear.
+        ///
+        /// Blocks are only aligned to `alignof(std::max_align_t)`, so offsets are aligned by address, with room left for it in fresh blocks.
+        void * Allocate(std::size_t size, std::size_t alignment)
+        {
+            while (true)
+            {
+                if (block_ == blocks_.size())
+                {
+                    auto capacity = std::max(COMMAND_BUFFER_BLOCK_SIZE, size + alignment);
+                    blocks_.emplace_back(std::unique_ptr<Element []>(new Element[(capacity + sizeof(Element) - 1) / sizeof(Element)]), capacity);
+                    used_ = 0;
+                }
+                auto base = reinterpret_cast<unsigned char*>(blocks_[block_].first.get());
+                auto address = reinterpret_cast<std::uintptr_t>(base) + used_;
+                auto offset = used_ + (alignment - address % alignment) % alignment;
+                if (offset + size <= blocks_[block_].second)
+                {
+                    used_ = offset + size;
+                    return base + offset;
+                }
+                ++block_;
+                used_ = 0;
+            }
+        }
+
+        std::vector<Command> commands_;
+        std::uint32_t spawned_ = 0;
+
+        std::vector<std::pair<std::unique_ptr<Element []>, std::size_t>> blocks_;
+        std::size_t block_ = 0;
+        std::size_t used_ = 0;
+    };
+}
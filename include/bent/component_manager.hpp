@@ -2,15 +2,19 @@
 
 #include <string>
 #include <memory>
-#include <deque>
+#include <vector>
 #include <unordered_map>
 #include <typeindex>
 #include <limits>
 #include <stdexcept>
+#include <mutex>
+#include <type_traits>
+#include <utility>
 
 #include "internal/definitions.hpp"
 #include "internal/dynamic_constructor.hpp"
 #include "internal/component_pool_factory.hpp"
+#include "internal/component_serializer.hpp"
 
 namespace bent
 {
@@ -29,30 +33,67 @@ namespace bent
         template<typename T>
         std::uint16_t RegisterComponent(const std::string& name);
 
+        template <typename T>
+        void RegisterSerializer(typename ComponentSerializer<T>::SaveFunction save, typename ComponentSerializer<T>::LoadFunction load);
+
         template <typename T>
         std::uint16_t id();
         std::uint16_t id(const std::string& name) const;
         std::string name(std::uint16_t id) const;
         DynamicConstructorInterface & dynamic_constructor(std::uint16_t id) const;
         ComponentPoolFactoryInterface & component_pool_factory(std::uint16_t id) const;
+        bool compressed_membership(std::uint16_t id) const;
+        bool tracks_changes(std::uint16_t id) const;
+        void * tag_instance(std::uint16_t id) const;
+        ComponentSerializerInterface * serializer(std::uint16_t id) const;
 
         std::uint16_t size() const;
 
     private:
-        ComponentManager()
+        ComponentManager() :
+            dynamic_constructor_by_id_(MAX_COMPONENTS),
+            component_pool_factory_by_id_(MAX_COMPONENTS),
+            compressed_membership_by_id_(MAX_COMPONENTS),
+            tracks_changes_by_id_(MAX_COMPONENTS),
+            tag_instance_by_id_(MAX_COMPONENTS),
+            serializer_by_id_(MAX_COMPONENTS)
         {}
 
+        template <typename T>
+        std::uint16_t Assign();
+
+        template <typename T>
+        static void * TagInstanceOf(std::true_type)
+        {
+            return &TagInstance<T>();
+        }
+
+        template <typename T>
+        static void * TagInstanceOf(std::false_type)
+        {
+            return nullptr;
+        }
+
         std::unordered_map<std::string, std::uint16_t> id_by_name_;
         std::unordered_map<std::uint16_t, std::string> name_by_id_;
         std::unordered_map<std::type_index, std::uint16_t> id_by_type_;
-        std::deque<std::unique_ptr<DynamicConstructorInterface>> dynamic_constructor_by_id_;
-        std::deque<std::unique_ptr<ComponentPoolFactoryInterface>> component_pool_factory_by_id_;
+        // sized to MAX_COMPONENTS up front, so slots can be read while other types are assigned.
+        std::vector<std::unique_ptr<DynamicConstructorInterface>> dynamic_constructor_by_id_;
+        std::vector<std::unique_ptr<ComponentPoolFactoryInterface>> component_pool_factory_by_id_;
+        std::vector<std::uint8_t> compressed_membership_by_id_;
+        std::vector<std::uint8_t> tracks_changes_by_id_;
+        std::vector<void*> tag_instance_by_id_;
+        std::vector<std::unique_ptr<ComponentSerializerInterface>> serializer_by_id_;
         std::uint16_t size_ = 0; // id is start from 0.
+        mutable std::mutex mutex_;
     };
 
     template <typename T>
     void RegisterComponent(const std::string& name);
 
+    template <typename T>
+    void RegisterSerializer(typename ComponentSerializer<T>::SaveFunction save, typename ComponentSerializer<T>::LoadFunction load);
+
     //
     // Definitions
     //
@@ -66,12 +107,9 @@ namespace bent
     template<typename T>
     inline std::uint16_t ComponentManager::RegisterComponent(const std::string & name)
     {
-        if (size_ == MAX_COMPONENTS)
-        {
-            throw std::out_of_range("too many components are registered (hint: configure <bent/defintions.hpp>)");
-        }
         auto i = id<T>();
 
+        std::lock_guard<std::mutex> lock(mutex_);
         auto res = name_by_id_.emplace(i, name);
         if (!res.second)
         {
@@ -82,33 +120,66 @@ namespace bent
         return i;
     }
 
+    /// Registers functions saving components T to bytes and loading them back, for snapshots of types that aren't trivially copyable.
+    ///
+    /// SAVE is called as `save(const T&, std::string & out)` and appends to OUT;
+    /// LOAD is called as `load(const char * data, std::size_t size)` with the bytes SAVE appended and returns the component.
+    /// Registering again replaces the functions.
+    template <typename T>
+    inline void ComponentManager::RegisterSerializer(typename ComponentSerializer<T>::SaveFunction save, typename ComponentSerializer<T>::LoadFunction load)
+    {
+        auto i = id<T>();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        serializer_by_id_[i].reset(new ComponentSerializer<T>(std::move(save), std::move(load)));
+    }
+
+    /// The id is assigned at the first call for T and cached, so later calls only load it.
     template <typename T>
     inline std::uint16_t ComponentManager::id()
     {
+        static const std::uint16_t id = instance().Assign<T>();
+        return id;
+    }
+
+    /// Assigns an id to T, or returns the id already assigned to T.
+    ///
+    /// Types are still looked up by type_index here, so a type gets one id even when id<T>()
+    /// is instantiated in several shared libraries.
+    template <typename T>
+    inline std::uint16_t ComponentManager::Assign()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
         auto it = id_by_type_.find(typeid(T));
         if (it != id_by_type_.end())
         {
             return it->second;
         }
-        else
+        if (size_ == MAX_COMPONENTS)
         {
-            auto id = size_;
-            id_by_type_.emplace(typeid(T), id);
-            dynamic_constructor_by_id_.emplace_back(new DynamicConstructor<T>);
-            component_pool_factory_by_id_.emplace_back(new ComponentPoolFactory<T>);
-
-            ++size_;
-            return id;
+            throw std::out_of_range("too many components are registered (hint: configure <bent/defintions.hpp>)");
         }
+        auto id = size_;
+        id_by_type_.emplace(typeid(T), id);
+        dynamic_constructor_by_id_[id].reset(new DynamicConstructor<T>);
+        component_pool_factory_by_id_[id].reset(new ComponentPoolFactory<T>);
+        compressed_membership_by_id_[id] = std::is_same<typename ComponentMembership<T>::type, CompressedMembership>::value;
+        tracks_changes_by_id_[id] = std::is_same<typename ComponentChanges<T>::type, TrackedChanges>::value;
+        tag_instance_by_id_[id] = TagInstanceOf<T>(IsTagComponent<T>());
+
+        ++size_;
+        return id;
     }
 
     inline std::uint16_t ComponentManager::id(const std::string & name) const
     {
+        std::lock_guard<std::mutex> lock(mutex_);
         return id_by_name_.at(name);
     }
 
     inline std::string ComponentManager::name(std::uint16_t id) const
     {
+        std::lock_guard<std::mutex> lock(mutex_);
         return name_by_id_.at(id);
     }
 
@@ -122,6 +193,31 @@ namespace bent
         return *component_pool_factory_by_id_[id];
     }
 
+    /// Returns whether owners of the component are indexed by a compressed set. See `ComponentMembership`.
+    inline bool ComponentManager::compressed_membership(std::uint16_t id) const
+    {
+        return compressed_membership_by_id_[id] != 0;
+    }
+
+    /// Returns whether additions and changes of the component are stamped with ticks. See `ComponentChanges`.
+    inline bool ComponentManager::tracks_changes(std::uint16_t id) const
+    {
+        return tracks_changes_by_id_[id] != 0;
+    }
+
+    /// Returns the instance shared by entities having the tag component, or nullptr when it is not a tag. See `IsTagComponent`.
+    inline void * ComponentManager::tag_instance(std::uint16_t id) const
+    {
+        return tag_instance_by_id_[id];
+    }
+
+    /// Returns the serializer registered for the component, or nullptr. See `RegisterSerializer`.
+    inline ComponentSerializerInterface * ComponentManager::serializer(std::uint16_t id) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return serializer_by_id_[id].get();
+    }
+
     inline std::uint16_t ComponentManager::size() const
     {
         return size_;
@@ -133,4 +229,11 @@ namespace bent
         auto& instance = ComponentManager::instance();
         instance.RegisterComponent<T>(name);
     }
+
+    template<typename T>
+    void RegisterSerializer(typename ComponentSerializer<T>::SaveFunction save, typename ComponentSerializer<T>::LoadFunction load)
+    {
+        auto& instance = ComponentManager::instance();
+        instance.RegisterSerializer<T>(std::move(save), std::move(load));
+    }
 }
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <type_traits>
+
+#include "internal/component_pool.hpp"
+
+namespace bent
+{
+    /// Selects the pool that stores components of type T.
+    ///
+    /// By default, components are stored in blocks indexed by entity index, which is fastest for components most entities have.
+    /// For components only a few entities have, specialize this to use `PackedComponentPool`.
+    /// The specialization must be visible before the component is first used.
+    template <typename T>
+    struct ComponentStorage
+    {
+        using type = ComponentPool<T>;
+    };
+
+    /// Membership kept as a bit per entity index, summarized per block of 64 entities.
+    struct DenseMembership {};
+
+    /// Membership kept in a compressed set of entity indices, taking memory and scan time proportional to the owners.
+    struct CompressedMembership {};
+
+    /// Selects how entities having components of type T are indexed for queries.
+    ///
+    /// By default, queries find owners by bits over all entity indices, which is fastest for components many entities have.
+    /// For components a handful of entities spread over many indices have, specialize this to use `CompressedMembership`.
+    /// The specialization must be visible before the component is first used.
+    template <typename T>
+    struct ComponentMembership
+    {
+        using type = DenseMembership;
+    };
+
+    /// Changes not recorded.
+    struct UntrackedChanges {};
+
+    /// Additions and changes stamped with the tick of the world per entity, for `Added` and `Changed` query filters.
+    struct TrackedChanges {};
+
+    /// Selects whether changes of components of type T are tracked.
+    ///
+    /// Tracking costs a stamp per addition and mutable access, and 8 bytes per entity index.
+    /// Specialize this to use `TrackedChanges` before the component is first used.
+    template <typename T>
+    struct ComponentChanges
+    {
+        using type = UntrackedChanges;
+    };
+
+    /// Whether components of type T are tags, kept as bits of component masks only.
+    ///
+    /// Empty types that are trivially destructible and default constructible are tags:
+    /// adding or removing one neither allocates nor constructs, and all entities having one share `TagInstance<T>()`.
+    /// Specialize this to false to store such a type like any other component.
+    template <typename T>
+    struct IsTagComponent : std::integral_constant<bool, std::is_empty<T>::value && std::is_trivially_destructible<T>::value && std::is_default_constructible<T>::value>
+    {
+    };
+
+    /// Returns the instance of the tag component T shared by all entities having it.
+    template <typename T>
+    T & TagInstance()
+    {
+        static T instance;
+        return instance;
+    }
+}
@@ -2,6 +2,7 @@
 
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 
 #include "internal/entity_manager.hpp"
 #include "component_manager.hpp"
@@ -10,6 +11,7 @@ namespace bent
 {
     struct World;
     struct View;
+    struct CommandBuffer;
 
     struct EntityHandle
     {
@@ -73,12 +75,44 @@ namespace bent
         /// Gets a component pointer.
         ///
         /// This pointer is valid until this component is removed or this entity is destroyed.
+        /// When changes of T are tracked, the component is marked changed. See `ComponentChanges`.
         template<typename T>
         T* Get()
         {
             ThrowsIfInvalid();
             auto component_id = ComponentManager::instance().id<T>();
-            return static_cast<T*>(entity_manager_->GetComponent(index_, component_id));
+            auto component = static_cast<T*>(entity_manager_->GetComponent(index_, component_id));
+            if (component && std::is_same<typename ComponentChanges<T>::type, TrackedChanges>::value)
+            {
+                entity_manager_->MarkChanged(index_, component_id);
+            }
+            return component;
+        }
+
+        /// Gets a component pointer for reading, without marking it changed nor copying blocks shared with a fork.
+        template<typename T>
+        const T* Get() const
+        {
+            ThrowsIfInvalid();
+            auto component_id = ComponentManager::instance().id<T>();
+            const EntityManager & entity_manager = *entity_manager_;
+            return static_cast<const T*>(entity_manager.GetComponent(index_, component_id));
+        }
+
+        /// Marks the component changed, e.g. after writing it through a pointer kept from an earlier `Get<T>()`.
+        ///
+        /// The block of the component is copied when it's shared with a fork, as by `Get<T>()`.
+        /// Marks nothing unless changes of T are tracked. When this entity doesn't have the component, throws out_of_range exception.
+        template<typename T>
+        void Patch()
+        {
+            ThrowsIfInvalid();
+            auto component_id = ComponentManager::instance().id<T>();
+            if (!entity_manager_->GetComponent(index_, component_id))
+            {
+                throw std::out_of_range("This entity does not have this component");
+            }
+            entity_manager_->MarkChanged(index_, component_id);
         }
 
         // component access without type
@@ -110,11 +144,17 @@ namespace bent
         /// Gets a component pointer without type.
         ///
         /// This pointer is valid until this component is removed or this entity is destroyed.
+        /// The component is marked changed like `Get<T>()`.
         void* Get(const std::string& component_name)
         {
             ThrowsIfInvalid();
             auto component_id = ComponentManager::instance().id(component_name);
-            return entity_manager_->GetComponent(index_, component_id);
+            auto component = entity_manager_->GetComponent(index_, component_id);
+            if (component)
+            {
+                entity_manager_->MarkChanged(index_, component_id);
+            }
+            return component;
         }
 
         // operators
@@ -133,6 +173,7 @@ namespace bent
 
         friend World;
         friend View;
+        friend CommandBuffer;
 
         // don't call any member functions
         EntityHandle() :
@@ -0,0 +1,499 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <cstddef>
+#include <cassert>
+
+#include "definitions.hpp"
+#include "dynamic_constructor.hpp"
+#include "change_ticks.hpp"
+#include "../component_manager.hpp"
+
+namespace bent
+{
+    constexpr std::uint16_t NULL_COLUMN = std::numeric_limits<std::uint16_t>::max();
+
+    /// Entities with the same set of component types.
+    ///
+    /// Rows are packed into chunks of about ARCHETYPE_CHUNK_SIZE bytes.
+    /// A chunk holds a column of entity indices followed by a column per component type.
+    struct Archetype
+    {
+        explicit Archetype(const ComponentMask & mask) :
+            mask_(mask),
+            column_by_component_(MAX_COMPONENTS, NULL_COLUMN)
+        {
+            auto & manager = ComponentManager::instance();
+            for (std::uint16_t i = 0; i < MAX_COMPONENTS; i++)
+            {
+                // tags have no column; the mask alone records them.
+                if (mask[i] && manager.tag_instance(i) == nullptr)
+                {
+                    column_by_component_[i] = static_cast<std::uint16_t>(components_.size());
+                    auto constructor = &manager.dynamic_constructor(i);
+                    if (!constructor->trivially_destructible())
+                    {
+                        destructible_columns_.push_back(static_cast<std::uint16_t>(components_.size()));
+                    }
+                    components_.push_back(i);
+                    constructors_.push_back(constructor);
+                }
+            }
+
+            std::size_t row_size = sizeof(std::uint32_t);
+            chunk_alignment_ = alignof(std::uint32_t);
+            for (auto constructor : constructors_)
+            {
+                row_size += constructor->size();
+                chunk_alignment_ = std::max(chunk_alignment_, constructor->alignment());
+            }
+            chunk_capacity_ = std::max<std::size_t>(ARCHETYPE_CHUNK_SIZE / row_size, 1);
+            while (chunk_capacity_ > 1 && Layout(chunk_capacity_) > ARCHETYPE_CHUNK_SIZE)
+            {
+                --chunk_capacity_;
+            }
+            chunk_size_ = Layout(chunk_capacity_);
+        }
+
+        Archetype(const Archetype&) = delete;
+        Archetype& operator=(const Archetype&) = delete;
+
+        ~Archetype()
+        {
+            // components of a column are contiguous in each chunk, so they are destructed a chunk at a time.
+            for (std::uint32_t chunk = 0; chunk < chunk_count(); chunk++)
+            {
+                for (auto column : destructible_columns_)
+                {
+                    constructors_[column]->Destroy(column_data(chunk, column), chunk_rows(chunk));
+                }
+            }
+        }
+
+        const ComponentMask & mask() const
+        {
+            return mask_;
+        }
+
+        /// Returns the number of entities in this archetype.
+        std::uint32_t size() const
+        {
+            return size_;
+        }
+
+        std::uint32_t chunk_capacity() const
+        {
+            return static_cast<std::uint32_t>(chunk_capacity_);
+        }
+
+        /// Returns the index of the entity at ROW.
+        std::uint32_t entity(std::uint32_t row) const
+        {
+            assert(row < size_);
+            auto chunk = chunks_[row / chunk_capacity_];
+            return reinterpret_cast<const std::uint32_t*>(chunk)[row % chunk_capacity_];
+        }
+
+        /// Returns the column of COMPONENT_INDEX, or NULL_COLUMN when this archetype doesn't have it.
+        std::uint16_t column(std::uint16_t component_index) const
+        {
+            return column_by_component_[component_index];
+        }
+
+        std::uint32_t chunk_count() const
+        {
+            return static_cast<std::uint32_t>((size_ + chunk_capacity_ - 1) / chunk_capacity_);
+        }
+
+        /// Returns the number of rows in CHUNK.
+        std::uint32_t chunk_rows(std::uint32_t chunk) const
+        {
+            return static_cast<std::uint32_t>(std::min<std::size_t>(size_ - chunk * chunk_capacity_, chunk_capacity_));
+        }
+
+        /// Returns the latest tick a component in CHUNK was stamped with, or a row was moved into it at.
+        ///
+        /// Entities of a chunk whose tick isn't after a tick haven't changed since then.
+        std::uint32_t chunk_tick(std::uint32_t chunk) const
+        {
+            return chunk_ticks_[chunk].load();
+        }
+
+        /// Returns the column of entity indices in CHUNK.
+        const std::uint32_t * entities(std::uint32_t chunk) const
+        {
+            return reinterpret_cast<const std::uint32_t*>(chunks_[chunk]);
+        }
+
+        /// Returns the first component of COLUMN in CHUNK. Components of a column are contiguous in a chunk.
+        void * column_data(std::uint32_t chunk, std::uint16_t column)
+        {
+            assert(column < components_.size());
+            return chunks_[chunk] + offsets_[column];
+        }
+
+        /// Returns a pointer to the component at ROW and COLUMN.
+        void * at(std::uint32_t row, std::uint16_t column)
+        {
+            assert(row < size_ && column < components_.size());
+            auto chunk = chunks_[row / chunk_capacity_];
+            return chunk + offsets_[column] + (row % chunk_capacity_) * constructors_[column]->size();
+        }
+
+    private:
+        friend struct ArchetypeStorage;
+
+        /// Computes column offsets for CAPACITY rows and returns the chunk size they need.
+        std::size_t Layout(std::size_t capacity)
+        {
+            offsets_.clear();
+            std::size_t offset = sizeof(std::uint32_t) * capacity;
+            for (auto constructor : constructors_)
+            {
+                auto alignment = constructor->alignment();
+                offset = (offset + alignment - 1) / alignment * alignment;
+                offsets_.push_back(offset);
+                offset += constructor->size() * capacity;
+            }
+            return offset;
+        }
+
+        /// Allocates chunks for ROWS rows.
+        void Reserve(std::size_t rows)
+        {
+            auto chunks = (rows + chunk_capacity_ - 1) / chunk_capacity_;
+            while (chunks_.size() < chunks)
+            {
+                AddChunk();
+            }
+        }
+
+        /// Allocates a chunk aligned for every column, which `new` only guarantees up to `alignof(std::max_align_t)`.
+        void AddChunk()
+        {
+            chunk_memory_.emplace_back(new unsigned char[chunk_size_ + chunk_alignment_ - 1]);
+            auto memory = chunk_memory_.back().get();
+            auto address = reinterpret_cast<std::uintptr_t>(memory);
+            chunks_.push_back(memory + (chunk_alignment_ - address % chunk_alignment_) % chunk_alignment_);
+            chunk_ticks_.push_back(0);
+        }
+
+        /// Copies rows of ORIGIN, an archetype of the same mask, into this empty archetype a column of a chunk at a time.
+        void CopyRows(const Archetype & origin)
+        {
+            assert(size_ == 0 && mask_ == origin.mask_);
+            Reserve(origin.size_);
+            for (std::uint32_t chunk = 0; chunk < origin.chunk_count(); chunk++)
+            {
+                auto rows = origin.chunk_rows(chunk);
+                std::copy(origin.entities(chunk), origin.entities(chunk) + rows, reinterpret_cast<std::uint32_t*>(chunks_[chunk]));
+                for (std::uint16_t column = 0; column < components_.size(); column++)
+                {
+                    auto offset = offsets_[column];
+                    constructors_[column]->CopyConstruct(chunks_[chunk] + offset, origin.chunks_[chunk] + offset, rows);
+                }
+                chunk_ticks_[chunk] = origin.chunk_ticks_[chunk];
+                size_ += rows;
+            }
+        }
+
+        /// Destructs components at ROW, skipping trivially destructible ones.
+        void Destruct(std::uint32_t row)
+        {
+            for (auto column : destructible_columns_)
+            {
+                constructors_[column]->Destroy(at(row, column));
+            }
+        }
+
+        /// Appends a row for the entity INDEX. Components of the row are not constructed.
+        std::uint32_t Push(std::uint32_t index)
+        {
+            auto row = size_;
+            auto i = row / chunk_capacity_;
+            if (chunks_.size() <= i)
+            {
+                AddChunk();
+            }
+            ++size_;
+            reinterpret_cast<std::uint32_t*>(chunks_[i])[row % chunk_capacity_] = index;
+            return row;
+        }
+
+        /// Removes ROW, whose components are already destructed or moved out, by moving the last row into it.
+        ///
+        /// @return index of the entity moved to ROW, or the removed entity when ROW was the last.
+        std::uint32_t Erase(std::uint32_t row)
+        {
+            auto last = size_ - 1;
+            auto moved = entity(last);
+            if (row != last)
+            {
+                for (std::uint16_t column = 0; column < components_.size(); column++)
+                {
+                    constructors_[column]->Relocate(at(row, column), at(last, column));
+                }
+                auto chunk = chunks_[row / chunk_capacity_];
+                reinterpret_cast<std::uint32_t*>(chunk)[row % chunk_capacity_] = moved;
+                Stamp(row, chunk_tick(static_cast<std::uint32_t>(last / chunk_capacity_)));
+            }
+            --size_;
+            return moved;
+        }
+
+        /// Raises the tick of the chunk of ROW to TICK.
+        ///
+        /// Systems writing different components of a chunk stamp it at once, so the tick is raised atomically.
+        void Stamp(std::uint32_t row, std::uint32_t tick)
+        {
+            chunk_ticks_[row / chunk_capacity_].Raise(tick);
+        }
+
+        ComponentMask mask_;
+        std::vector<std::uint16_t> components_;
+        std::vector<DynamicConstructorInterface*> constructors_;
+        std::vector<std::uint16_t> column_by_component_;
+        std::vector<std::uint16_t> destructible_columns_;
+        std::vector<std::size_t> offsets_;
+        std::size_t chunk_capacity_;
+        std::size_t chunk_size_;
+        std::size_t chunk_alignment_;
+        std::vector<std::unique_ptr<unsigned char []>> chunk_memory_;
+        std::vector<unsigned char*> chunks_; // starts of chunk_memory_ aligned to chunk_alignment_
+        std::vector<AtomicTick> chunk_ticks_;
+        std::uint32_t size_ = 0;
+
+        // archetypes reached by adding or removing a component, filled on demand
+        std::vector<Archetype*> add_edges_;
+        std::vector<Archetype*> remove_edges_;
+    };
+
+    /// Stores components of entities grouped by archetype.
+    ///
+    /// Adding or removing a component moves all components of the entity to another archetype.
+    struct ArchetypeStorage
+    {
+        /// Moves the entity INDEX to the archetype with COMPONENT_INDEX added.
+        ///
+        /// @return memory for the added component, or nullptr for a tag.
+        /// Notice: You must construct it on your responsibility.
+        void * Add(std::uint32_t index, std::uint16_t component_index)
+        {
+            auto & location = this->location(index);
+            auto from = location.archetype;
+            auto to = Edge(from, component_index, true);
+            auto row = to->Push(index);
+            if (from)
+            {
+                for (std::uint16_t column = 0; column < from->components_.size(); column++)
+                {
+                    from->constructors_[column]->Relocate(to->at(row, to->column(from->components_[column])), from->at(location.row, column));
+                }
+                to->Stamp(row, from->chunk_tick(location.row / from->chunk_capacity()));
+                Erase(*from, location.row);
+            }
+            location.archetype = to;
+            location.row = row;
+            auto column = to->column(component_index);
+            return column == NULL_COLUMN ? nullptr : to->at(row, column);
+        }
+
+        /// Returns a pointer to the component of the entity INDEX.
+        void * Get(std::uint32_t index, std::uint16_t component_index) const
+        {
+            auto & location = locations_[index];
+            assert(location.archetype && location.archetype->column(component_index) != NULL_COLUMN);
+            return location.archetype->at(location.row, location.archetype->column(component_index));
+        }
+
+        /// Moves the entity INDEX to the archetype with COMPONENT_INDEX removed.
+        ///
+        /// Notice: The component must be destructed on your responsibility.
+        void Remove(std::uint32_t index, std::uint16_t component_index)
+        {
+            auto & location = locations_[index];
+            auto from = location.archetype;
+            assert(from);
+            auto to = Edge(from, component_index, false);
+            std::uint32_t row = 0;
+            if (to)
+            {
+                row = to->Push(index);
+                for (std::uint16_t column = 0; column < from->components_.size(); column++)
+                {
+                    if (from->components_[column] == component_index)
+                    {
+                        continue;
+                    }
+                    from->constructors_[column]->Relocate(to->at(row, to->column(from->components_[column])), from->at(location.row, column));
+                }
+                to->Stamp(row, from->chunk_tick(location.row / from->chunk_capacity()));
+            }
+            Erase(*from, location.row);
+            location.archetype = to;
+            location.row = row;
+        }
+
+        /// Returns a copy of this storage for a forked world, with components copy-constructed a column of a chunk at a time.
+        ArchetypeStorage * Fork() const
+        {
+            std::unique_ptr<ArchetypeStorage> fork(new ArchetypeStorage);
+            std::unordered_map<const Archetype*, Archetype*> copies;
+            for (auto archetype : archetypes_)
+            {
+                auto copy = fork->Find(archetype->mask());
+                copy->CopyRows(*archetype);
+                copies[archetype] = copy;
+            }
+            fork->locations_ = locations_;
+            for (auto & location : fork->locations_)
+            {
+                if (location.archetype)
+                {
+                    location.archetype = copies[location.archetype];
+                }
+            }
+            return fork.release();
+        }
+
+        /// Raises the tick of the chunk holding the entity INDEX to TICK, when it has any component.
+        void Stamp(std::uint32_t index, std::uint32_t tick)
+        {
+            if (index < locations_.size() && locations_[index].archetype)
+            {
+                locations_[index].archetype->Stamp(locations_[index].row, tick);
+            }
+        }
+
+        /// Destructs all components of the entity INDEX and removes it from its archetype.
+        void Destroy(std::uint32_t index)
+        {
+            if (locations_.size() <= index)
+            {
+                return;
+            }
+            auto & location = locations_[index];
+            auto archetype = location.archetype;
+            if (!archetype)
+            {
+                return;
+            }
+            archetype->Destruct(location.row);
+            Erase(*archetype, location.row);
+            location.archetype = nullptr;
+        }
+
+        /// Reserves locations for COUNT entities, and rows for as many entities in the archetype of MASK.
+        void Reserve(std::size_t count, const ComponentMask & mask)
+        {
+            locations_.reserve(count);
+            if (auto archetype = Find(mask))
+            {
+                archetype->Reserve(count);
+            }
+        }
+
+        /// Destructs all components of entities INDICES and removes them from their archetypes.
+        ///
+        /// Rows are removed from the last, so rows of other entities removed are never moved.
+        void Destroy(const std::vector<std::uint32_t> & indices)
+        {
+            std::vector<std::pair<std::uint32_t, std::uint32_t>> rows;
+            rows.reserve(indices.size());
+            for (auto index : indices)
+            {
+                if (index < locations_.size() && locations_[index].archetype)
+                {
+                    rows.emplace_back(locations_[index].row, index);
+                }
+            }
+            std::sort(rows.begin(), rows.end(), [](const std::pair<std::uint32_t, std::uint32_t> & lhs, const std::pair<std::uint32_t, std::uint32_t> & rhs)
+            {
+                return lhs.first > rhs.first;
+            });
+            for (auto & row : rows)
+            {
+                Destroy(row.second);
+            }
+        }
+
+        /// Returns all archetypes in creation order.
+        const std::vector<Archetype*> & archetypes() const
+        {
+            return archetypes_;
+        }
+
+    private:
+
+        struct Location
+        {
+            Archetype * archetype = nullptr;
+            std::uint32_t row = 0;
+        };
+
+        Location & location(std::uint32_t index)
+        {
+            if (locations_.size() <= index)
+            {
+                locations_.resize(index + 1);
+            }
+            return locations_[index];
+        }
+
+        void Erase(Archetype & archetype, std::uint32_t row)
+        {
+            auto moved = archetype.Erase(row);
+            locations_[moved].row = row;
+        }
+
+        /// Returns the archetype FROM with COMPONENT_INDEX added or removed, or nullptr for the empty set.
+        Archetype * Edge(Archetype * from, std::uint16_t component_index, bool add)
+        {
+            if (!from)
+            {
+                ComponentMask mask;
+                mask[component_index] = add;
+                return Find(mask);
+            }
+            auto & edges = add ? from->add_edges_ : from->remove_edges_;
+            if (edges.empty())
+            {
+                edges.resize(MAX_COMPONENTS);
+            }
+            auto & edge = edges[component_index];
+            if (!edge)
+            {
+                auto mask = from->mask();
+                mask[component_index] = add;
+                edge = Find(mask);
+            }
+            return edge;
+        }
+
+        Archetype * Find(const ComponentMask & mask)
+        {
+            if (mask.none())
+            {
+                return nullptr;
+            }
+            auto & archetype = archetype_by_mask_[mask];
+            if (!archetype)
+            {
+                archetype.reset(new Archetype(mask));
+                archetypes_.push_back(archetype.get());
+            }
+            return archetype.get();
+        }
+
+        std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> archetype_by_mask_;
+        std::vector<Archetype*> archetypes_;
+        std::vector<Location> locations_;
+    };
+}
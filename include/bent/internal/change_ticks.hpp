@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cassert>
+
+#include "definitions.hpp"
+
+namespace bent
+{
+    /// A tick shared by a block of entities or rows, which threads changing different ones of them raise at once.
+    ///
+    /// Copying it copies its value, so containers of it may grow while no thread raises it.
+    struct AtomicTick
+    {
+        AtomicTick(std::uint32_t tick = 0) :
+            tick_(tick)
+        {}
+
+        AtomicTick(const AtomicTick & other) :
+            tick_(other.load())
+        {}
+
+        AtomicTick & operator=(const AtomicTick & other)
+        {
+            tick_.store(other.load(), std::memory_order_relaxed);
+            return *this;
+        }
+
+        std::uint32_t load() const
+        {
+            return tick_.load(std::memory_order_relaxed);
+        }
+
+        /// Raises the tick to TICK, unless it's already later.
+        void Raise(std::uint32_t tick)
+        {
+            auto current = load();
+            while (current < tick && !tick_.compare_exchange_weak(current, tick, std::memory_order_relaxed))
+            {
+            }
+        }
+
+    private:
+        std::atomic<std::uint32_t> tick_;
+    };
+
+    /// Ticks when a component was added to each entity and last changed.
+    ///
+    /// Each block of 64 entities also keeps its latest ticks, so blocks not changed since a tick are skipped without reading their entities.
+    /// Entities of a block may be changed from several threads at once, as long as each entity is changed by one.
+    struct ChangeTicks
+    {
+        /// Stamps the component added to the entity INDEX, which also counts as a change.
+        void Add(std::uint32_t index, std::uint32_t tick)
+        {
+            if (added_.size() <= index)
+            {
+                auto size = (std::size_t(index) / 64 + 1) * 64;
+                added_.resize(size);
+                changed_.resize(size);
+                latest_added_.resize(size / 64);
+                latest_changed_.resize(size / 64);
+            }
+            added_[index] = tick;
+            latest_added_[index / 64].Raise(tick);
+            Change(index, tick);
+        }
+
+        /// Stamps the component of the entity INDEX changed.
+        void Change(std::uint32_t index, std::uint32_t tick)
+        {
+            assert(index < changed_.size());
+            changed_[index] = tick;
+            latest_changed_[index / 64].Raise(tick);
+        }
+
+        /// Returns whether the component of the entity INDEX was added after tick SINCE.
+        bool added(std::uint32_t index, std::uint32_t since) const
+        {
+            return index < added_.size() && added_[index] > since;
+        }
+
+        /// Returns whether the component of the entity INDEX changed after tick SINCE.
+        bool changed(std::uint32_t index, std::uint32_t since) const
+        {
+            return index < changed_.size() && changed_[index] > since;
+        }
+
+        /// Returns bits of entities FIRST to FIRST + COUNT - 1 whose component was added after tick SINCE. COUNT must be 1 to 64.
+        std::uint64_t added_bits(std::uint32_t first, std::uint32_t count, std::uint32_t since) const
+        {
+            return bits(added_, latest_added_, first, count, since);
+        }
+
+        /// Returns bits of entities FIRST to FIRST + COUNT - 1 whose component changed after tick SINCE. COUNT must be 1 to 64.
+        std::uint64_t changed_bits(std::uint32_t first, std::uint32_t count, std::uint32_t since) const
+        {
+            return bits(changed_, latest_changed_, first, count, since);
+        }
+
+    private:
+
+        static std::uint64_t bits(const std::vector<std::uint32_t> & ticks, const std::vector<AtomicTick> & latest,
+            std::uint32_t first, std::uint32_t count, std::uint32_t since)
+        {
+            assert(count != 0 && count <= 64);
+            auto last = std::min<std::size_t>(std::size_t(first) + count, ticks.size());
+            if (first >= last)
+            {
+                return 0;
+            }
+            if (latest[first / 64].load() <= since && latest[(last - 1) / 64].load() <= since)
+            {
+                return 0;
+            }
+            std::uint64_t bits = 0;
+            for (auto index = first; index < last; index++)
+            {
+                bits |= std::uint64_t(ticks[index] > since) << (index - first);
+            }
+            return bits;
+        }
+
+        std::vector<std::uint32_t> added_;
+        std::vector<std::uint32_t> changed_;
+        std::vector<AtomicTick> latest_added_;
+        std::vector<AtomicTick> latest_changed_;
+    };
+
+    /// Components a query requires to have been added or changed after tick SINCE.
+    struct ChangeQuery
+    {
+        bool empty() const
+        {
+            return added.empty() && changed.empty();
+        }
+
+        std::vector<std::uint16_t> added;
+        std::vector<std::uint16_t> changed;
+        std::uint32_t since = 0;
+    };
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "component_pool.hpp"
+#include "archetype_storage.hpp"
+#include "mask_table.hpp"
+#include "../component_storage.hpp"
+
+namespace bent
+{
+    /// Accesses components of type T through a pool or archetype columns resolved in advance.
+    ///
+    /// Tags have neither, so the instance shared by their owners is returned.
+    template <typename T>
+    struct ComponentAccessor
+    {
+        using Pool = typename ComponentStorage<T>::type;
+
+        ComponentAccessor(std::uint16_t component_index, ComponentPoolInterface * pool) :
+            component_index_(component_index),
+            pool_(static_cast<Pool*>(pool)),
+            column_(nullptr)
+        {}
+
+        /// Returns the number of components in a block of the pool.
+        std::size_t block_size() const
+        {
+            return pool_ ? pool_->block_size() : 1;
+        }
+
+        /// Returns the component of the entity indexed INDEX in the pool.
+        T & operator()(std::uint32_t index) const
+        {
+            return in_pool(index, IsTagComponent<T>());
+        }
+
+        /// Points to the column of T in CHUNK of ARCHETYPE.
+        void Bind(Archetype & archetype, std::uint32_t chunk)
+        {
+            if (!IsTagComponent<T>::value)
+            {
+                column_ = static_cast<T*>(archetype.column_data(chunk, archetype.column(component_index_)));
+            }
+        }
+
+        /// Returns the component at ROW of the bound chunk.
+        T & operator[](std::uint32_t row) const
+        {
+            return in_column(row, IsTagComponent<T>());
+        }
+
+        /// Marks the component handed out for the entity indexed INDEX changed in MANAGER, when changes of T are tracked.
+        template <typename Manager>
+        void Mark(Manager & manager, std::uint32_t index) const
+        {
+            if (std::is_same<typename ComponentChanges<T>::type, TrackedChanges>::value)
+            {
+                manager.MarkChanged(index, component_index_);
+            }
+        }
+
+    private:
+
+        T & in_pool(std::uint32_t index, std::false_type) const
+        {
+            return pool_->GetRef(index);
+        }
+
+        T & in_column(std::uint32_t row, std::false_type) const
+        {
+            return column_[row];
+        }
+
+        T & in_pool(std::uint32_t, std::true_type) const
+        {
+            return TagInstance<T>();
+        }
+
+        T & in_column(std::uint32_t, std::true_type) const
+        {
+            return TagInstance<T>();
+        }
+
+        std::uint16_t component_index_;
+        Pool * pool_;
+        T * column_;
+    };
+
+    /// Accesses components of type T entities may lack, as pointers that are nullptr for those lacking it.
+    ///
+    /// In pools, masks tell whether each entity has it; in archetypes, whether the bound chunk has its column.
+    template <typename T>
+    struct OptionalComponentAccessor
+    {
+        OptionalComponentAccessor(std::uint16_t component_index, ComponentPoolInterface * pool, const MaskTable & masks) :
+            component_index_(component_index),
+            accessor_(component_index, pool),
+            masks_(&masks),
+            bound_(false)
+        {}
+
+        std::size_t block_size() const
+        {
+            return accessor_.block_size();
+        }
+
+        T * operator()(std::uint32_t index) const
+        {
+            return masks_->test(index, component_index_) ? &accessor_(index) : nullptr;
+        }
+
+        void Bind(Archetype & archetype, std::uint32_t chunk)
+        {
+            bound_ = archetype.mask()[component_index_];
+            if (bound_)
+            {
+                accessor_.Bind(archetype, chunk);
+            }
+        }
+
+        T * operator[](std::uint32_t row) const
+        {
+            return bound_ ? &accessor_[row] : nullptr;
+        }
+
+        /// Marks the component changed like `ComponentAccessor::Mark`, when the entity indexed INDEX has it.
+        template <typename Manager>
+        void Mark(Manager & manager, std::uint32_t index) const
+        {
+            if (std::is_same<typename ComponentChanges<T>::type, TrackedChanges>::value && masks_->test(index, component_index_))
+            {
+                manager.MarkChanged(index, component_index_);
+            }
+        }
+
+    private:
+        std::uint16_t component_index_;
+        ComponentAccessor<T> accessor_;
+        const MaskTable * masks_;
+        bool bound_;
+    };
+}
@@ -3,8 +3,19 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <stdexcept>
 #include <cassert>
 
+#include "sparse_set.hpp"
+#include "dynamic_constructor.hpp"
+#include "snapshot.hpp"
+
 namespace bent
 {
     struct ComponentPoolInterface
@@ -12,7 +23,49 @@ namespace bent
         virtual ~ComponentPoolInterface() = default;
 
         virtual void * Allocate(std::uint32_t index) = 0;
+        virtual void Deallocate(std::uint32_t index) = 0;
         virtual void * Get(std::uint32_t index) = 0;
+
+        /// Returns a pointer to the component of the entity indexed INDEX for reading, which doesn't copy blocks shared with a fork.
+        virtual const void * Get(std::uint32_t index) const = 0;
+
+        /// Destructs components of COUNT entities indexed INDICES with CONSTRUCTOR and releases their memory.
+        ///
+        /// Pools knowing the component type override this to destruct without virtual calls.
+        virtual void Release(const std::uint32_t * indices, std::size_t count, DynamicConstructorInterface & constructor)
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                constructor.Destroy(Get(indices[i]));
+                Deallocate(indices[i]);
+            }
+        }
+
+        /// Prepares memory for components of COUNT entities. Does nothing by default.
+        virtual void Reserve(std::size_t)
+        {
+        }
+
+        /// Returns indices of entities that have a component in this pool, or nullptr when the pool doesn't track them.
+        virtual const SparseSet * owners() const = 0;
+
+        /// Returns a pool of the same type holding copies of the components, for a forked world.
+        ///
+        /// OWNERS are indices of entities having components in ascending order,
+        /// given only when the pool doesn't track them and the components aren't trivially copyable.
+        virtual ComponentPoolInterface * Fork(const std::vector<std::uint32_t> & owners) = 0;
+
+        /// Writes the components to WRITER as `SnapshotEncoding::Blocks` and returns true, or returns false when the pool can't.
+        virtual bool Save(SnapshotWriter &)
+        {
+            return false;
+        }
+
+        /// Reads components `Save` wrote from READER and returns true, or returns false when the pool can't.
+        virtual bool Load(SnapshotReader &)
+        {
+            return false;
+        }
     };
 
     template <typename T>
@@ -36,9 +89,50 @@ namespace bent
             auto & block = blocks_[i];
             if (!block)
             {
-                block.reset(new Element[block_size_]);
+                block.reset(NewBlock(), std::default_delete<Element []>());
             }
-            return std::addressof(block[j]);
+            else
+            {
+                Unshare(i);
+            }
+            return std::addressof(block.get()[j]);
+        }
+
+        /// Destructs components of COUNT entities indexed INDICES. Nothing is done for trivially destructible types.
+        virtual void Release(const std::uint32_t * indices, std::size_t count, DynamicConstructorInterface &) override
+        {
+            if (std::is_trivially_destructible<T>::value)
+            {
+                return;
+            }
+            for (std::size_t i = 0; i < count; i++)
+            {
+                GetRef(indices[i]).~T();
+            }
+        }
+
+        /// Allocates blocks for the entities indexed 0 to COUNT - 1.
+        virtual void Reserve(std::size_t count) override
+        {
+            auto blocks = (count + block_size_ - 1) / block_size_;
+            if (blocks_.size() < blocks)
+            {
+                blocks_.resize(blocks);
+            }
+            for (std::size_t i = 0; i < blocks; i++)
+            {
+                if (!blocks_[i])
+                {
+                    blocks_[i].reset(NewBlock(), std::default_delete<Element []>());
+                }
+            }
+        }
+
+        /// Releases a memory allocated for the entity indexed INDEX.
+        ///
+        /// Blocks are kept for reuse, so this does nothing.
+        virtual void Deallocate(std::uint32_t) override
+        {
         }
 
         /// Returns a pointer refering the component of the entity indexed INDEX.
@@ -47,21 +141,381 @@ namespace bent
             return std::addressof(GetRef(index));
         }
 
-    private:
+        virtual const void * Get(std::uint32_t index) const override
+        {
+            return std::addressof(GetRef(index));
+        }
 
+        virtual const SparseSet * owners() const override
+        {
+            return nullptr;
+        }
+
+        /// Returns a pool for a forked world.
+        ///
+        /// Blocks of trivially copyable components are shared by both pools, and copied by either when first accessed mutably,
+        /// so forking costs a pointer per block. Other components of OWNERS are copy-constructed.
+        virtual ComponentPoolInterface * Fork(const std::vector<std::uint32_t> & owners) override
+        {
+            std::unique_ptr<ComponentPool> fork(new ComponentPool(block_size_ * sizeof(T)));
+            Share(*fork, owners, std::is_trivially_copyable<T>());
+            return fork.release();
+        }
+
+        /// Writes allocated blocks of trivially copyable components as they are: the number of components in a block,
+        /// the number of blocks and their indices, then each block aligned.
+        virtual bool Save(SnapshotWriter & writer) override
+        {
+            return Save(writer, std::integral_constant<bool, std::is_trivially_copyable<T>::value && alignof(T) <= SNAPSHOT_ALIGNMENT>());
+        }
+
+        /// Adopts blocks in the memory of READER's file, so loading costs a pointer per block.
+        ///
+        /// When blocks of the file hold a different number of components, they are copied instead.
+        virtual bool Load(SnapshotReader & reader) override
+        {
+            return Load(reader, std::integral_constant<bool, std::is_trivially_copyable<T>::value && alignof(T) <= SNAPSHOT_ALIGNMENT>());
+        }
+
+        /// Returns the number of components in a block.
+        std::size_t block_size() const
+        {
+            return block_size_;
+        }
+
+        /// Returns the component of the entity indexed INDEX without a virtual call.
+        ///
+        /// The block of the component is copied first when it's shared with a fork.
         T& GetRef(std::uint32_t index)
+        {
+            if (std::is_trivially_copyable<T>::value && shared_count_ != 0)
+            {
+                Unshare(index / block_size_);
+            }
+            return const_cast<T&>(static_cast<const ComponentPool&>(*this).GetRef(index));
+        }
+
+        /// Returns the component of the entity indexed INDEX for reading, leaving its block shared with a fork.
+        const T& GetRef(std::uint32_t index) const
         {
             auto i = index / block_size_;
             auto j = index % block_size_;
             assert(i < blocks_.size());
             auto & block = blocks_[i];
             assert(block);
-            return *reinterpret_cast<T*>(std::addressof(block[j]));
+            return *reinterpret_cast<const T*>(std::addressof(block.get()[j]));
+        }
+
+    private:
+
+        using Element = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+        using BlockContainer = std::vector<std::shared_ptr<Element>>;
+
+        /// Allocates a block. Blocks of trivially copyable components are zeroed, as `Save` writes them whole, slots not owned included.
+        Element * NewBlock() const
+        {
+            return std::is_trivially_copyable<T>::value ? new Element[block_size_]() : new Element[block_size_];
+        }
+
+        /// Shares blocks with FORK, marking them shared in both pools.
+        void Share(ComponentPool & fork, const std::vector<std::uint32_t> &, std::true_type)
+        {
+            fork.blocks_ = blocks_;
+            MarkShared();
+            fork.MarkShared();
+        }
+
+        /// Copy-constructs components of OWNERS into FORK.
+        void Share(ComponentPool & fork, const std::vector<std::uint32_t> & owners, std::false_type)
+        {
+            for (auto index : owners)
+            {
+                new (fork.Allocate(index)) T(GetRef(index));
+            }
+        }
+
+        bool Save(SnapshotWriter &, std::false_type)
+        {
+            return false;
+        }
+
+        bool Save(SnapshotWriter & writer, std::true_type)
+        {
+            std::vector<std::uint32_t> indices;
+            for (std::size_t i = 0; i < blocks_.size(); i++)
+            {
+                if (blocks_[i])
+                {
+                    indices.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+            writer.Write(std::uint64_t(block_size_));
+            writer.Write(std::uint64_t(indices.size()));
+            writer.Write(indices.data(), indices.size() * sizeof(std::uint32_t));
+            for (auto i : indices)
+            {
+                writer.Align();
+                writer.Write(blocks_[i].get(), block_size_ * sizeof(T));
+            }
+            return true;
+        }
+
+        bool Load(SnapshotReader &, std::false_type)
+        {
+            return false;
+        }
+
+        bool Load(SnapshotReader & reader, std::true_type)
+        {
+            auto block_size = reader.Read<std::uint64_t>();
+            auto count = reader.Read<std::uint64_t>();
+            if (block_size == 0 || (count != 0 && block_size > reader.file()->size() / sizeof(T)) || count > reader.file()->size() / sizeof(std::uint32_t))
+            {
+                throw std::runtime_error("the snapshot is corrupted");
+            }
+            std::vector<std::uint32_t> indices(count);
+            if (count != 0)
+            {
+                std::memcpy(indices.data(), reader.Take(count * sizeof(std::uint32_t)), count * sizeof(std::uint32_t));
+            }
+            for (auto i : indices)
+            {
+                if ((std::uint64_t(i) + 1) * block_size > (std::uint64_t(1) << 32))
+                {
+                    throw std::runtime_error("the snapshot is corrupted");
+                }
+                reader.Align();
+                auto data = reader.Take(block_size * sizeof(T));
+                if (block_size == block_size_)
+                {
+                    if (blocks_.size() <= i)
+                    {
+                        blocks_.resize(i + 1);
+                    }
+                    // shares ownership of the file, so it is unmapped when its last block is released.
+                    blocks_[i] = std::shared_ptr<Element>(reader.file(), reinterpret_cast<Element*>(data));
+                    continue;
+                }
+                // copies the block in runs, each within a block of this pool.
+                for (std::uint64_t j = 0; j < block_size;)
+                {
+                    auto index = static_cast<std::uint32_t>(i * block_size + j);
+                    auto run = std::min<std::uint64_t>(block_size - j, block_size_ - index % block_size_);
+                    std::memcpy(Allocate(index), data + j * sizeof(T), run * sizeof(T));
+                    j += run;
+                }
+            }
+            return true;
         }
 
+        void MarkShared()
+        {
+            shared_count_ = blocks_.size();
+            shared_.reset(new std::atomic<bool>[shared_count_]);
+            for (std::size_t i = 0; i < shared_count_; i++)
+            {
+                shared_[i].store(static_cast<bool>(blocks_[i]), std::memory_order_relaxed);
+            }
+        }
+
+        /// Copies the block I when another pool still shares it, so writes to it aren't seen by the other pool.
+        void Unshare(std::size_t i)
+        {
+            if (i < shared_count_ && shared_[i].load(std::memory_order_acquire))
+            {
+                CopyShared(i);
+            }
+        }
+
+        /// Tasks of `World::parallel_each` may reach a block at once, so the copy is made under a lock.
+        void CopyShared(std::size_t i)
+        {
+            std::lock_guard<std::mutex> lock(unshare_mutex_);
+            if (!shared_[i].load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            if (blocks_[i].use_count() > 1)
+            {
+                std::shared_ptr<Element> copy(new Element[block_size_], std::default_delete<Element []>());
+                std::memcpy(copy.get(), blocks_[i].get(), block_size_ * sizeof(Element));
+                blocks_[i] = std::move(copy);
+            }
+            shared_[i].store(false, std::memory_order_release);
+        }
+
+        BlockContainer blocks_;
+        std::size_t block_size_;
+
+        // whether each block was shared with a fork and not copied since, for blocks existing when forked.
+        std::unique_ptr<std::atomic<bool> []> shared_;
+        std::size_t shared_count_ = 0;
+        std::mutex unshare_mutex_;
+    };
+
+    /// A pool that packs components of the entities owning them into contiguous blocks.
+    ///
+    /// Memory is proportional to the number of owners, not to the largest entity index.
+    /// Deallocation moves the last component into the freed slot, so a pointer to a component is valid
+    /// until any component of this pool is removed.
+    template <typename T>
+    struct PackedComponentPool : ComponentPoolInterface
+    {
+        explicit PackedComponentPool(std::size_t chunk_size = 8192) :
+            block_size_(chunk_size < sizeof(T) ? 1 : chunk_size / sizeof(T))
+        {}
+
+        /// Allocates a memory for a component of the entity indexed INDEX at the end of the packed array.
+        ///
+        /// Notice: You must construct and destruct allocated memory on your responsibility.
+        virtual void * Allocate(std::uint32_t index) override
+        {
+            auto position = owners_.contains(index) ? owners_.position(index) : owners_.Insert(index);
+            auto i = position / block_size_;
+            if (blocks_.size() <= i)
+            {
+                blocks_.resize(i + 1);
+            }
+            auto & block = blocks_[i];
+            if (!block)
+            {
+                block.reset(new Element[block_size_]);
+            }
+            return std::addressof(block[position % block_size_]);
+        }
+
+        /// Destructs components of COUNT entities indexed INDICES and packs the rest.
+        virtual void Release(const std::uint32_t * indices, std::size_t count, DynamicConstructorInterface &) override
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                GetRef(indices[i]).~T();
+                Deallocate(indices[i]);
+            }
+        }
+
+        /// Allocates blocks for COUNT owners.
+        virtual void Reserve(std::size_t count) override
+        {
+            owners_.Reserve(count);
+            auto blocks = (count + block_size_ - 1) / block_size_;
+            if (blocks_.size() < blocks)
+            {
+                blocks_.resize(blocks);
+            }
+            for (std::size_t i = 0; i < blocks; i++)
+            {
+                if (!blocks_[i])
+                {
+                    blocks_[i].reset(new Element[block_size_]);
+                }
+            }
+        }
+
+        /// Releases a memory allocated for the entity indexed INDEX.
+        ///
+        /// The component must have been destructed. The last component is moved into the freed slot.
+        virtual void Deallocate(std::uint32_t index) override
+        {
+            auto position = owners_.position(index);
+            auto last = owners_.size() - 1;
+            if (position != last)
+            {
+                auto & src = at(last);
+                new (std::addressof(at(position))) T(std::move(src));
+                src.~T();
+            }
+            owners_.Erase(index);
+        }
+
+        /// Returns a pointer refering the component of the entity indexed INDEX.
+        virtual void * Get(std::uint32_t index) override
+        {
+            return std::addressof(GetRef(index));
+        }
+
+        virtual const void * Get(std::uint32_t index) const override
+        {
+            return std::addressof(GetRef(index));
+        }
+
+        virtual const SparseSet * owners() const override
+        {
+            return &owners_;
+        }
+
+        /// Returns a pool for a forked world, copy-constructing components block by block in the same order.
+        virtual ComponentPoolInterface * Fork(const std::vector<std::uint32_t> &) override
+        {
+            std::unique_ptr<PackedComponentPool> fork(new PackedComponentPool(block_size_ * sizeof(T)));
+            fork->Reserve(owners_.size());
+            DynamicConstructor<T> constructor;
+            for (std::uint32_t position = 0; position < owners_.size(); position += static_cast<std::uint32_t>(block_size_))
+            {
+                auto count = std::min<std::size_t>(block_size_, owners_.size() - position);
+                constructor.CopyConstruct(std::addressof(fork->at(position)), std::addressof(at(position)), count);
+            }
+            fork->owners_ = owners_;
+            return fork.release();
+        }
+
+        /// Returns the number of components in a block.
+        std::size_t block_size() const
+        {
+            return block_size_;
+        }
+
+        /// Returns the component of the entity indexed INDEX without a virtual call.
+        T& GetRef(std::uint32_t index)
+        {
+            return at(owners_.position(index));
+        }
+
+        const T& GetRef(std::uint32_t index) const
+        {
+            return at(owners_.position(index));
+        }
+
+        /// Returns the component at POSITION of the packed array.
+        ///
+        /// Components up to the end of its block follow it contiguously.
+        T& at(std::uint32_t position)
+        {
+            return const_cast<T&>(static_cast<const PackedComponentPool&>(*this).at(position));
+        }
+
+        const T& at(std::uint32_t position) const
+        {
+            auto i = position / block_size_;
+            assert(i < blocks_.size());
+            auto & block = blocks_[i];
+            assert(block);
+            return *reinterpret_cast<const T*>(std::addressof(block[position % block_size_]));
+        }
+
+        /// Swaps components and owners at positions LHS and RHS of the packed array.
+        void Swap(std::uint32_t lhs, std::uint32_t rhs)
+        {
+            if (lhs == rhs)
+            {
+                return;
+            }
+            auto & a = at(lhs);
+            auto & b = at(rhs);
+            T tmp(std::move(a));
+            a.~T();
+            new (std::addressof(a)) T(std::move(b));
+            b.~T();
+            new (std::addressof(b)) T(std::move(tmp));
+            owners_.Swap(lhs, rhs);
+        }
+
+    private:
+
         using Element = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
         using BlockContainer = std::vector<std::unique_ptr<Element []>>;
 
+        SparseSet owners_;
         BlockContainer blocks_;
         std::size_t block_size_;
     };
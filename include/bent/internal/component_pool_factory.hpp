@@ -1,6 +1,7 @@
 #pragma once
 
 #include "component_pool.hpp"
+#include "../component_storage.hpp"
 
 namespace bent
 {
@@ -16,7 +17,7 @@ namespace bent
     {
         virtual ComponentPoolInterface * Create(std::size_t chunk_size = 8192)
         {
-            return new ComponentPool<T>(chunk_size);
+            return new typename ComponentStorage<T>::type(chunk_size);
         }
     };
 }
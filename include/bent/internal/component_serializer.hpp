@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <new>
+#include <utility>
+#include <functional>
+
+namespace bent
+{
+    /// Converts components to and from bytes for snapshots, for types that can't be saved as their bytes.
+    struct ComponentSerializerInterface
+    {
+        virtual ~ComponentSerializerInterface() = default;
+
+        /// Appends bytes of the component at P to OUT.
+        virtual void Save(const void * p, std::string & out) = 0;
+
+        /// Constructs a component at P from SIZE bytes at DATA that `Save` wrote.
+        virtual void Load(void * p, const char * data, std::size_t size) = 0;
+    };
+
+    template <typename T>
+    struct ComponentSerializer : ComponentSerializerInterface
+    {
+        using SaveFunction = std::function<void(const T&, std::string&)>;
+        using LoadFunction = std::function<T(const char*, std::size_t)>;
+
+        ComponentSerializer(SaveFunction save, LoadFunction load) :
+            save_(std::move(save)),
+            load_(std::move(load))
+        {}
+
+        virtual void Save(const void * p, std::string & out) override
+        {
+            save_(*static_cast<const T*>(p), out);
+        }
+
+        virtual void Load(void * p, const char * data, std::size_t size) override
+        {
+            new (p) T(load_(data, size));
+        }
+
+    private:
+
+        SaveFunction save_;
+        LoadFunction load_;
+    };
+}
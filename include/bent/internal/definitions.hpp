@@ -2,8 +2,121 @@
 
 #include <cstdint>
 #include <limits>
+#include <cstddef>
+#include <bitset>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace bent
 {
     constexpr std::uint16_t MAX_COMPONENTS = 256;
+    constexpr std::uint32_t SPARSE_PAGE_SIZE = 4096;
+    constexpr std::size_t ARCHETYPE_CHUNK_SIZE = 16384;
+    constexpr std::size_t COMMAND_BUFFER_BLOCK_SIZE = 65536;
+
+    constexpr std::uint32_t MAX_MASK_WORDS = (MAX_COMPONENTS + 63) / 64;
+    constexpr std::size_t MASK_TABLE_ALIGNMENT = 64;
+
+    using ComponentMask = std::bitset<MAX_COMPONENTS>;
+
+    /// Returns the index of the lowest set bit of WORD, which must not be 0.
+    inline std::uint32_t CountTrailingZeros(std::uint64_t word)
+    {
+#if defined(__GNUC__)
+        return static_cast<std::uint32_t>(__builtin_ctzll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return static_cast<std::uint32_t>(index);
+#else
+        std::uint32_t index = 0;
+        while ((word & 1) == 0)
+        {
+            word >>= 1;
+            ++index;
+        }
+        return index;
+#endif
+    }
+
+    /// Returns the number of bits set in WORD.
+    inline std::uint32_t PopCount(std::uint64_t word)
+    {
+#if defined(__GNUC__)
+        return static_cast<std::uint32_t>(__builtin_popcountll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+        return static_cast<std::uint32_t>(__popcnt64(word));
+#else
+        std::uint32_t count = 0;
+        for (; word != 0; word &= word - 1)
+        {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    /// Calls FN with the index of each component set in MASK, in ascending order.
+    ///
+    /// Only set bits are visited, by find-first-set where the standard library provides it.
+    template <typename F>
+    inline void ForEachComponent(const ComponentMask & mask, F fn)
+    {
+#if defined(__GLIBCXX__)
+        for (auto i = mask._Find_first(); i < MAX_COMPONENTS; i = mask._Find_next(i))
+        {
+            fn(static_cast<std::uint16_t>(i));
+        }
+#else
+        auto remaining = mask.count();
+        for (std::uint16_t i = 0; remaining != 0; i++)
+        {
+            if (mask[i])
+            {
+                fn(i);
+                --remaining;
+            }
+        }
+#endif
+    }
+
+    /// Selects how a world stores components.
+    enum class StorageBackend
+    {
+        /// Each component type is stored in its own pool.
+        ComponentPools,
+        /// Entities with the same set of component types share chunks holding a column per type.
+        Archetypes,
+    };
+
+    /// Selects how a world evaluates queries over component masks.
+    enum class MaskLayout
+    {
+        /// A row of words per entity holds its components, so entities are tested mask by mask.
+        Rows,
+        /// Each component also keeps a bitmap over entity indices, so queries AND a word of each queried bitmap.
+        Columns,
+    };
+
+    /// Selects how `World::sort` orders components.
+    enum class SortAlgorithm
+    {
+        /// `std::sort`, for components in any order.
+        Standard,
+        /// Insertion sort, taking linear time for components nearly sorted already, e.g. sorted in the last frame.
+        Insertion,
+    };
+
+    /// Lifecycle events of components observed by `World::Observe`.
+    enum class ComponentEvent
+    {
+        /// The component was added to an entity.
+        Add,
+        /// The component was removed from an entity staying alive.
+        Remove,
+        /// An entity having the component was destroyed.
+        Destroy,
+    };
 }
@@ -1,19 +1,73 @@
 #pragma once
 
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <type_traits>
+
 namespace bent
 {
     struct DynamicConstructorInterface
     {
         virtual ~DynamicConstructorInterface() = default;
 
+        virtual std::size_t size() const = 0;
+        virtual std::size_t alignment() const = 0;
+
+        /// Returns whether Destroy does nothing, so callers may skip it.
+        virtual bool trivially_destructible() const = 0;
+
+        /// Returns whether objects may be copied, moved and relocated by copying their bytes.
+        virtual bool trivially_copyable() const = 0;
+
         virtual void CopyConstruct(void* p, const void* src) = 0;
         virtual void MoveConstruct(void* p, void* src) = 0;
         virtual void Destroy(void* p) = 0;
+
+        /// Move-constructs the object at P from SRC and destructs SRC.
+        virtual void Relocate(void* p, void* src) = 0;
+
+        /// Copy-constructs COUNT contiguous objects at P from as many at SRC, which must not overlap.
+        virtual void CopyConstruct(void* p, const void* src, std::size_t count) = 0;
+
+        /// Move-constructs COUNT contiguous objects at P from as many at SRC, which must not overlap.
+        virtual void MoveConstruct(void* p, void* src, std::size_t count) = 0;
+
+        /// Destructs COUNT contiguous objects at P.
+        virtual void Destroy(void* p, std::size_t count) = 0;
+
+        /// Relocates COUNT contiguous objects at SRC to P like `Relocate`. They must not overlap.
+        virtual void Relocate(void* p, void* src, std::size_t count) = 0;
     };
 
+    /// Constructs and destructs objects of type T through `DynamicConstructorInterface`.
+    ///
+    /// Copying, moving and relocating trivially copyable types copy bytes, and destructing trivially destructible types does nothing,
+    /// so operations on many objects cost a virtual call and a `memcpy`.
     template<typename T>
     struct DynamicConstructor : DynamicConstructorInterface
     {
+        virtual std::size_t size() const override
+        {
+            return sizeof(T);
+        }
+
+        virtual std::size_t alignment() const override
+        {
+            return alignof(T);
+        }
+
+        virtual bool trivially_destructible() const override
+        {
+            return std::is_trivially_destructible<T>::value;
+        }
+
+        virtual bool trivially_copyable() const override
+        {
+            return Trivial::value;
+        }
+
         virtual void CopyConstruct(void* p, const void* src) override
         {
             const T& ref = *static_cast<const T*>(src);
@@ -30,5 +84,94 @@ namespace bent
         {
             static_cast<T*>(p)->~T();
         }
+
+        virtual void Relocate(void* p, void* src) override
+        {
+            Relocate(p, src, 1, Trivial());
+        }
+
+        virtual void CopyConstruct(void* p, const void* src, std::size_t count) override
+        {
+            CopyConstruct(p, src, count, Trivial());
+        }
+
+        virtual void MoveConstruct(void* p, void* src, std::size_t count) override
+        {
+            MoveConstruct(p, src, count, Trivial());
+        }
+
+        virtual void Destroy(void* p, std::size_t count) override
+        {
+            Destroy(p, count, std::is_trivially_destructible<T>());
+        }
+
+        virtual void Relocate(void* p, void* src, std::size_t count) override
+        {
+            Relocate(p, src, count, Trivial());
+        }
+
+    private:
+
+        using Trivial = std::is_trivially_copyable<T>;
+
+        static void CopyConstruct(void* p, const void* src, std::size_t count, std::true_type)
+        {
+            std::memcpy(p, src, count * sizeof(T));
+        }
+
+        static void CopyConstruct(void* p, const void* src, std::size_t count, std::false_type)
+        {
+            auto to = static_cast<T*>(p);
+            auto from = static_cast<const T*>(src);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                new (to + i) T(from[i]);
+            }
+        }
+
+        static void MoveConstruct(void* p, void* src, std::size_t count, std::true_type)
+        {
+            std::memcpy(p, src, count * sizeof(T));
+        }
+
+        static void MoveConstruct(void* p, void* src, std::size_t count, std::false_type)
+        {
+            auto to = static_cast<T*>(p);
+            auto from = static_cast<T*>(src);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                new (to + i) T(std::move(from[i]));
+            }
+        }
+
+        static void Destroy(void*, std::size_t, std::true_type)
+        {
+        }
+
+        static void Destroy(void* p, std::size_t count, std::false_type)
+        {
+            auto objects = static_cast<T*>(p);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                objects[i].~T();
+            }
+        }
+
+        // trivially copyable types have trivial destructors too.
+        static void Relocate(void* p, void* src, std::size_t count, std::true_type)
+        {
+            std::memcpy(p, src, count * sizeof(T));
+        }
+
+        static void Relocate(void* p, void* src, std::size_t count, std::false_type)
+        {
+            auto to = static_cast<T*>(p);
+            auto from = static_cast<T*>(src);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                new (to + i) T(std::move(from[i]));
+                from[i].~T();
+            }
+        }
     };
 }
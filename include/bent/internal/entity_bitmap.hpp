@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#include "definitions.hpp"
+
+namespace bent
+{
+    /// A bit per entity index, packed in 64-bit words.
+    ///
+    /// Bits past the last word are read as 0, so bitmaps of different lengths can be ANDed word by word.
+    struct EntityBitmap
+    {
+        /// Returns the number of words holding bits.
+        std::size_t word_count() const
+        {
+            return words_.size();
+        }
+
+        /// Returns the words of all bits.
+        const std::uint64_t * data() const
+        {
+            return words_.data();
+        }
+
+        /// Returns bits of entities 64 * I to 64 * I + 63.
+        std::uint64_t word(std::size_t i) const
+        {
+            return i < words_.size() ? words_[i] : 0;
+        }
+
+        /// Returns bits of entities FIRST to FIRST + COUNT - 1. Bit i is for the entity FIRST + i.
+        ///
+        /// COUNT must be 1 to 64.
+        std::uint64_t bits(std::uint32_t first, std::uint32_t count) const
+        {
+            assert(count != 0 && count <= 64);
+            auto shift = first % 64;
+            auto bits = word(first / 64) >> shift;
+            if (shift != 0 && shift + count > 64)
+            {
+                bits |= word(first / 64 + 1) << (64 - shift);
+            }
+            return count == 64 ? bits : bits & ((std::uint64_t(1) << count) - 1);
+        }
+
+        bool test(std::uint32_t index) const
+        {
+            return (word(index / 64) >> (index % 64)) & 1;
+        }
+
+        /// Returns the number of bits set.
+        std::size_t count() const
+        {
+            std::size_t count = 0;
+            for (auto word : words_)
+            {
+                count += PopCount(word);
+            }
+            return count;
+        }
+
+        /// Sets the bit INDEX, growing the bitmap to hold it.
+        void Set(std::uint32_t index)
+        {
+            if (index / 64 >= words_.size())
+            {
+                words_.resize(index / 64 + 1);
+            }
+            words_[index / 64] |= std::uint64_t(1) << (index % 64);
+        }
+
+        void Reset(std::uint32_t index)
+        {
+            if (index / 64 < words_.size())
+            {
+                words_[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+            }
+        }
+
+        /// Grows the bitmap to SIZE bits, setting the new bits to VALUE.
+        void Resize(std::uint32_t size, bool value)
+        {
+            assert(size >= size_);
+            words_.resize((std::size_t(size) + 63) / 64);
+            if (value)
+            {
+                for (auto index = size_; index < size;)
+                {
+                    auto bits = std::min<std::uint32_t>(64 - index % 64, size - index);
+                    auto ones = bits == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << bits) - 1;
+                    words_[index / 64] |= ones << (index % 64);
+                    index += bits;
+                }
+            }
+            size_ = size;
+        }
+
+        /// Replaces bits by SIZE bits from WORDS, a word per 64 bits.
+        void Assign(const std::uint64_t * words, std::uint32_t size)
+        {
+            words_.assign(words, words + (std::size_t(size) + 63) / 64);
+            if (size % 64 != 0)
+            {
+                words_.back() &= (std::uint64_t(1) << (size % 64)) - 1;
+            }
+            size_ = size;
+        }
+
+        void Reserve(std::size_t count)
+        {
+            words_.reserve((count + 63) / 64);
+        }
+
+    private:
+
+        std::vector<std::uint64_t> words_;
+        std::uint32_t size_ = 0;
+    };
+}
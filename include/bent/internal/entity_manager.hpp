@@ -2,13 +2,25 @@
 
 #include <cstdint>
 #include <vector>
-#include <stack>
-#include <bitset>
 #include <utility>
 #include <memory>
+#include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <string>
+#include <cstring>
 
 #include "definitions.hpp"
 #include "component_pool.hpp"
+#include "archetype_storage.hpp"
+#include "mask_table.hpp"
+#include "occupancy_summary.hpp"
+#include "entity_bitmap.hpp"
+#include "roaring_set.hpp"
+#include "change_ticks.hpp"
+#include "snapshot.hpp"
 #include "../component_manager.hpp"
 
 namespace bent
@@ -18,51 +30,178 @@ namespace bent
 
     struct EntityManager
     {
-        using ComponentMask = std::bitset<MAX_COMPONENTS>;
+        using ComponentMask = bent::ComponentMask;
+
+        /// Called with ids of entities, as `EntityHandle::id` gives, that an observed event happened to.
+        using Observer = std::function<void(const std::uint64_t * ids, std::size_t count)>;
 
         std::pair<std::uint32_t, std::uint32_t> CreateEntity()
         {
+            ThrowsIfLocked();
             if (free_list_.empty())
             {
                 std::uint32_t index = entity_versions_.size();
-                entity_alive_flags_.emplace_back(true);
+                entity_alive_flags_.Resize(index + 1, true);
                 entity_versions_.emplace_back(0);
-                entity_component_masks_.emplace_back();
+                entity_component_masks_.Resize(index + 1);
+                Appear(index);
                 return std::pair<std::uint32_t, std::uint32_t>(index, 0);
             }
             else
             {
-                auto index = free_list_.top(); free_list_.pop();
+                auto index = free_list_.back(); free_list_.pop_back();
                 auto version = entity_versions_[index]; // version is incremented at DestroyEntity
-                assert(entity_alive_flags_[index] == false);
-                entity_alive_flags_[index] = true;
+                assert(!entity_alive_flags_.test(index));
+                entity_alive_flags_.Set(index);
+                Appear(index);
                 return std::pair<std::uint32_t, std::uint32_t>(index, version);
             }
         }
 
-        void DestroyEntity(std::uint32_t index)
+        /// Creates COUNT entities, calling FN with the index and the version of each.
+        ///
+        /// Free slots are reused first, then entity tables grow once for the rest.
+        template <typename F>
+        void CreateEntities(std::size_t count, F fn)
         {
-            auto && aliver = entity_alive_flags_[index];
-            if (!aliver)
+            ThrowsIfLocked();
+            auto reused = std::min(count, free_list_.size());
+            for (std::size_t i = 0; i < reused; i++)
             {
-                throw std::out_of_range("This entity has already have dead");
+                auto index = free_list_[free_list_.size() - 1 - i];
+                assert(!entity_alive_flags_.test(index));
+                entity_alive_flags_.Set(index);
+                Appear(index);
+                fn(index, entity_versions_[index]);
+            }
+            free_list_.resize(free_list_.size() - reused);
+
+            auto first = static_cast<std::uint32_t>(entity_versions_.size());
+            auto size = first + (count - reused);
+            entity_alive_flags_.Resize(size, true);
+            entity_versions_.resize(size, 0);
+            entity_component_masks_.Resize(size);
+            for (auto index = first; index < size; index++)
+            {
+                Appear(index);
+                fn(index, 0u);
+            }
+        }
+
+        /// Reserves entity tables for COUNT entities, and storage of components in MASK for as many entities.
+        void Reserve(std::size_t count, const ComponentMask & mask)
+        {
+            entity_alive_flags_.Reserve(count);
+            entity_versions_.reserve(count);
+            entity_component_masks_.Reserve(count);
+            if (archetypes_)
+            {
+                archetypes_->Reserve(count, mask);
+                return;
             }
-            auto & mask = entity_component_masks_[index];
             for (std::uint16_t i = 0; i < MAX_COMPONENTS; i++)
             {
-                if (mask[i])
+                if (mask[i] && !is_tag(i))
                 {
-                    RemoveComponent(index, i);
+                    component_pool(i).Reserve(count);
                 }
             }
-            aliver = false;
+        }
+
+        void DestroyEntity(std::uint32_t index)
+        {
+            ThrowsIfLocked();
+            if (!entity_alive_flags_.test(index))
+            {
+                throw std::out_of_range("This entity has already have dead");
+            }
+            if (archetypes_)
+            {
+                archetypes_->Destroy(index);
+                entity_component_masks_.ForEach(index, [&](std::uint16_t i)
+                {
+                    Record(index, i, ComponentEvent::Destroy);
+                    Vacate(index, i);
+                });
+                entity_component_masks_.Clear(index);
+            }
+            else
+            {
+                ForEachComponent(entity_component_masks_.mask(index), [&](std::uint16_t i)
+                {
+                    Record(index, i, ComponentEvent::Destroy);
+                    Detach(index, i);
+                });
+            }
+            Forget(index);
+            entity_alive_flags_.Reset(index);
             ++entity_versions_[index];
-            free_list_.push(index);
+            free_list_.push_back(index);
+        }
+
+        /// Destroys alive entities indexed INDICES, each at most once.
+        ///
+        /// Components are destructed per component type, one pool at a time.
+        void DestroyEntities(const std::vector<std::uint32_t> & indices)
+        {
+            ThrowsIfLocked();
+            if (archetypes_)
+            {
+                archetypes_->Destroy(indices);
+                for (auto index : indices)
+                {
+                    entity_component_masks_.ForEach(index, [&](std::uint16_t i)
+                    {
+                        Record(index, i, ComponentEvent::Destroy);
+                        Vacate(index, i);
+                    });
+                }
+            }
+            else
+            {
+                std::vector<std::vector<std::uint32_t>> owners(MAX_COMPONENTS);
+                for (auto index : indices)
+                {
+                    entity_component_masks_.ForEach(index, [&](std::uint16_t i)
+                    {
+                        owners[i].push_back(index);
+                    });
+                }
+                auto & manager = ComponentManager::instance();
+                for (std::uint16_t i = 0; i < MAX_COMPONENTS; i++)
+                {
+                    if (!owners[i].empty())
+                    {
+                        for (auto index : owners[i])
+                        {
+                            Record(index, i, ComponentEvent::Destroy);
+                            Leave(index, i);
+                        }
+                        if (!is_tag(i))
+                        {
+                            component_pool(i).Release(owners[i].data(), owners[i].size(), manager.dynamic_constructor(i));
+                        }
+                        for (auto index : owners[i])
+                        {
+                            Vacate(index, i);
+                        }
+                    }
+                }
+            }
+            free_list_.reserve(free_list_.size() + indices.size());
+            for (auto index : indices)
+            {
+                entity_component_masks_.Clear(index);
+                Forget(index);
+                entity_alive_flags_.Reset(index);
+                ++entity_versions_[index];
+                free_list_.push_back(index);
+            }
         }
 
         bool alive(std::uint32_t index) const
         {
-            return entity_alive_flags_[index];
+            return entity_alive_flags_.test(index);
         }
 
         std::uint32_t version(std::uint32_t index) const
@@ -72,86 +211,1540 @@ namespace bent
 
         ComponentMask component_mask(std::uint32_t index) const
         {
-            return entity_component_masks_[index];
+            return entity_component_masks_.mask(index);
+        }
+
+        bool has_component(std::uint32_t index, std::uint16_t component_index) const
+        {
+            return entity_component_masks_.test(index, component_index);
+        }
+
+        /// Returns whether the entity indexed INDEX has all components of QUERY.
+        bool matches(std::uint32_t index, const MaskQuery & query) const
+        {
+            return entity_component_masks_.Contains(index, query);
+        }
+
+        /// Returns a bitmap of alive entities indexed FIRST to FIRST + COUNT - 1 having all components QUERY requires and none it excludes.
+        ///
+        /// Bit i is for the entity FIRST + i. COUNT must be at most 64.
+        std::uint64_t match_block(std::uint32_t first, std::uint32_t count, const MaskQuery & query) const
+        {
+            if (query.tested_size == 0)
+            {
+                return entity_alive_flags_.bits(first, count);
+            }
+            // masks of dead entities are empty, so they only match a query requiring nothing.
+            auto matches = query.size == 0 ? entity_alive_flags_.bits(first, count) : ~std::uint64_t(0);
+            if (component_bitmaps_.empty())
+            {
+                return matches & entity_component_masks_.Match(first, count, query);
+            }
+            for (std::uint32_t j = 0; j < query.tested_size && matches != 0; j++)
+            {
+                for (auto word = query.tested[j]; word != 0; word &= word - 1)
+                {
+                    auto bit = CountTrailingZeros(word);
+                    auto component_index = static_cast<std::uint16_t>(j * 64 + bit);
+                    auto owners = compressed(component_index) ? compressed_sets_[component_index].bits(first, count) : component_bitmaps_[component_index].bits(first, count);
+                    matches &= (query.words[j] >> bit) & 1 ? owners : ~owners;
+                }
+            }
+            return matches;
+        }
+
+        /// Returns the number of alive entities having all components QUERY requires and none it excludes.
+        ///
+        /// With columns, bitmaps of queried components are ANDed word by word and counted by popcount,
+        /// skipping pages of 4096 entities where a queried component doesn't occur.
+        /// Queries of a compressed component or with exclusions count matches of candidate blocks instead.
+        std::size_t count_matches(const MaskQuery & query) const
+        {
+            if (query.tested_size == 0)
+            {
+                return entity_alive_flags_.count();
+            }
+            std::size_t count = 0;
+            const std::uint64_t * columns[MAX_COMPONENTS];
+            std::uint32_t column_count = 0;
+            auto words = entity_alive_flags_.word_count();
+            auto dense = !component_bitmaps_.empty() && query.size != 0 && !query.excludes();
+            for (std::uint32_t j = 0; j < query.size; j++)
+            {
+                for (auto word = query.words[j]; word != 0; word &= word - 1)
+                {
+                    auto component_index = static_cast<std::uint16_t>(j * 64 + CountTrailingZeros(word));
+                    if (dense && !compressed(component_index))
+                    {
+                        auto & bitmap = component_bitmaps_[component_index];
+                        columns[column_count++] = bitmap.data();
+                        words = std::min(words, bitmap.word_count());
+                    }
+                    else
+                    {
+                        dense = false;
+                    }
+                }
+            }
+            if (!dense)
+            {
+                auto size = entity_versions_.size();
+                for (auto block = next_block(query, 0); std::size_t(block) * 64 < size; block = next_block(query, block + 1))
+                {
+                    auto first = block * 64;
+                    count += PopCount(match_block(first, static_cast<std::uint32_t>(std::min<std::size_t>(64, size - first)), query));
+                }
+                return count;
+            }
+            // bitmaps of dead entities are empty, so the alive bitmap needn't take part.
+            // ANDs a page of words column by column, so each pass is a plain loop over contiguous words.
+            std::uint64_t chunk[64];
+            for (std::size_t first = 0; first < words; first += 64)
+            {
+                auto page = static_cast<std::uint32_t>(first / 64);
+                if (((candidate_pages(query, page / 64) >> (page % 64)) & 1) == 0)
+                {
+                    continue;
+                }
+                auto length = std::min<std::size_t>(64, words - first);
+                std::copy(columns[0] + first, columns[0] + first + length, chunk);
+                for (std::uint32_t c = 1; c < column_count; c++)
+                {
+                    for (std::size_t i = 0; i < length; i++)
+                    {
+                        chunk[i] &= columns[c][first + i];
+                    }
+                }
+                for (std::size_t i = 0; i < length; i++)
+                {
+                    count += PopCount(chunk[i]);
+                }
+            }
+            return count;
         }
 
         template <typename T, typename... Args>
         void AddComponent(std::uint32_t index, std::uint16_t component_index, Args&&... args)
         {
-            auto & mask = entity_component_masks_[index];
-            if (mask[component_index])
+            ThrowsIfLocked();
+            if (has_component(index, component_index))
             {
                 throw std::out_of_range("This entity has already have this component");
             }
-            auto & pool = component_pool(component_index);
-            auto p = pool.Allocate(index);
-            new (p) T(std::forward<Args>(args)...);
-            mask[component_index] = true;
+            auto p = Allocate(index, component_index);
+            if (!IsTagComponent<T>::value)
+            {
+                try
+                {
+                    new (p) T(std::forward<Args>(args)...);
+                }
+                catch (...)
+                {
+                    Deallocate(index, component_index);
+                    throw;
+                }
+            }
+            entity_component_masks_.Set(index, component_index);
+            Occupy(index, component_index);
+            Refresh(index, component_index);
+            Join(index, component_index);
+            Record(index, component_index, ComponentEvent::Add);
+            if (tracks_changes(component_index))
+            {
+                change_ticks_[component_index].Add(index, change_tick_);
+                Stamp(index);
+            }
         }
 
         void AddComponentFrom(std::uint32_t index, std::uint16_t component_index, const void * src)
         {
-            auto & mask = entity_component_masks_[index];
-            if (mask[component_index])
+            ThrowsIfLocked();
+            if (has_component(index, component_index))
             {
                 throw std::out_of_range("This entity has already have this component");
             }
-            auto & pool = component_pool(component_index);
-            auto p = pool.Allocate(index);
-            ComponentManager::instance().dynamic_constructor(component_index).CopyConstruct(p, src);
-            mask[component_index] = true;
+            auto p = Allocate(index, component_index);
+            if (!is_tag(component_index))
+            {
+                try
+                {
+                    ComponentManager::instance().dynamic_constructor(component_index).CopyConstruct(p, src);
+                }
+                catch (...)
+                {
+                    Deallocate(index, component_index);
+                    throw;
+                }
+            }
+            entity_component_masks_.Set(index, component_index);
+            Occupy(index, component_index);
+            Refresh(index, component_index);
+            Join(index, component_index);
+            Record(index, component_index, ComponentEvent::Add);
+            if (tracks_changes(component_index))
+            {
+                change_ticks_[component_index].Add(index, change_tick_);
+                Stamp(index);
+            }
         }
 
         void AddComponentFromMove(std::uint32_t index, std::uint16_t component_index, void * src)
         {
-            auto & mask = entity_component_masks_[index];
-            if (mask[component_index])
+            ThrowsIfLocked();
+            if (has_component(index, component_index))
             {
                 throw std::out_of_range("This entity has already have this component");
             }
-            auto & pool = component_pool(component_index);
-            auto p = pool.Allocate(index);
-            ComponentManager::instance().dynamic_constructor(component_index).MoveConstruct(p, src);
-            mask[component_index] = true;
+            auto p = Allocate(index, component_index);
+            if (!is_tag(component_index))
+            {
+                try
+                {
+                    ComponentManager::instance().dynamic_constructor(component_index).MoveConstruct(p, src);
+                }
+                catch (...)
+                {
+                    Deallocate(index, component_index);
+                    throw;
+                }
+            }
+            entity_component_masks_.Set(index, component_index);
+            Occupy(index, component_index);
+            Refresh(index, component_index);
+            Join(index, component_index);
+            Record(index, component_index, ComponentEvent::Add);
+            if (tracks_changes(component_index))
+            {
+                change_ticks_[component_index].Add(index, change_tick_);
+                Stamp(index);
+            }
         }
 
         void * GetComponent(std::uint32_t index, std::uint16_t component_index)
         {
-            auto & mask = entity_component_masks_[index];
-            if (!mask[component_index])
+            if (!has_component(index, component_index))
+            {
+                return nullptr;
+            }
+            if (auto tag = ComponentManager::instance().tag_instance(component_index))
+            {
+                return tag;
+            }
+            if (archetypes_)
+            {
+                return archetypes_->Get(index, component_index);
+            }
+            return component_pool(component_index).Get(index);
+        }
+
+        /// Returns the component for reading, or nullptr when the entity doesn't have it. Blocks shared with a fork stay shared.
+        const void * GetComponent(std::uint32_t index, std::uint16_t component_index) const
+        {
+            if (!has_component(index, component_index))
             {
                 return nullptr;
             }
-            auto & pool = component_pool(component_index);
+            if (auto tag = ComponentManager::instance().tag_instance(component_index))
+            {
+                return tag;
+            }
+            if (archetypes_)
+            {
+                return archetypes_->Get(index, component_index);
+            }
+            const ComponentPoolInterface & pool = *find_component_pool(component_index);
             return pool.Get(index);
         }
 
         void RemoveComponent(std::uint32_t index, std::uint16_t component_index)
         {
-            auto p = GetComponent(index, component_index);
-            if (p == nullptr)
+            ThrowsIfLocked();
+            if (!has_component(index, component_index))
             {
                 throw std::out_of_range("This entity does not have this component");
             }
-            ComponentManager::instance().dynamic_constructor(component_index).Destroy(p);
-            entity_component_masks_[index][component_index] = false;
+            Record(index, component_index, ComponentEvent::Remove);
+            Detach(index, component_index);
         }
 
-    private:
-        friend View;
-        friend World;
+        /// Registers OBSERVER of EVENT for the component COMPONENT_INDEX.
+        ///
+        /// Events are queued as they happen, and delivered by `Notify`.
+        void Observe(std::uint16_t component_index, ComponentEvent event, Observer observer)
+        {
+            if (component_observers_.empty())
+            {
+                component_observers_.resize(MAX_COMPONENTS);
+            }
+            observed_[static_cast<std::size_t>(event)][component_index] = true;
+            component_observers_[component_index].observers[static_cast<std::size_t>(event)].push_back(std::move(observer));
+        }
 
-        using EntityVersionVector = std::vector<std::uint32_t>;
-        using EntityAliveFlagVector = std::vector<bool>;
-        using ComponentMaskVector = std::vector<ComponentMask>;
-        using ComponentPoolPtrVector = std::vector<std::unique_ptr<ComponentPoolInterface>>;
-        using FreeListStack = std::stack<std::uint32_t>;
+        /// Delivers events queued since the last call to their observers, component by component.
+        ///
+        /// Consecutive events of the same kind on a component are delivered as one span of entity ids,
+        /// in the order they happened. Events caused by observers are queued for the next call.
+        void Notify()
+        {
+            ThrowsIfLocked();
+            if (component_observers_.empty())
+            {
+                return;
+            }
+            std::vector<std::uint64_t> ids;
+            std::vector<ObservedRun> runs;
+            for (auto & observers : component_observers_)
+            {
+                if (observers.ids.empty())
+                {
+                    continue;
+                }
+                ids.swap(observers.ids);
+                runs.swap(observers.runs);
+                std::size_t first = 0;
+                for (auto & run : runs)
+                {
+                    for (auto & observer : observers.observers[static_cast<std::size_t>(run.event)])
+                    {
+                        observer(ids.data() + first, run.end - first);
+                    }
+                    first = run.end;
+                }
+                // buffers are handed back to keep their capacity, unless observers queued events meanwhile.
+                ids.clear();
+                runs.clear();
+                if (observers.ids.empty())
+                {
+                    ids.swap(observers.ids);
+                    runs.swap(observers.runs);
+                }
+            }
+        }
+
+        /// Returns bits of pages 64 * I to 64 * I + 63 where every component of QUERY occurs.
+        ///
+        /// A page is 4096 entities. Only the component pools backend keeps summaries; otherwise every page is a candidate.
+        /// Components with compressed membership answer from their sets.
+        std::uint64_t candidate_pages(const MaskQuery & query, std::uint32_t i) const
+        {
+            auto pages = ~std::uint64_t(0);
+            if (archetypes_)
+            {
+                return pages;
+            }
+            for (std::uint32_t j = 0; j < query.size; j++)
+            {
+                for (auto word = query.words[j]; word != 0; word &= word - 1)
+                {
+                    auto component_index = static_cast<std::uint16_t>(j * 64 + CountTrailingZeros(word));
+                    pages &= compressed(component_index) ? compressed_sets_[component_index].pages(i) : occupancy_summaries_[component_index].pages(i);
+                }
+            }
+            return pages;
+        }
+
+        /// Returns bits of blocks of 64 entities in PAGE where every component of QUERY occurs.
+        std::uint64_t candidate_blocks(const MaskQuery & query, std::uint32_t page) const
+        {
+            auto blocks = ~std::uint64_t(0);
+            if (archetypes_)
+            {
+                return blocks;
+            }
+            for (std::uint32_t j = 0; j < query.size; j++)
+            {
+                for (auto word = query.words[j]; word != 0; word &= word - 1)
+                {
+                    auto component_index = static_cast<std::uint16_t>(j * 64 + CountTrailingZeros(word));
+                    blocks &= compressed(component_index) ? compressed_sets_[component_index].blocks(page) : occupancy_summaries_[component_index].blocks(page);
+                }
+            }
+            return blocks;
+        }
+
+        /// Returns the first block of 64 entities from BLOCK where every component of QUERY occurs,
+        /// or the number of blocks when no block does.
+        std::uint32_t next_block(const MaskQuery & query, std::uint32_t block) const
+        {
+            auto blocks = static_cast<std::uint32_t>((entity_versions_.size() + 63) / 64);
+            while (block < blocks)
+            {
+                auto page = block / 64;
+                auto pages = candidate_pages(query, page / 64) & ~std::uint64_t(0) << (page % 64);
+                if (pages == 0)
+                {
+                    block = (page / 64 + 1) * 64 * 64;
+                    continue;
+                }
+                auto found = page / 64 * 64 + CountTrailingZeros(pages);
+                if (found != page)
+                {
+                    block = found * 64;
+                }
+                auto candidates = candidate_blocks(query, found) & ~std::uint64_t(0) << (block % 64);
+                if (candidates != 0)
+                {
+                    return found * 64 + CountTrailingZeros(candidates);
+                }
+                block = (found + 1) * 64;
+            }
+            return blocks;
+        }
+
+        /// Returns the number of entities that have the component.
+        std::uint32_t count(std::uint16_t component_index) const
+        {
+            return component_counts_[component_index];
+        }
+
+        /// Returns the number of components added to entities so far, which only grows.
+        ///
+        /// Each addition makes at most one more entity match a query, so scans bounded by counts extend their bound by new additions.
+        std::uint64_t additions() const
+        {
+            return additions_;
+        }
+
+        /// Returns indices of entities that have the component, or nullptr when its pool doesn't track them or doesn't exist yet.
+        ///
+        /// Pools aren't created here, so systems may call this concurrently; no entity has a component without a pool.
+        const SparseSet * owners(std::uint16_t component_index) const
+        {
+            auto pool = find_component_pool(component_index);
+            return pool ? pool->owners() : nullptr;
+        }
+
+        /// Returns indices of alive entities matching QUERY, kept up to date from now on.
+        ///
+        /// Adding or removing a component QUERY tests updates the set when the entity starts or stops matching,
+        /// and so do creating and destroying entities; the set lives as long as this, and the same one is returned for the same query.
+        /// Throws `std::logic_error` when the set must be made while locked, as systems running concurrently may look sets up but not add them.
+        const SparseSet & Cache(const MaskQuery & query)
+        {
+            for (auto & cached : cached_queries_)
+            {
+                if (cached->query == query)
+                {
+                    return cached->matches;
+                }
+            }
+            if (locks_.load(std::memory_order_relaxed) != 0)
+            {
+                throw std::logic_error("Queries can't be cached first while iterating in parallel or in systems that are not Exclusive");
+            }
+            cached_queries_.emplace_back(new QueryCache { query, SparseSet() });
+            auto & cached = *cached_queries_.back();
+            auto size = entity_versions_.size();
+            for (auto block = next_block(query, 0); std::size_t(block) * 64 < size; block = next_block(query, block + 1))
+            {
+                auto first = block * 64;
+                for (auto matches = match_block(first, static_cast<std::uint32_t>(std::min<std::size_t>(64, size - first)), query); matches != 0; matches &= matches - 1)
+                {
+                    cached.matches.Insert(first + CountTrailingZeros(matches));
+                }
+            }
+            if (cached_by_component_.empty())
+            {
+                cached_by_component_.resize(MAX_COMPONENTS);
+            }
+            for (std::uint32_t j = 0; j < query.tested_size; j++)
+            {
+                for (auto word = query.tested[j]; word != 0; word &= word - 1)
+                {
+                    cached_by_component_[j * 64 + CountTrailingZeros(word)].push_back(&cached);
+                }
+            }
+            return cached.matches;
+        }
+
+        /// Swaps components at two positions of a packed pool.
+        using PositionSwap = void (*)(ComponentPoolInterface & pool, std::uint32_t lhs, std::uint32_t rhs);
+
+        /// Entities having all components a group owns, kept in the first SIZE positions of their packed pools in the same order.
+        struct OwningGroup
+        {
+            MaskQuery query;
+            std::vector<std::uint16_t> components;
+            std::vector<PositionSwap> swaps;
+            std::uint32_t size;
+        };
+
+        /// Returns the group owning packed pools of COMPONENTS, each with the function swapping its components, creating it if needed.
+        ///
+        /// Entities already having all of them are moved into the group now, and others as they get them.
+        /// Throws `std::logic_error` when a component is owned by another group, components are stored in archetypes,
+        /// or the group must be made while locked.
+        OwningGroup & Own(std::vector<std::pair<std::uint16_t, PositionSwap>> components)
+        {
+            if (archetypes_)
+            {
+                throw std::logic_error("Groups can't own components stored in archetypes");
+            }
+            std::sort(components.begin(), components.end());
+            ComponentMask mask;
+            for (auto & component : components)
+            {
+                mask[component.first] = true;
+            }
+            MaskQuery query(mask);
+            for (auto & group : owning_groups_)
+            {
+                if (group->query == query)
+                {
+                    return *group;
+                }
+            }
+            if (locks_.load(std::memory_order_relaxed) != 0)
+            {
+                throw std::logic_error("Groups can't be made while iterating in parallel or in systems that are not Exclusive");
+            }
+            if (group_by_component_.empty())
+            {
+                group_by_component_.resize(MAX_COMPONENTS);
+            }
+            for (auto & component : components)
+            {
+                if (group_by_component_[component.first])
+                {
+                    throw std::logic_error("This component is already owned by another group");
+                }
+            }
+
+            // pools are made now, so walking the group never needs to make them.
+            for (auto & component : components)
+            {
+                component_pool(component.first);
+            }
+            owning_groups_.emplace_back(new OwningGroup { query, std::vector<std::uint16_t>(), std::vector<PositionSwap>(), 0 });
+            auto & group = *owning_groups_.back();
+            for (auto & component : components)
+            {
+                group.components.push_back(component.first);
+                group.swaps.push_back(component.second);
+                group_by_component_[component.first] = &group;
+            }
+            // entities entering the group swap with positions already walked, so every owner is visited once.
+            auto & owners = *component_pool(group.components[0]).owners();
+            for (std::uint32_t position = 0; position < owners.size(); position++)
+            {
+                auto index = owners.index(position);
+                if (matches(index, group.query))
+                {
+                    Enter(group, index);
+                }
+            }
+            return group;
+        }
+
+        /// Stamps the component COMPONENT_INDEX of the entity indexed INDEX changed at the current tick, when its changes are tracked.
+        ///
+        /// Ticks shared by blocks of entities and archetype chunks are raised atomically, so different entities may be marked from several threads at once,
+        /// as in `World::parallel_each`. One entity must not be marked from several threads at once.
+        void MarkChanged(std::uint32_t index, std::uint16_t component_index)
+        {
+            if (tracks_changes(component_index))
+            {
+                change_ticks_[component_index].Change(index, change_tick_);
+                Stamp(index);
+            }
+        }
+
+        /// Returns the tick additions and changes are stamped with now.
+        std::uint32_t change_tick() const
+        {
+            return change_tick_;
+        }
+
+        /// Advances the tick additions and changes are stamped with.
+        ///
+        /// @return the tick before advancing.
+        std::uint32_t Tick()
+        {
+            return change_tick_++;
+        }
+
+        /// Returns whether components of the entity indexed INDEX were added and changed as CHANGES requires.
+        bool changed(std::uint32_t index, const ChangeQuery & changes) const
+        {
+            for (auto component_index : changes.added)
+            {
+                if (!change_ticks_[component_index].added(index, changes.since))
+                {
+                    return false;
+                }
+            }
+            for (auto component_index : changes.changed)
+            {
+                if (!change_ticks_[component_index].changed(index, changes.since))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// Returns bits of entities FIRST to FIRST + COUNT - 1 whose components were added and changed as CHANGES requires.
+        ///
+        /// COUNT must be 1 to 64. Blocks not changed since the tick are answered without reading entities.
+        std::uint64_t changed_block(std::uint32_t first, std::uint32_t count, const ChangeQuery & changes) const
+        {
+            auto bits = ~std::uint64_t(0);
+            for (auto component_index : changes.added)
+            {
+                bits &= change_ticks_[component_index].added_bits(first, count, changes.since);
+                if (bits == 0)
+                {
+                    return 0;
+                }
+            }
+            for (auto component_index : changes.changed)
+            {
+                bits &= change_ticks_[component_index].changed_bits(first, count, changes.since);
+                if (bits == 0)
+                {
+                    return 0;
+                }
+            }
+            return bits;
+        }
+
+        /// Returns the number of entities a group owning the component keeps at the front of its packed pool, or 0.
+        std::uint32_t grouped_count(std::uint16_t component_index) const
+        {
+            return group_by_component_.empty() || !group_by_component_[component_index] ? 0 : group_by_component_[component_index]->size;
+        }
+
+        /// Moves the component at position ORDER[i] of the packed pool of the component COMPONENT_INDEX to position i, swapping with SWAP.
+        ///
+        /// When a group owns the component, ORDER must keep entities of the group at the front,
+        /// and the other pools of the group are rearranged alike there. ORDER is left as the identity.
+        void Arrange(std::uint16_t component_index, PositionSwap swap, std::vector<std::uint32_t> & order)
+        {
+            ThrowsIfLocked();
+            auto grouped = grouped_count(component_index);
+            std::vector<std::pair<ComponentPoolInterface*, PositionSwap>> pools { std::make_pair(&component_pool(component_index), swap) };
+            if (grouped != 0)
+            {
+                auto & group = *group_by_component_[component_index];
+                assert(std::all_of(order.begin(), order.begin() + grouped, [&](std::uint32_t position) { return position < grouped; }));
+                for (std::size_t i = 0; i < group.components.size(); i++)
+                {
+                    if (group.components[i] != component_index)
+                    {
+                        pools.emplace_back(&component_pool(group.components[i]), group.swaps[i]);
+                    }
+                }
+            }
+            // follows each cycle of the permutation, placing one component per swap.
+            // Cycles don't cross the end of the group, and pools of the group differ past it.
+            for (std::uint32_t position = 0; position < order.size(); position++)
+            {
+                auto count = position < grouped ? pools.size() : 1;
+                auto current = position;
+                auto next = order[current];
+                while (next != position)
+                {
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        pools[i].second(*pools[i].first, current, next);
+                    }
+                    order[current] = current;
+                    current = next;
+                    next = order[current];
+                }
+                order[current] = current;
+            }
+        }
+
+        /// Returns the archetype storage, or nullptr when components are stored in pools.
+        ArchetypeStorage * archetypes()
+        {
+            return archetypes_.get();
+        }
+
+        MaskLayout layout() const
+        {
+            return component_bitmaps_.empty() ? MaskLayout::Rows : MaskLayout::Columns;
+        }
+
+        /// Copies entities, components, cached queries and groups into FORK, a manager just made with the same backend and layout.
+        ///
+        /// Pools decide how to copy their components; see `ComponentPoolInterface::Fork`. Observers and queued events aren't copied.
+        void ForkInto(EntityManager & fork)
+        {
+            ThrowsIfLocked();
+            assert(!fork.archetypes_ == !archetypes_ && fork.layout() == layout());
+            fork.entity_alive_flags_ = entity_alive_flags_;
+            fork.entity_versions_ = entity_versions_;
+            fork.entity_component_masks_ = entity_component_masks_;
+            fork.free_list_ = free_list_;
+            if (archetypes_)
+            {
+                fork.archetypes_.reset(archetypes_->Fork());
+            }
+            auto & manager = ComponentManager::instance();
+            for (std::uint16_t i = 0; i < component_pools_.size(); i++)
+            {
+                if (auto & pool = component_pools_[i])
+                {
+                    // only pools not knowing their owners, copying components one by one, need them.
+                    std::vector<std::uint32_t> owners;
+                    if (!pool->owners() && !manager.dynamic_constructor(i).trivially_copyable())
+                    {
+                        owners.reserve(component_counts_[i]);
+                        for (std::uint32_t index = 0; index < entity_versions_.size(); index++)
+                        {
+                            if (alive(index) && has_component(index, i))
+                            {
+                                owners.push_back(index);
+                            }
+                        }
+                    }
+                    fork.component_pools_[i].reset(pool->Fork(owners));
+                }
+            }
+            fork.component_counts_ = component_counts_;
+            fork.additions_ = additions_;
+            fork.occupancy_summaries_ = occupancy_summaries_;
+            fork.component_bitmaps_ = component_bitmaps_;
+            fork.compressed_sets_ = compressed_sets_;
+            fork.change_ticks_ = change_ticks_;
+            fork.change_tick_ = change_tick_;
+
+            std::unordered_map<const QueryCache*, QueryCache*> caches;
+            for (auto & cached : cached_queries_)
+            {
+                fork.cached_queries_.emplace_back(new QueryCache(*cached));
+                caches[cached.get()] = fork.cached_queries_.back().get();
+            }
+            fork.cached_by_component_ = cached_by_component_;
+            for (auto & cached : fork.cached_by_component_)
+            {
+                for (auto & query : cached)
+                {
+                    query = caches[query];
+                }
+            }
+
+            std::unordered_map<const OwningGroup*, OwningGroup*> groups;
+            for (auto & group : owning_groups_)
+            {
+                fork.owning_groups_.emplace_back(new OwningGroup(*group));
+                groups[group.get()] = fork.owning_groups_.back().get();
+            }
+            fork.group_by_component_ = group_by_component_;
+            for (auto & group : fork.group_by_component_)
+            {
+                if (group)
+                {
+                    group = groups[group];
+                }
+            }
+        }
+
+        /// Writes entities and their components to WRITER. See `World::SaveSnapshot` for the format.
+        ///
+        /// Throws `std::logic_error` in the archetype backend, while locked, or when a component can't be saved,
+        /// checking components before writing anything.
+        void Save(SnapshotWriter & writer)
+        {
+            ThrowsIfLocked();
+            if (archetypes_)
+            {
+                throw std::logic_error("Snapshots can't be saved of components stored in archetypes");
+            }
+            auto & manager = ComponentManager::instance();
+            std::vector<std::uint16_t> components;
+            std::vector<std::string> names;
+            for (std::uint16_t i = 0; i < MAX_COMPONENTS; i++)
+            {
+                if (component_counts_[i] == 0)
+                {
+                    continue;
+                }
+                try
+                {
+                    names.push_back(manager.name(i));
+                }
+                catch (const std::out_of_range &)
+                {
+                    throw std::logic_error("components must be registered by names to be saved (hint: RegisterComponent)");
+                }
+                if (!is_tag(i) && !manager.dynamic_constructor(i).trivially_copyable() && !manager.serializer(i))
+                {
+                    throw std::logic_error("the component `" + names.back() + "` is not trivially copyable and has no serializer (hint: RegisterSerializer)");
+                }
+                components.push_back(i);
+            }
+
+            auto size = static_cast<std::uint32_t>(entity_versions_.size());
+            auto words = (std::size_t(size) + 63) / 64;
+            SnapshotHeader header;
+            std::memcpy(header.magic, SnapshotMagic(), sizeof(header.magic));
+            header.version = SNAPSHOT_VERSION;
+            header.byte_order = 1;
+            header.entity_count = size;
+            header.free_count = static_cast<std::uint32_t>(free_list_.size());
+            header.record_count = static_cast<std::uint32_t>(components.size());
+            header.change_tick = change_tick_;
+            writer.Write(header);
+            writer.Align();
+            writer.Write(entity_versions_.data(), entity_versions_.size() * sizeof(std::uint32_t));
+            writer.Align();
+            std::vector<std::uint64_t> bits(words);
+            for (std::size_t i = 0; i < words; i++)
+            {
+                bits[i] = entity_alive_flags_.word(i);
+            }
+            writer.Write(bits.data(), words * sizeof(std::uint64_t));
+            writer.Align();
+            writer.Write(free_list_.data(), free_list_.size() * sizeof(std::uint32_t));
+            writer.Align();
+
+            // masks of dead entities are empty, so they own nothing.
+            std::vector<std::vector<std::uint64_t>> owners(MAX_COMPONENTS);
+            for (auto i : components)
+            {
+                owners[i].resize(words);
+            }
+            for (std::uint32_t index = 0; index < size; index++)
+            {
+                entity_component_masks_.ForEach(index, [&](std::uint16_t i)
+                {
+                    owners[i][index / 64] |= std::uint64_t(1) << (index % 64);
+                });
+            }
+            // components saved one by one are gathered in a buffer, written when it grows large.
+            std::string buffer;
+            for (std::size_t k = 0; k < components.size(); k++)
+            {
+                auto i = components[k];
+                auto & constructor = manager.dynamic_constructor(i);
+                SnapshotRecord record { static_cast<std::uint32_t>(names[k].size()), SnapshotEncoding::Tag, component_counts_[i], 0, 0 };
+                auto record_offset = writer.offset();
+                writer.Write(record);
+                writer.Write(names[k].data(), names[k].size());
+                writer.Align();
+                writer.Write(owners[i].data(), words * sizeof(std::uint64_t));
+                writer.Align();
+                auto payload = writer.offset();
+                if (!is_tag(i))
+                {
+                    record.element_size = static_cast<std::uint32_t>(constructor.size());
+                    auto & pool = component_pool(i);
+                    // components are read without copying blocks shared with a fork.
+                    const ComponentPoolInterface & components = pool;
+                    auto serializer = constructor.trivially_copyable() ? nullptr : manager.serializer(i);
+                    if (!serializer && pool.Save(writer))
+                    {
+                        record.encoding = SnapshotEncoding::Blocks;
+                    }
+                    else
+                    {
+                        record.encoding = serializer ? SnapshotEncoding::Serialized : SnapshotEncoding::Bytes;
+                        ForEachOwner(owners[i].data(), words, [&](std::uint32_t index)
+                        {
+                            if (serializer)
+                            {
+                                auto start = buffer.size();
+                                buffer.append(sizeof(std::uint64_t), '\0');
+                                serializer->Save(components.Get(index), buffer);
+                                std::uint64_t length = buffer.size() - start - sizeof(std::uint64_t);
+                                std::memcpy(&buffer[start], &length, sizeof(length));
+                            }
+                            else
+                            {
+                                buffer.append(static_cast<const char*>(components.Get(index)), record.element_size);
+                            }
+                            if (buffer.size() >= (1 << 20))
+                            {
+                                writer.Write(buffer.data(), buffer.size());
+                                buffer.clear();
+                            }
+                        });
+                        writer.Write(buffer.data(), buffer.size());
+                        buffer.clear();
+                    }
+                }
+                record.payload_size = writer.offset() - payload;
+                writer.Patch(record_offset, record);
+                writer.Align();
+            }
+        }
+
+        /// Loads entities and their components from READER, which `Save` wrote, into this manager having no entities.
+        ///
+        /// The file is checked before anything is loaded, so a bad file throws and leaves this empty.
+        /// When a serializer throws halfway, entities loaded so far are destroyed without notifying observers, leaving this empty too.
+        void Load(SnapshotReader & reader)
+        {
+            ThrowsIfLocked();
+            if (archetypes_)
+            {
+                throw std::logic_error("Snapshots can't be loaded into components stored in archetypes");
+            }
+            if (!entity_versions_.empty())
+            {
+                throw std::logic_error("Snapshots can be loaded only into a world that has never had entities");
+            }
+            auto header = reader.Read<SnapshotHeader>();
+            if (std::memcmp(header.magic, SnapshotMagic(), sizeof(header.magic)) != 0)
+            {
+                throw std::runtime_error("the file is not a snapshot");
+            }
+            if (header.byte_order != 1)
+            {
+                throw std::runtime_error("the snapshot was saved in another byte order");
+            }
+            if (header.version != SNAPSHOT_VERSION)
+            {
+                throw std::runtime_error("the snapshot version " + std::to_string(header.version) + " is not supported");
+            }
+            reader.Align();
+            auto size = header.entity_count;
+            auto words = (std::size_t(size) + 63) / 64;
+            auto versions = reader.Take(std::uint64_t(size) * sizeof(std::uint32_t));
+            reader.Align();
+            auto alive = reinterpret_cast<const std::uint64_t*>(reader.Take(words * sizeof(std::uint64_t)));
+            reader.Align();
+            auto free = reinterpret_cast<const std::uint32_t*>(reader.Take(std::uint64_t(header.free_count) * sizeof(std::uint32_t)));
+            reader.Align();
+            // each free index must be a dead entity listed once, or creating entities would hand out one twice.
+            std::vector<std::uint64_t> freed(words);
+            for (std::uint32_t i = 0; i < header.free_count; i++)
+            {
+                if (free[i] >= size || (alive[free[i] / 64] >> (free[i] % 64)) & 1 || (freed[free[i] / 64] >> (free[i] % 64)) & 1)
+                {
+                    throw std::runtime_error("the snapshot is corrupted");
+                }
+                freed[free[i] / 64] |= std::uint64_t(1) << (free[i] % 64);
+            }
+
+            auto & manager = ComponentManager::instance();
+            std::vector<LoadedRecord> records;
+            ComponentMask recorded;
+            for (std::uint32_t r = 0; r < header.record_count; r++)
+            {
+                auto record = reader.Read<SnapshotRecord>();
+                std::string name(reader.Take(record.name_size), record.name_size);
+                reader.Align();
+                auto owners = reinterpret_cast<const std::uint64_t*>(reader.Take(words * sizeof(std::uint64_t)));
+                reader.Align();
+                auto payload = reader.offset();
+                reader.Take(record.payload_size);
+                auto end = reader.offset();
+
+                std::uint16_t i;
+                try
+                {
+                    i = manager.id(name);
+                }
+                catch (const std::out_of_range &)
+                {
+                    throw std::out_of_range("the component `" + name + "` in the snapshot is not registered");
+                }
+                if (recorded[i])
+                {
+                    throw std::runtime_error("the snapshot is corrupted");
+                }
+                recorded[i] = true;
+                auto & constructor = manager.dynamic_constructor(i);
+                auto fits = false;
+                switch (record.encoding)
+                {
+                case SnapshotEncoding::Tag:
+                    fits = is_tag(i);
+                    break;
+                case SnapshotEncoding::Blocks:
+                case SnapshotEncoding::Bytes:
+                    fits = !is_tag(i) && constructor.trivially_copyable() && constructor.size() == record.element_size;
+                    break;
+                case SnapshotEncoding::Serialized:
+                    if (!is_tag(i) && !manager.serializer(i))
+                    {
+                        throw std::logic_error("the component `" + name + "` has no serializer (hint: RegisterSerializer)");
+                    }
+                    fits = !is_tag(i);
+                    break;
+                }
+                if (!fits)
+                {
+                    throw std::runtime_error("the component `" + name + "` is saved in another layout than its type has");
+                }
+                std::size_t count = 0;
+                for (std::size_t j = 0; j < words; j++)
+                {
+                    if ((owners[j] & ~alive[j]) != 0)
+                    {
+                        throw std::runtime_error("the snapshot is corrupted");
+                    }
+                    count += PopCount(owners[j]);
+                }
+                if (count != record.count || (record.encoding == SnapshotEncoding::Bytes && record.payload_size != std::uint64_t(count) * record.element_size))
+                {
+                    throw std::runtime_error("the snapshot is corrupted");
+                }
+                if (record.encoding == SnapshotEncoding::Blocks)
+                {
+                    reader.Seek(payload);
+                    std::uint64_t block_size;
+                    auto blocks = ReadBlocks(reader, size, record.element_size, block_size);
+                    ForEachOwner(owners, words, [&](std::uint32_t index)
+                    {
+                        if (!blocks[index / block_size])
+                        {
+                            throw std::runtime_error("the snapshot is corrupted");
+                        }
+                    });
+                    reader.Seek(end);
+                }
+                if (record.encoding == SnapshotEncoding::Serialized)
+                {
+                    // each component is prefixed by its length, which must stay within the record.
+                    reader.Seek(payload);
+                    for (std::size_t k = 0; k < count; k++)
+                    {
+                        if (end - reader.offset() < sizeof(std::uint64_t))
+                        {
+                            throw std::runtime_error("the snapshot is corrupted");
+                        }
+                        auto length = reader.Read<std::uint64_t>();
+                        if (length > end - reader.offset())
+                        {
+                            throw std::runtime_error("the snapshot is corrupted");
+                        }
+                        reader.Seek(reader.offset() + length);
+                    }
+                    if (reader.offset() != end)
+                    {
+                        throw std::runtime_error("the snapshot is corrupted");
+                    }
+                }
+                reader.Align();
+                records.push_back(LoadedRecord { i, record, owners, payload });
+            }
+
+            try
+            {
+                Install(reader, header, versions, alive, free, records);
+            }
+            catch (...)
+            {
+                Unload();
+                throw;
+            }
+        }
+
+    private:
+        friend View;
+        friend World;
+
+        /// A record of a component checked by `Load`, whose payload starts at offset PAYLOAD of the file.
+        struct LoadedRecord
+        {
+            std::uint16_t component_index;
+            SnapshotRecord record;
+            const std::uint64_t * owners;
+            std::uint64_t payload;
+        };
+
+        /// Sets entities and loads components of RECORDS, all checked by `Load`.
+        void Install(SnapshotReader & reader, const SnapshotHeader & header, const char * versions, const std::uint64_t * alive, const std::uint32_t * free,
+            const std::vector<LoadedRecord> & records)
+        {
+            auto & manager = ComponentManager::instance();
+            auto size = header.entity_count;
+            auto words = (std::size_t(size) + 63) / 64;
+            entity_versions_.resize(size);
+            // memcpy must not be given null pointers, which empty vectors and sections may have, even to copy nothing.
+            if (size != 0)
+            {
+                std::memcpy(entity_versions_.data(), versions, std::size_t(size) * sizeof(std::uint32_t));
+            }
+            entity_alive_flags_.Assign(alive, size);
+            entity_component_masks_.Resize(size);
+            free_list_.resize(header.free_count);
+            if (!free_list_.empty())
+            {
+                std::memcpy(free_list_.data(), free, free_list_.size() * sizeof(std::uint32_t));
+            }
+            change_tick_ = std::max(change_tick_, header.change_tick);
+            if (!cached_queries_.empty())
+            {
+                ForEachOwner(alive, words, [&](std::uint32_t index)
+                {
+                    Appear(index);
+                });
+            }
+
+            for (auto & loaded : records)
+            {
+                auto i = loaded.component_index;
+                reader.Seek(loaded.payload);
+                if (loaded.record.encoding == SnapshotEncoding::Tag || (loaded.record.encoding == SnapshotEncoding::Blocks && component_pool(i).Load(reader)))
+                {
+                    Restore(loaded.owners, size, i);
+                    continue;
+                }
+                auto & constructor = manager.dynamic_constructor(i);
+                switch (loaded.record.encoding)
+                {
+                case SnapshotEncoding::Tag:
+                    break;
+                case SnapshotEncoding::Blocks:
+                {
+                    // the pool keeps components otherwise now, so they are copied one by one from blocks of the file.
+                    std::uint64_t block_size;
+                    auto blocks = ReadBlocks(reader, size, loaded.record.element_size, block_size);
+                    ForEachOwner(loaded.owners, words, [&](std::uint32_t index)
+                    {
+                        constructor.CopyConstruct(Allocate(index, i), blocks[index / block_size] + index % block_size * loaded.record.element_size);
+                        Restore(index, i);
+                    });
+                    break;
+                }
+                case SnapshotEncoding::Bytes:
+                {
+                    auto data = reader.Take(loaded.record.payload_size);
+                    ForEachOwner(loaded.owners, words, [&](std::uint32_t index)
+                    {
+                        constructor.CopyConstruct(Allocate(index, i), data);
+                        data += loaded.record.element_size;
+                        Restore(index, i);
+                    });
+                    break;
+                }
+                case SnapshotEncoding::Serialized:
+                {
+                    auto serializer = manager.serializer(i);
+                    ForEachOwner(loaded.owners, words, [&](std::uint32_t index)
+                    {
+                        auto length = reader.Read<std::uint64_t>();
+                        auto data = reader.Take(length);
+                        auto p = Allocate(index, i);
+                        try
+                        {
+                            serializer->Load(p, data, static_cast<std::size_t>(length));
+                        }
+                        catch (...)
+                        {
+                            Deallocate(index, i);
+                            throw;
+                        }
+                        Restore(index, i);
+                    });
+                    break;
+                }
+                }
+            }
+        }
+
+        /// Destroys entities a failed `Load` installed and drops events queued for them, so this has no entities again.
+        void Unload()
+        {
+            for (std::uint32_t index = 0; index < entity_versions_.size(); index++)
+            {
+                if (entity_alive_flags_.test(index))
+                {
+                    DestroyEntity(index);
+                }
+            }
+            for (auto & observers : component_observers_)
+            {
+                observers.ids.clear();
+                observers.runs.clear();
+            }
+            entity_versions_.clear();
+            entity_alive_flags_.Assign(nullptr, 0);
+            entity_component_masks_.Resize(0);
+            free_list_.clear();
+        }
+
+        using EntityVersionVector = std::vector<std::uint32_t>;
+        using EntityAliveFlagVector = EntityBitmap;
+        using ComponentPoolPtrVector = std::vector<std::unique_ptr<ComponentPoolInterface>>;
+        using FreeListStack = std::vector<std::uint32_t>;
+
+        struct QueryCache
+        {
+            MaskQuery query;
+            SparseSet matches;
+        };
+
+        /// Events of the same kind queued in a row, ending before ENDth id.
+        struct ObservedRun
+        {
+            ComponentEvent event;
+            std::size_t end;
+        };
+
+        /// Observers of a component by event, and events queued for them.
+        struct ComponentObservers
+        {
+            std::vector<Observer> observers[3];
+            std::vector<std::uint64_t> ids;
+            std::vector<ObservedRun> runs;
+        };
+
+        EntityManager(StorageBackend backend, MaskLayout layout) :
+            entity_component_masks_(ComponentManager::instance().size()),
+            component_pools_(backend == StorageBackend::ComponentPools ? MAX_COMPONENTS : 0),
+            archetypes_(backend == StorageBackend::Archetypes ? new ArchetypeStorage : nullptr),
+            component_counts_(MAX_COMPONENTS),
+            occupancy_summaries_(backend == StorageBackend::ComponentPools ? MAX_COMPONENTS : 0),
+            component_bitmaps_(layout == MaskLayout::Columns ? MAX_COMPONENTS : 0),
+            compressed_sets_(MAX_COMPONENTS),
+            change_ticks_(MAX_COMPONENTS)
+        {
+        }
+
+        /// Forbids creating or destroying entities and adding or removing components until as many Unlock calls.
+        ///
+        /// Locks may be taken from several threads at once.
+        void Lock()
+        {
+            ++locks_;
+        }
+
+        void Unlock()
+        {
+            --locks_;
+        }
+
+        /// Counts the component COMPONENT_INDEX added to the entity indexed INDEX.
+        void Occupy(std::uint32_t index, std::uint16_t component_index)
+        {
+            ++component_counts_[component_index];
+            ++additions_;
+            if (compressed(component_index))
+            {
+                compressed_sets_[component_index].Insert(index);
+                return;
+            }
+            if (!archetypes_)
+            {
+                occupancy_summaries_[component_index].Insert(index);
+            }
+            if (!component_bitmaps_.empty())
+            {
+                component_bitmaps_[component_index].Set(index);
+            }
+        }
+
+        /// Counts the component COMPONENT_INDEX removed from the entity indexed INDEX.
+        void Vacate(std::uint32_t index, std::uint16_t component_index)
+        {
+            --component_counts_[component_index];
+            if (compressed(component_index))
+            {
+                compressed_sets_[component_index].Erase(index);
+                return;
+            }
+            if (!archetypes_)
+            {
+                occupancy_summaries_[component_index].Erase(index);
+            }
+            if (!component_bitmaps_.empty())
+            {
+                component_bitmaps_[component_index].Reset(index);
+            }
+        }
+
+        /// Destructs and deallocates the component COMPONENT_INDEX of the entity indexed INDEX, which has it.
+        void Detach(std::uint32_t index, std::uint16_t component_index)
+        {
+            Leave(index, component_index);
+            if (!is_tag(component_index))
+            {
+                ComponentManager::instance().dynamic_constructor(component_index).Destroy(GetComponent(index, component_index));
+            }
+            Deallocate(index, component_index);
+            entity_component_masks_.Reset(index, component_index);
+            Vacate(index, component_index);
+            Refresh(index, component_index);
+        }
+
+        /// Records the component COMPONENT_INDEX loaded for the entity indexed INDEX like `AddComponent` does once it's constructed.
+        void Restore(std::uint32_t index, std::uint16_t component_index)
+        {
+            entity_component_masks_.Set(index, component_index);
+            Occupy(index, component_index);
+            Refresh(index, component_index);
+            Join(index, component_index);
+            Record(index, component_index, ComponentEvent::Add);
+            if (tracks_changes(component_index))
+            {
+                change_ticks_[component_index].Add(index, change_tick_);
+            }
+        }
+
+        /// Records components COMPONENT_INDEX loaded for entities whose bits are set in OWNERS, a bitmap over SIZE entities, like `Restore` for each.
+        ///
+        /// Counts, summaries and bitmaps are updated a word at a time, unless the component needs work per entity.
+        void Restore(const std::uint64_t * owners, std::uint32_t size, std::uint16_t component_index)
+        {
+            auto words = (std::size_t(size) + 63) / 64;
+            if (compressed(component_index) || tracks_changes(component_index) || observed_[static_cast<std::size_t>(ComponentEvent::Add)][component_index]
+                || (!cached_by_component_.empty() && !cached_by_component_[component_index].empty())
+                || (!group_by_component_.empty() && group_by_component_[component_index]))
+            {
+                ForEachOwner(owners, words, [&](std::uint32_t index)
+                {
+                    Restore(index, component_index);
+                });
+                return;
+            }
+            auto & summary = occupancy_summaries_[component_index];
+            for (std::size_t j = 0; j < words; j++)
+            {
+                auto word = owners[j];
+                component_counts_[component_index] += PopCount(word);
+                additions_ += PopCount(word);
+                summary.InsertBlock(static_cast<std::uint32_t>(j), word);
+                for (; word != 0; word &= word - 1)
+                {
+                    entity_component_masks_.Set(static_cast<std::uint32_t>(j * 64 + CountTrailingZeros(word)), component_index);
+                }
+            }
+            if (!component_bitmaps_.empty())
+            {
+                component_bitmaps_[component_index].Assign(owners, size);
+            }
+        }
+
+        /// Reads blocks `ComponentPool::Save` wrote of components of ELEMENT_SIZE bytes for SIZE entities,
+        /// setting BLOCK_SIZE to the number of components in a block.
+        ///
+        /// @return data of blocks by their indices, null for blocks not saved.
+        static std::vector<const char*> ReadBlocks(SnapshotReader & reader, std::uint32_t size, std::size_t element_size, std::uint64_t & block_size)
+        {
+            block_size = reader.Read<std::uint64_t>();
+            auto count = reader.Read<std::uint64_t>();
+            if (block_size == 0 || element_size == 0 || (count != 0 && block_size > reader.file()->size() / element_size) || count > reader.file()->size() / sizeof(std::uint32_t))
+            {
+                throw std::runtime_error("the snapshot is corrupted");
+            }
+            std::vector<std::uint32_t> indices(count);
+            if (count != 0)
+            {
+                std::memcpy(indices.data(), reader.Take(count * sizeof(std::uint32_t)), count * sizeof(std::uint32_t));
+            }
+            std::vector<const char*> blocks((std::size_t(size) + block_size - 1) / block_size);
+            for (auto block : indices)
+            {
+                reader.Align();
+                auto data = reader.Take(block_size * element_size);
+                if (block < blocks.size())
+                {
+                    blocks[block] = data;
+                }
+            }
+            return blocks;
+        }
+
+        /// Calls FN with the index of each bit set in WORDS words of BITS, in ascending order.
+        template <typename F>
+        static void ForEachOwner(const std::uint64_t * bits, std::size_t words, F fn)
+        {
+            for (std::size_t j = 0; j < words; j++)
+            {
+                for (auto word = bits[j]; word != 0; word &= word - 1)
+                {
+                    fn(static_cast<std::uint32_t>(j * 64 + CountTrailingZeros(word)));
+                }
+            }
+        }
+
+        /// Queues EVENT of the component COMPONENT_INDEX on the entity indexed INDEX, when it is observed.
+        void Record(std::uint32_t index, std::uint16_t component_index, ComponentEvent event)
+        {
+            if (!observed_[static_cast<std::size_t>(event)][component_index])
+            {
+                return;
+            }
+            auto & observers = component_observers_[component_index];
+            observers.ids.push_back(std::uint64_t(index) | std::uint64_t(entity_versions_[index]) << 32UL);
+            if (observers.runs.empty() || observers.runs.back().event != event)
+            {
+                observers.runs.push_back(ObservedRun { event, 0 });
+            }
+            observers.runs.back().end = observers.ids.size();
+        }
+
+        /// Adds the entity created at INDEX to cached queries requiring nothing.
+        void Appear(std::uint32_t index)
+        {
+            for (auto & cached : cached_queries_)
+            {
+                if (cached->query.size == 0)
+                {
+                    cached->matches.Insert(index);
+                }
+            }
+        }
+
+        /// Updates cached queries testing the component COMPONENT_INDEX just added to or removed from the entity indexed INDEX.
+        void Refresh(std::uint32_t index, std::uint16_t component_index)
+        {
+            if (cached_by_component_.empty())
+            {
+                return;
+            }
+            for (auto cached : cached_by_component_[component_index])
+            {
+                auto found = matches(index, cached->query);
+                if (found != cached->matches.contains(index))
+                {
+                    if (found)
+                    {
+                        cached->matches.Insert(index);
+                    }
+                    else
+                    {
+                        cached->matches.Erase(index);
+                    }
+                }
+            }
+        }
+
+        /// Removes the entity being destroyed at INDEX from cached queries.
+        void Forget(std::uint32_t index)
+        {
+            for (auto & cached : cached_queries_)
+            {
+                if (cached->matches.contains(index))
+                {
+                    cached->matches.Erase(index);
+                }
+            }
+        }
+
+        /// Returns whether the entity indexed INDEX is in GROUP, by its position in the pool of the first component.
+        bool grouped(const OwningGroup & group, std::uint32_t index)
+        {
+            return component_pool(group.components[0]).owners()->position(index) < group.size;
+        }
+
+        /// Moves the entity indexed INDEX to the end of GROUP in every pool it owns.
+        void Enter(OwningGroup & group, std::uint32_t index)
+        {
+            for (std::size_t i = 0; i < group.components.size(); i++)
+            {
+                auto & pool = component_pool(group.components[i]);
+                group.swaps[i](pool, pool.owners()->position(index), group.size);
+            }
+            ++group.size;
+        }
+
+        /// Moves the entity indexed INDEX out of GROUP, swapping it with the last entity of the group in every pool it owns.
+        void Exit(OwningGroup & group, std::uint32_t index)
+        {
+            --group.size;
+            for (std::size_t i = 0; i < group.components.size(); i++)
+            {
+                auto & pool = component_pool(group.components[i]);
+                group.swaps[i](pool, pool.owners()->position(index), group.size);
+            }
+        }
+
+        /// Moves the entity indexed INDEX into the group owning the component COMPONENT_INDEX just added, when it has all of them now.
+        void Join(std::uint32_t index, std::uint16_t component_index)
+        {
+            if (group_by_component_.empty() || !group_by_component_[component_index])
+            {
+                return;
+            }
+            auto & group = *group_by_component_[component_index];
+            if (matches(index, group.query) && !grouped(group, index))
+            {
+                Enter(group, index);
+            }
+        }
+
+        /// Moves the entity indexed INDEX out of the group owning the component COMPONENT_INDEX about to be removed.
+        void Leave(std::uint32_t index, std::uint16_t component_index)
+        {
+            if (group_by_component_.empty() || !group_by_component_[component_index])
+            {
+                return;
+            }
+            auto & group = *group_by_component_[component_index];
+            if (grouped(group, index))
+            {
+                Exit(group, index);
+            }
+        }
+
+        /// Returns whether owners of the component are kept in a compressed set instead of summaries and bitmaps.
+        static bool compressed(std::uint16_t component_index)
+        {
+            return ComponentManager::instance().compressed_membership(component_index);
+        }
+
+        static bool tracks_changes(std::uint16_t component_index)
+        {
+            return ComponentManager::instance().tracks_changes(component_index);
+        }
+
+        /// Raises the tick of the archetype chunk holding the entity INDEX to the current tick, so the chunk isn't skipped.
+        void Stamp(std::uint32_t index)
+        {
+            if (archetypes_)
+            {
+                archetypes_->Stamp(index, change_tick_);
+            }
+        }
+
+        /// Returns whether the component is a tag, kept as mask bits only. See `IsTagComponent`.
+        static bool is_tag(std::uint16_t component_index)
+        {
+            return ComponentManager::instance().tag_instance(component_index) != nullptr;
+        }
+
+        void ThrowsIfLocked() const
+        {
+            if (locks_.load(std::memory_order_relaxed) != 0)
+            {
+                throw std::logic_error("Entities and components can't be created or destroyed while iterating in parallel");
+            }
+        }
+
+        /// Allocates a memory for the component of the entity indexed INDEX in the backend.
+        ///
+        /// Tags have no memory, so nullptr is returned for them; archetypes still move the entity.
+        void * Allocate(std::uint32_t index, std::uint16_t component_index)
+        {
+            if (archetypes_)
+            {
+                return archetypes_->Add(index, component_index);
+            }
+            if (is_tag(component_index))
+            {
+                return nullptr;
+            }
+            return component_pool(component_index).Allocate(index);
+        }
+
+        /// Releases a memory of the destructed component of the entity indexed INDEX in the backend.
+        void Deallocate(std::uint32_t index, std::uint16_t component_index)
+        {
+            if (archetypes_)
+            {
+                archetypes_->Remove(index, component_index);
+            }
+            else if (!is_tag(component_index))
+            {
+                component_pool(component_index).Deallocate(index);
+            }
+        }
 
-        EntityManager() :
-            component_pools_(MAX_COMPONENTS)
+        /// Returns the pool of the component without creating it, or nullptr when it doesn't exist, including for tags and archetypes.
+        ComponentPoolInterface * find_component_pool(std::uint16_t component_index) const
         {
+            return component_pools_.empty() ? nullptr : component_pools_[component_index].get();
         }
 
+        /// Returns the pool of the component, creating it when it doesn't exist yet. Only structural changes may create pools.
         ComponentPoolInterface & component_pool(std::uint16_t component_index)
         {
             auto& poolp = component_pools_[component_index];
@@ -164,8 +1757,24 @@ namespace bent
 
         EntityAliveFlagVector entity_alive_flags_;
         EntityVersionVector entity_versions_;
-        ComponentMaskVector entity_component_masks_;
+        MaskTable entity_component_masks_;
         ComponentPoolPtrVector component_pools_;
+        std::unique_ptr<ArchetypeStorage> archetypes_;
+        std::vector<std::uint32_t> component_counts_;
+        std::uint64_t additions_ = 0;
+        std::vector<OccupancySummary> occupancy_summaries_;
+        std::vector<EntityBitmap> component_bitmaps_;
+        std::vector<RoaringSet> compressed_sets_;
+        std::vector<ChangeTicks> change_ticks_;
+        // starts from 1, so every stamp is after tick 0.
+        std::uint32_t change_tick_ = 1;
+        std::atomic<std::uint32_t> locks_ { 0 };
+        std::vector<std::unique_ptr<QueryCache>> cached_queries_;
+        std::vector<std::vector<QueryCache*>> cached_by_component_;
+        std::vector<std::unique_ptr<OwningGroup>> owning_groups_;
+        std::vector<OwningGroup*> group_by_component_;
+        std::vector<ComponentObservers> component_observers_;
+        ComponentMask observed_[3];
 
         FreeListStack free_list_;
     };
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "definitions.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BENT_MASK_MATCHER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace bent
+{
+    /// Returns a bitmap of COUNT rows of WORDS words from ROWS whose first QUERY_SIZE words, ANDed with TESTED, equal QUERY.
+    ///
+    /// A row contains QUERY when TESTED is QUERY, and lacks excluded bits when they are in TESTED but not in QUERY.
+    /// Bit i is set when the row i matches. COUNT must be at most 64.
+    using MatchFunction = std::uint64_t (*)(const std::uint64_t * rows, std::uint32_t words, std::uint32_t count, const std::uint64_t * tested, const std::uint64_t * query, std::uint32_t query_size);
+
+    namespace mask_matcher
+    {
+        inline std::uint64_t MatchScalar(const std::uint64_t * rows, std::uint32_t words, std::uint32_t count, const std::uint64_t * tested, const std::uint64_t * query, std::uint32_t query_size)
+        {
+            std::uint64_t matches = 0;
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                auto row = rows + std::size_t(i) * words;
+                std::uint64_t mismatch = 0;
+                for (std::uint32_t j = 0; j < query_size; j++)
+                {
+                    mismatch |= (row[j] & tested[j]) ^ query[j];
+                }
+                matches |= std::uint64_t(mismatch == 0) << i;
+            }
+            return matches;
+        }
+
+#if defined(BENT_MASK_MATCHER_X86)
+
+        /// SSE2 has no 64-bit comparison, so a 64-bit lane matches when both of its 32-bit halves do.
+        inline std::uint32_t LanesEqualSSE2(__m128i row, __m128i tested, __m128i query)
+        {
+            auto equal = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(row, tested), query)));
+            return ((equal & 3) == 3 ? 1u : 0u) | ((equal & 12) == 12 ? 2u : 0u);
+        }
+
+        inline std::uint64_t MatchSSE2(const std::uint64_t * rows, std::uint32_t words, std::uint32_t count, const std::uint64_t * tested, const std::uint64_t * query, std::uint32_t query_size)
+        {
+            std::uint64_t matches = 0;
+            std::uint32_t i = 0;
+            if (words == 1)
+            {
+                auto t = _mm_set1_epi64x(static_cast<long long>(tested[0]));
+                auto q = _mm_set1_epi64x(static_cast<long long>(query[0]));
+                for (; i + 2 <= count; i += 2)
+                {
+                    auto row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + i));
+                    matches |= std::uint64_t(LanesEqualSSE2(row, t, q)) << i;
+                }
+            }
+            else if (words == 2 || words == 4)
+            {
+                // lanes past QUERY_SIZE are 0 in both TESTED and QUERY, which always matches.
+                auto t0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tested));
+                auto t1 = words == 4 ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(tested + 2)) : _mm_setzero_si128();
+                auto q0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(query));
+                auto q1 = words == 4 ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(query + 2)) : _mm_setzero_si128();
+                for (; i < count; i++)
+                {
+                    auto row = rows + std::size_t(i) * words;
+                    auto equal = LanesEqualSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row)), t0, q0);
+                    if (words == 4)
+                    {
+                        equal &= LanesEqualSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 2)), t1, q1);
+                    }
+                    matches |= std::uint64_t(equal == 3) << i;
+                }
+            }
+            return matches | MatchScalar(rows + std::size_t(i) * words, words, count - i, tested, query, query_size) << (i & 63);
+        }
+
+        __attribute__((target("avx2")))
+        inline std::uint64_t MatchAVX2(const std::uint64_t * rows, std::uint32_t words, std::uint32_t count, const std::uint64_t * tested, const std::uint64_t * query, std::uint32_t query_size)
+        {
+            std::uint64_t matches = 0;
+            std::uint32_t i = 0;
+            if (words == 1)
+            {
+                auto t = _mm256_set1_epi64x(static_cast<long long>(tested[0]));
+                auto q = _mm256_set1_epi64x(static_cast<long long>(query[0]));
+                for (; i + 4 <= count; i += 4)
+                {
+                    auto row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + i));
+                    auto equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(row, t), q)));
+                    matches |= std::uint64_t(equal) << i;
+                }
+            }
+            else if (words == 2)
+            {
+                auto t = _mm256_setr_epi64x(static_cast<long long>(tested[0]), static_cast<long long>(tested[1]),
+                                            static_cast<long long>(tested[0]), static_cast<long long>(tested[1]));
+                auto q = _mm256_setr_epi64x(static_cast<long long>(query[0]), static_cast<long long>(query[1]),
+                                            static_cast<long long>(query[0]), static_cast<long long>(query[1]));
+                for (; i + 2 <= count; i += 2)
+                {
+                    auto row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + std::size_t(i) * 2));
+                    auto equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(row, t), q)));
+                    matches |= std::uint64_t(((equal & 3) == 3 ? 1u : 0u) | ((equal & 12) == 12 ? 2u : 0u)) << i;
+                }
+            }
+            else if (words == 4)
+            {
+                auto t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tested));
+                auto q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query));
+                for (; i < count; i++)
+                {
+                    auto row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + std::size_t(i) * 4));
+                    auto equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(row, t), q)));
+                    matches |= std::uint64_t(equal == 15) << i;
+                }
+            }
+            return matches | MatchScalar(rows + std::size_t(i) * words, words, count - i, tested, query, query_size) << (i & 63);
+        }
+
+#endif
+
+        /// Picks the widest kernel the CPU supports.
+        inline MatchFunction Select()
+        {
+#if defined(BENT_MASK_MATCHER_X86)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return &MatchAVX2;
+            }
+            return &MatchSSE2;
+#else
+            return &MatchScalar;
+#endif
+        }
+    }
+
+    /// Returns the kernel matching rows of component masks, chosen once for the running CPU.
+    inline MatchFunction mask_matcher_function()
+    {
+        static const MatchFunction function = mask_matcher::Select();
+        return function;
+    }
+}
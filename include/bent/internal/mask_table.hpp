@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <cassert>
+
+#include "definitions.hpp"
+#include "mask_matcher.hpp"
+
+namespace bent
+{
+    /// Component masks of a query split into 64-bit words: components required in WORDS, and EXCLUDED ones.
+    ///
+    /// TESTED has both, so a mask matches when its bits under TESTED equal WORDS.
+    /// SIZE counts words up to the last one with a required bit, and TESTED_SIZE up to the last with any,
+    /// so a query of components with small ids tests one word.
+    struct MaskQuery
+    {
+        explicit MaskQuery(const ComponentMask & mask = ComponentMask(), const ComponentMask & excluded = ComponentMask()) :
+            size(0),
+            tested_size(0)
+        {
+            std::fill(words, words + MAX_MASK_WORDS, 0);
+            std::fill(tested, tested + MAX_MASK_WORDS, 0);
+            ForEachComponent(mask, [this](std::uint16_t i)
+            {
+                words[i / 64] |= std::uint64_t(1) << (i % 64);
+                tested[i / 64] |= std::uint64_t(1) << (i % 64);
+                size = i / 64 + 1;
+            });
+            tested_size = size;
+            ForEachComponent(excluded, [this](std::uint16_t i)
+            {
+                tested[i / 64] |= std::uint64_t(1) << (i % 64);
+                tested_size = std::max(tested_size, i / 64u + 1);
+            });
+        }
+
+        /// Returns whether any component is excluded.
+        bool excludes() const
+        {
+            for (std::uint32_t i = 0; i < tested_size; i++)
+            {
+                if (tested[i] != words[i])
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool operator==(const MaskQuery & rhs) const
+        {
+            return size == rhs.size && tested_size == rhs.tested_size
+                && std::equal(words, words + size, rhs.words) && std::equal(tested, tested + tested_size, rhs.tested);
+        }
+
+        std::uint64_t words[MAX_MASK_WORDS];
+        std::uint64_t tested[MAX_MASK_WORDS];
+        std::uint32_t size;
+        std::uint32_t tested_size;
+    };
+
+    /// Component masks of entities in a contiguous array aligned to MASK_TABLE_ALIGNMENT bytes.
+    ///
+    /// Each entity has as many 64-bit words as the largest component id set in this table needs,
+    /// rounded up to a power of two: 1, 2 or 4 words for 64, 128 or 256 components.
+    /// The table widens itself when a larger id is set, so most worlds test one word per entity.
+    struct MaskTable
+    {
+        /// Creates a table wide enough for COMPONENTS component types.
+        explicit MaskTable(std::uint32_t components = 0) :
+            words_(WordsFor(components))
+        {}
+
+        MaskTable(const MaskTable & other) :
+            words_(other.words_)
+        {
+            Reallocate(other.size_, other.words_);
+            std::copy(other.data_, other.data_ + std::size_t(other.size_) * other.words_, data_);
+            size_ = other.size_;
+        }
+
+        MaskTable& operator=(MaskTable other)
+        {
+            std::swap(storage_, other.storage_);
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(words_, other.words_);
+            return *this;
+        }
+
+        /// Returns the number of words per entity.
+        std::uint32_t words() const
+        {
+            return words_;
+        }
+
+        /// Returns the number of entities.
+        std::uint32_t size() const
+        {
+            return size_;
+        }
+
+        /// Returns words of all entities, row by row.
+        const std::uint64_t * data() const
+        {
+            return data_;
+        }
+
+        /// Returns words of the entity INDEX.
+        const std::uint64_t * row(std::uint32_t index) const
+        {
+            assert(index < size_);
+            return data_ + std::size_t(index) * words_;
+        }
+
+        bool test(std::uint32_t index, std::uint16_t component_index) const
+        {
+            auto word = component_index / 64u;
+            return word < words_ && (row(index)[word] >> (component_index % 64)) & 1;
+        }
+
+        /// Returns whether the entity INDEX has all components QUERY requires and none it excludes.
+        bool Contains(std::uint32_t index, const MaskQuery & query) const
+        {
+            if (query.size > words_)
+            {
+                return false;
+            }
+            auto words = row(index);
+            for (std::uint32_t i = 0, size = std::min(query.tested_size, words_); i < size; i++)
+            {
+                if ((words[i] & query.tested[i]) != query.words[i])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// Returns a bitmap of entities FIRST to FIRST + COUNT - 1 having all components QUERY requires and none it excludes.
+        ///
+        /// Bit i is for the entity FIRST + i. COUNT must be at most 64.
+        /// Masks are tested in bulk by SIMD where the CPU supports it.
+        std::uint64_t Match(std::uint32_t first, std::uint32_t count, const MaskQuery & query) const
+        {
+            assert(count <= 64 && first + count <= size_);
+            if (query.size > words_)
+            {
+                return 0;
+            }
+            // excluded components past the width of this table are in no mask.
+            return mask_matcher_function()(data_ + std::size_t(first) * words_, words_, count, query.tested, query.words, std::min(query.tested_size, words_));
+        }
+
+        /// Returns the mask of the entity INDEX.
+        ComponentMask mask(std::uint32_t index) const
+        {
+            ComponentMask mask;
+            ForEach(index, [&mask](std::uint16_t i)
+            {
+                mask[i] = true;
+            });
+            return mask;
+        }
+
+        /// Calls FN with each component index set for the entity INDEX, in ascending order.
+        template <typename F>
+        void ForEach(std::uint32_t index, F fn) const
+        {
+            auto words = row(index);
+            for (std::uint32_t i = 0; i < words_; i++)
+            {
+                for (auto word = words[i]; word != 0; word &= word - 1)
+                {
+                    fn(static_cast<std::uint16_t>(i * 64 + CountTrailingZeros(word)));
+                }
+            }
+        }
+
+        void Set(std::uint32_t index, std::uint16_t component_index)
+        {
+            auto word = component_index / 64u;
+            if (word >= words_)
+            {
+                Reallocate(capacity_, WordsFor(component_index + 1u));
+            }
+            mutable_row(index)[word] |= std::uint64_t(1) << (component_index % 64);
+        }
+
+        void Reset(std::uint32_t index, std::uint16_t component_index)
+        {
+            auto word = component_index / 64u;
+            if (word < words_)
+            {
+                mutable_row(index)[word] &= ~(std::uint64_t(1) << (component_index % 64));
+            }
+        }
+
+        /// Clears the mask of the entity INDEX.
+        void Clear(std::uint32_t index)
+        {
+            std::fill(mutable_row(index), mutable_row(index) + words_, 0);
+        }
+
+        /// Changes the number of entities. Masks of new entities are empty.
+        void Resize(std::uint32_t size)
+        {
+            if (size > capacity_)
+            {
+                Reallocate(std::max<std::size_t>(size, capacity_ * 2), words_);
+            }
+            if (size > size_)
+            {
+                std::fill(row_end(size_), row_end(size), 0);
+            }
+            size_ = size;
+        }
+
+        void Reserve(std::size_t capacity)
+        {
+            if (capacity > capacity_)
+            {
+                Reallocate(capacity, words_);
+            }
+        }
+
+    private:
+
+        std::uint64_t * mutable_row(std::uint32_t index)
+        {
+            assert(index < size_);
+            return data_ + std::size_t(index) * words_;
+        }
+
+        std::uint64_t * row_end(std::uint32_t size)
+        {
+            return data_ + std::size_t(size) * words_;
+        }
+
+        /// Returns the power of two number of words holding COMPONENTS bits, at most MAX_MASK_WORDS.
+        static std::uint32_t WordsFor(std::uint32_t components)
+        {
+            std::uint32_t words = 1;
+            while (words * 64 < components && words < MAX_MASK_WORDS)
+            {
+                words *= 2;
+            }
+            return std::min<std::uint32_t>(words, MAX_MASK_WORDS);
+        }
+
+        /// Moves masks to a new array for CAPACITY entities of WORDS words each.
+        void Reallocate(std::size_t capacity, std::uint32_t words)
+        {
+            auto bytes = capacity * words * sizeof(std::uint64_t) + MASK_TABLE_ALIGNMENT;
+            std::unique_ptr<unsigned char []> storage(new unsigned char[bytes]);
+            auto address = reinterpret_cast<std::uintptr_t>(storage.get());
+            auto data = reinterpret_cast<std::uint64_t*>((address + MASK_TABLE_ALIGNMENT - 1) / MASK_TABLE_ALIGNMENT * MASK_TABLE_ALIGNMENT);
+            for (std::uint32_t index = 0; index < size_; index++)
+            {
+                auto dst = data + std::size_t(index) * words;
+                std::copy(row(index), row(index) + std::min(words, words_), dst);
+                std::fill(dst + std::min(words, words_), dst + words, 0);
+            }
+            storage_ = std::move(storage);
+            data_ = data;
+            capacity_ = capacity;
+            words_ = words;
+        }
+
+        std::unique_ptr<unsigned char []> storage_;
+        std::uint64_t * data_ = nullptr;
+        std::uint32_t size_ = 0;
+        std::size_t capacity_ = 0;
+        std::uint32_t words_;
+    };
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <cassert>
+
+#include "definitions.hpp"
+
+namespace bent
+{
+    /// Where entities having a component are, summarized in two levels of bitmaps.
+    ///
+    /// A block is 64 entities and a page is 64 blocks, 4096 entities.
+    /// A bit of blocks is set when any entity of the block has the component,
+    /// and a bit of pages is set when any block of the page does.
+    /// Each block counts its owners, so both levels are kept exact by Insert and Erase in O(1).
+    struct OccupancySummary
+    {
+        /// Records that the entity INDEX got the component.
+        void Insert(std::uint32_t index)
+        {
+            auto block = index / 64;
+            if (counts_.size() <= block)
+            {
+                counts_.resize(block + 1);
+                blocks_.resize(block / 64 + 1);
+                pages_.resize(block / 64 / 64 + 1);
+            }
+            if (counts_[block]++ == 0)
+            {
+                blocks_[block / 64] |= std::uint64_t(1) << (block % 64);
+                pages_[block / 64 / 64] |= std::uint64_t(1) << (block / 64 % 64);
+            }
+        }
+
+        /// Records that entities of the block BLOCK whose bits are set in BITS got the component.
+        void InsertBlock(std::uint32_t block, std::uint64_t bits)
+        {
+            if (bits == 0)
+            {
+                return;
+            }
+            if (counts_.size() <= block)
+            {
+                counts_.resize(block + 1);
+                blocks_.resize(block / 64 + 1);
+                pages_.resize(block / 64 / 64 + 1);
+            }
+            counts_[block] += static_cast<std::uint8_t>(PopCount(bits));
+            blocks_[block / 64] |= std::uint64_t(1) << (block % 64);
+            pages_[block / 64 / 64] |= std::uint64_t(1) << (block / 64 % 64);
+        }
+
+        /// Records that the entity INDEX lost the component.
+        void Erase(std::uint32_t index)
+        {
+            auto block = index / 64;
+            assert(block < counts_.size() && counts_[block] != 0);
+            if (--counts_[block] == 0)
+            {
+                auto & blocks = blocks_[block / 64];
+                blocks &= ~(std::uint64_t(1) << (block % 64));
+                if (blocks == 0)
+                {
+                    pages_[block / 64 / 64] &= ~(std::uint64_t(1) << (block / 64 % 64));
+                }
+            }
+        }
+
+        /// Returns bits of blocks 64 * I to 64 * I + 63, the blocks of the page I.
+        std::uint64_t blocks(std::uint32_t i) const
+        {
+            return i < blocks_.size() ? blocks_[i] : 0;
+        }
+
+        /// Returns bits of pages 64 * I to 64 * I + 63.
+        std::uint64_t pages(std::uint32_t i) const
+        {
+            return i < pages_.size() ? pages_[i] : 0;
+        }
+
+    private:
+
+        std::vector<std::uint8_t> counts_;
+        std::vector<std::uint64_t> blocks_;
+        std::vector<std::uint64_t> pages_;
+    };
+}
@@ -0,0 +1,500 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "definitions.hpp"
+
+namespace bent
+{
+    /// A set of entity indices compressed per range of 65536 indices, after roaring bitmaps.
+    ///
+    /// Each range holding members has a container of their low 16 bits in one of three forms:
+    /// a sorted array of up to 4096 members, a bitmap of 1024 words, or sorted runs of consecutive members.
+    /// A full array turns into runs when they take less memory than a bitmap,
+    /// so memory follows the number of members rather than how far they spread.
+    struct RoaringSet
+    {
+        /// Returns the number of members.
+        std::size_t size() const
+        {
+            return size_;
+        }
+
+        /// Returns the number of ranges of 65536 indices holding members.
+        std::size_t container_count() const
+        {
+            return containers_.size();
+        }
+
+        bool contains(std::uint32_t index) const
+        {
+            auto container = find(index >> 16);
+            if (container == nullptr)
+            {
+                return false;
+            }
+            auto low = static_cast<std::uint16_t>(index);
+            switch (container->kind)
+            {
+            case Kind::Array:
+                return std::binary_search(container->values.begin(), container->values.end(), low);
+            case Kind::Bitmap:
+                return (container->words[low / 64] >> (low % 64)) & 1;
+            case Kind::Runs:
+            default:
+                {
+                    auto next = upper_run(container->runs, low);
+                    return next != container->runs.begin() && low <= (next - 1)->second;
+                }
+            }
+        }
+
+        /// Returns bits of indices 64 * I to 64 * I + 63.
+        std::uint64_t word(std::uint32_t i) const
+        {
+            auto container = find(i >> 10);
+            return container ? Mark(*container, (i % 1024) * 64, 0) : 0;
+        }
+
+        /// Returns bits of indices FIRST to FIRST + COUNT - 1. Bit i is for the index FIRST + i.
+        ///
+        /// COUNT must be 1 to 64.
+        std::uint64_t bits(std::uint32_t first, std::uint32_t count) const
+        {
+            auto shift = first % 64;
+            auto bits = word(first / 64) >> shift;
+            if (shift != 0 && shift + count > 64)
+            {
+                bits |= word(first / 64 + 1) << (64 - shift);
+            }
+            return count == 64 ? bits : bits & ((std::uint64_t(1) << count) - 1);
+        }
+
+        /// Returns bits of blocks of 64 indices in PAGE, a page being 4096 indices.
+        std::uint64_t blocks(std::uint32_t page) const
+        {
+            auto container = find(page >> 4);
+            return container ? Mark(*container, (page % 16) * 4096, 6) : 0;
+        }
+
+        /// Returns bits of pages 64 * I to 64 * I + 63 holding members.
+        std::uint64_t pages(std::uint32_t i) const
+        {
+            std::uint64_t pages = 0;
+            auto key = i * 4;
+            for (auto it = lower_container(key); it != containers_.end() && it->key < key + 4; ++it)
+            {
+                pages |= Mark(*it, 0, 12) << ((it->key - key) * 16);
+            }
+            return pages;
+        }
+
+        /// Calls FN with each member in ascending order.
+        template <typename F>
+        void ForEach(F fn) const
+        {
+            for (auto& container : containers_)
+            {
+                auto high = std::uint32_t(container.key) << 16;
+                Members(container, [&](std::uint16_t low)
+                {
+                    fn(high | low);
+                });
+            }
+        }
+
+        void Insert(std::uint32_t index)
+        {
+            auto key = index >> 16;
+            auto it = lower_container(key);
+            if (it == containers_.end() || it->key != key)
+            {
+                it = containers_.insert(it, Container());
+                it->key = key;
+            }
+            auto & container = *it;
+            auto low = static_cast<std::uint16_t>(index);
+            switch (container.kind)
+            {
+            case Kind::Array:
+                {
+                    auto pos = std::lower_bound(container.values.begin(), container.values.end(), low);
+                    if (pos != container.values.end() && *pos == low)
+                    {
+                        return;
+                    }
+                    container.values.insert(pos, low);
+                    if (container.values.size() > 4096)
+                    {
+                        // a run takes 4 bytes and a bitmap 8192, so runs pay off up to 2048 of them.
+                        if (RunCount(container.values) < 2048)
+                        {
+                            Convert(container, Kind::Runs);
+                        }
+                        else
+                        {
+                            Convert(container, Kind::Bitmap);
+                        }
+                    }
+                }
+                break;
+            case Kind::Bitmap:
+                {
+                    auto & word = container.words[low / 64];
+                    auto bit = std::uint64_t(1) << (low % 64);
+                    if (word & bit)
+                    {
+                        return;
+                    }
+                    word |= bit;
+                }
+                break;
+            case Kind::Runs:
+                if (!InsertRun(container.runs, low))
+                {
+                    return;
+                }
+                if (container.runs.size() > 2048)
+                {
+                    Convert(container, Kind::Bitmap);
+                }
+                break;
+            }
+            ++container.size;
+            ++size_;
+        }
+
+        void Erase(std::uint32_t index)
+        {
+            auto key = index >> 16;
+            auto it = lower_container(key);
+            if (it == containers_.end() || it->key != key)
+            {
+                return;
+            }
+            auto & container = *it;
+            auto low = static_cast<std::uint16_t>(index);
+            switch (container.kind)
+            {
+            case Kind::Array:
+                {
+                    auto pos = std::lower_bound(container.values.begin(), container.values.end(), low);
+                    if (pos == container.values.end() || *pos != low)
+                    {
+                        return;
+                    }
+                    container.values.erase(pos);
+                }
+                break;
+            case Kind::Bitmap:
+                {
+                    auto & word = container.words[low / 64];
+                    auto bit = std::uint64_t(1) << (low % 64);
+                    if ((word & bit) == 0)
+                    {
+                        return;
+                    }
+                    word &= ~bit;
+                }
+                break;
+            case Kind::Runs:
+                if (!EraseRun(container.runs, low))
+                {
+                    return;
+                }
+                break;
+            }
+            --container.size;
+            --size_;
+            if (container.size == 0)
+            {
+                containers_.erase(it);
+            }
+            else if (container.kind == Kind::Bitmap && container.size <= 4096)
+            {
+                Convert(container, Kind::Array);
+            }
+            else if (container.kind == Kind::Runs && container.runs.size() > 2048)
+            {
+                Convert(container, container.size <= 4096 ? Kind::Array : Kind::Bitmap);
+            }
+        }
+
+    private:
+
+        enum class Kind : std::uint8_t
+        {
+            Array,
+            Bitmap,
+            Runs,
+        };
+
+        /// First and last low bits of consecutive members.
+        using Run = std::pair<std::uint16_t, std::uint16_t>;
+
+        struct Container
+        {
+            std::uint32_t key = 0;
+            std::uint32_t size = 0;
+            Kind kind = Kind::Array;
+            std::vector<std::uint16_t> values;
+            std::vector<std::uint64_t> words;
+            std::vector<Run> runs;
+        };
+
+        std::vector<Container>::iterator lower_container(std::uint32_t key)
+        {
+            return std::lower_bound(containers_.begin(), containers_.end(), key, [](const Container & container, std::uint32_t key)
+            {
+                return container.key < key;
+            });
+        }
+
+        std::vector<Container>::const_iterator lower_container(std::uint32_t key) const
+        {
+            return std::lower_bound(containers_.begin(), containers_.end(), key, [](const Container & container, std::uint32_t key)
+            {
+                return container.key < key;
+            });
+        }
+
+        const Container * find(std::uint32_t key) const
+        {
+            auto it = lower_container(key);
+            return it != containers_.end() && it->key == key ? &*it : nullptr;
+        }
+
+        /// Returns the first run starting after LOW.
+        static std::vector<Run>::const_iterator upper_run(const std::vector<Run> & runs, std::uint16_t low)
+        {
+            return std::upper_bound(runs.begin(), runs.end(), low, [](std::uint16_t low, const Run & run)
+            {
+                return low < run.first;
+            });
+        }
+
+        static std::vector<Run>::iterator upper_run(std::vector<Run> & runs, std::uint16_t low)
+        {
+            return std::upper_bound(runs.begin(), runs.end(), low, [](std::uint16_t low, const Run & run)
+            {
+                return low < run.first;
+            });
+        }
+
+        /// Returns bits set from LO to HI.
+        static std::uint64_t Span(std::uint32_t lo, std::uint32_t hi)
+        {
+            auto upper = hi == 63 ? ~std::uint64_t(0) : (std::uint64_t(2) << hi) - 1;
+            return upper & ~((std::uint64_t(1) << lo) - 1);
+        }
+
+        /// Returns bits of 64 groups of 2^SHIFT low bits from FIRST, set where a group holds a member.
+        static std::uint64_t Mark(const Container & container, std::uint32_t first, std::uint32_t shift)
+        {
+            auto end = std::min<std::uint32_t>(65536, first + (64u << shift));
+            std::uint64_t bits = 0;
+            switch (container.kind)
+            {
+            case Kind::Array:
+                for (auto it = std::lower_bound(container.values.begin(), container.values.end(), first); it != container.values.end() && *it < end; ++it)
+                {
+                    bits |= std::uint64_t(1) << ((*it - first) >> shift);
+                }
+                break;
+            case Kind::Bitmap:
+                if (shift == 0)
+                {
+                    return container.words[first / 64];
+                }
+                for (auto i = first / 64; i < end / 64; i++)
+                {
+                    if (container.words[i] != 0)
+                    {
+                        bits |= std::uint64_t(1) << ((i * 64 - first) >> shift);
+                    }
+                }
+                break;
+            case Kind::Runs:
+                {
+                    auto it = upper_run(container.runs, static_cast<std::uint16_t>(first));
+                    if (it != container.runs.begin())
+                    {
+                        --it;
+                    }
+                    for (; it != container.runs.end() && it->first < end; ++it)
+                    {
+                        if (it->second < first)
+                        {
+                            continue;
+                        }
+                        auto lo = std::max<std::uint32_t>(it->first, first);
+                        auto hi = std::min<std::uint32_t>(it->second, end - 1);
+                        bits |= Span((lo - first) >> shift, (hi - first) >> shift);
+                    }
+                }
+                break;
+            }
+            return bits;
+        }
+
+        /// Calls FN with the low bits of each member of CONTAINER in ascending order.
+        template <typename F>
+        static void Members(const Container & container, F fn)
+        {
+            switch (container.kind)
+            {
+            case Kind::Array:
+                for (auto low : container.values)
+                {
+                    fn(low);
+                }
+                break;
+            case Kind::Bitmap:
+                for (std::uint32_t i = 0; i < container.words.size(); i++)
+                {
+                    for (auto word = container.words[i]; word != 0; word &= word - 1)
+                    {
+                        fn(static_cast<std::uint16_t>(i * 64 + CountTrailingZeros(word)));
+                    }
+                }
+                break;
+            case Kind::Runs:
+                for (auto& run : container.runs)
+                {
+                    for (std::uint32_t low = run.first; low <= run.second; low++)
+                    {
+                        fn(static_cast<std::uint16_t>(low));
+                    }
+                }
+                break;
+            }
+        }
+
+        static std::size_t RunCount(const std::vector<std::uint16_t> & values)
+        {
+            std::size_t runs = 0;
+            for (std::size_t i = 0; i < values.size(); i++)
+            {
+                if (i == 0 || values[i] != values[i - 1] + 1)
+                {
+                    ++runs;
+                }
+            }
+            return runs;
+        }
+
+        /// Stores members of CONTAINER in the form KIND.
+        static void Convert(Container & container, Kind kind)
+        {
+            std::vector<std::uint16_t> values;
+            std::vector<std::uint64_t> words;
+            std::vector<Run> runs;
+            switch (kind)
+            {
+            case Kind::Array:
+                values.reserve(container.size);
+                Members(container, [&](std::uint16_t low)
+                {
+                    values.push_back(low);
+                });
+                break;
+            case Kind::Bitmap:
+                words.resize(1024);
+                Members(container, [&](std::uint16_t low)
+                {
+                    words[low / 64] |= std::uint64_t(1) << (low % 64);
+                });
+                break;
+            case Kind::Runs:
+                Members(container, [&](std::uint16_t low)
+                {
+                    if (!runs.empty() && runs.back().second + 1 == low)
+                    {
+                        runs.back().second = low;
+                    }
+                    else
+                    {
+                        runs.push_back(Run(low, low));
+                    }
+                });
+                break;
+            }
+            container.values.swap(values);
+            container.words.swap(words);
+            container.runs.swap(runs);
+            container.kind = kind;
+        }
+
+        /// Adds LOW to RUNS, returning whether it was not there.
+        static bool InsertRun(std::vector<Run> & runs, std::uint16_t low)
+        {
+            auto next = upper_run(runs, low);
+            if (next != runs.begin())
+            {
+                auto prev = next - 1;
+                if (low <= prev->second)
+                {
+                    return false;
+                }
+                if (low == prev->second + 1)
+                {
+                    prev->second = low;
+                    if (next != runs.end() && next->first == low + 1)
+                    {
+                        prev->second = next->second;
+                        runs.erase(next);
+                    }
+                    return true;
+                }
+            }
+            if (next != runs.end() && next->first == low + 1)
+            {
+                next->first = low;
+                return true;
+            }
+            runs.insert(next, Run(low, low));
+            return true;
+        }
+
+        /// Removes LOW from RUNS, returning whether it was there.
+        static bool EraseRun(std::vector<Run> & runs, std::uint16_t low)
+        {
+            auto next = upper_run(runs, low);
+            if (next == runs.begin())
+            {
+                return false;
+            }
+            auto run = next - 1;
+            if (low > run->second)
+            {
+                return false;
+            }
+            if (run->first == run->second)
+            {
+                runs.erase(run);
+            }
+            else if (low == run->first)
+            {
+                ++run->first;
+            }
+            else if (low == run->second)
+            {
+                --run->second;
+            }
+            else
+            {
+                auto last = run->second;
+                run->second = low - 1;
+                runs.insert(next, Run(low + 1, last));
+            }
+            return true;
+        }
+
+        std::vector<Container> containers_;
+        std::size_t size_ = 0;
+    };
+}
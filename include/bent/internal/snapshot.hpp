@@ -0,0 +1,327 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <limits>
+#include <climits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BENT_SNAPSHOT_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bent
+{
+    /// Sections of a snapshot start at multiples of this many bytes, so components of alignment up to it are used in place.
+    constexpr std::size_t SNAPSHOT_ALIGNMENT = 64;
+    constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+
+    /// How components of a type are laid out in a snapshot.
+    enum class SnapshotEncoding : std::uint32_t
+    {
+        /// No data; owners are all there is to a tag.
+        Tag,
+        /// Blocks of components indexed by entity index as `ComponentPool` holds them, each aligned.
+        Blocks,
+        /// Bytes of components of owners in ascending order of entity index.
+        Bytes,
+        /// Bytes each component's serializer wrote, prefixed with their size, in ascending order of entity index.
+        Serialized,
+    };
+
+    struct SnapshotHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        // written as 1, so files of the other byte order are told apart.
+        std::uint32_t byte_order;
+        std::uint32_t entity_count;
+        std::uint32_t free_count;
+        std::uint32_t record_count;
+        std::uint32_t change_tick;
+    };
+
+    /// Heads the components of a type: its name follows, then a bitmap of owners over entity indices, then PAYLOAD_SIZE bytes of components.
+    struct SnapshotRecord
+    {
+        std::uint32_t name_size;
+        SnapshotEncoding encoding;
+        std::uint32_t count;
+        std::uint32_t element_size;
+        std::uint64_t payload_size;
+    };
+
+    inline const char * SnapshotMagic()
+    {
+        return "BENTSNAP";
+    }
+
+    /// Writes a snapshot to a file through a buffer.
+    struct SnapshotWriter
+    {
+        /// Opens the file at PATH for writing, throwing `std::runtime_error` when it can't.
+        explicit SnapshotWriter(const std::string & path) :
+            file_(std::fopen(path.c_str(), "wb")),
+            path_(path)
+        {
+            if (!file_)
+            {
+                throw std::runtime_error("can't open `" + path + "` to write a snapshot");
+            }
+            std::setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+        }
+
+        SnapshotWriter(const SnapshotWriter&) = delete;
+        SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+        ~SnapshotWriter()
+        {
+            if (file_)
+            {
+                std::fclose(file_);
+            }
+        }
+
+        /// Returns the number of bytes written.
+        std::uint64_t offset() const
+        {
+            return offset_;
+        }
+
+        void Write(const void * data, std::size_t size)
+        {
+            if (size != 0 && std::fwrite(data, 1, size, file_) != size)
+            {
+                Fail();
+            }
+            offset_ += size;
+        }
+
+        template <typename T>
+        void Write(const T & value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values are written as they are");
+            Write(&value, sizeof(T));
+        }
+
+        /// Pads with zeros up to a multiple of SNAPSHOT_ALIGNMENT bytes.
+        void Align()
+        {
+            static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+            Write(zeros, (SNAPSHOT_ALIGNMENT - offset_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+        }
+
+        /// Overwrites VALUE written at OFFSET before.
+        template <typename T>
+        void Patch(std::uint64_t offset, const T & value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values are written as they are");
+            if (!Seek(offset) || std::fwrite(&value, sizeof(T), 1, file_) != 1 || std::fseek(file_, 0, SEEK_END) != 0)
+            {
+                Fail();
+            }
+        }
+
+        /// Flushes the file to the disk and closes it, throwing `std::runtime_error` when it can't be written completely.
+        ///
+        /// The file is synced where `fsync` is available, so renaming it over an older snapshot never leaves a file not written yet.
+        void Close()
+        {
+            auto file = file_;
+            file_ = nullptr;
+            auto flushed = std::fflush(file) == 0;
+#if defined(BENT_SNAPSHOT_MMAP)
+            flushed = flushed && fsync(fileno(file)) == 0;
+#endif
+            if (std::fclose(file) != 0 || !flushed)
+            {
+                throw std::runtime_error("can't write a snapshot to `" + path_ + "`");
+            }
+        }
+
+    private:
+
+        void Fail()
+        {
+            throw std::runtime_error("can't write a snapshot to `" + path_ + "`");
+        }
+
+        /// Moves to OFFSET from the start by the widest seek available, as `long` is 32 bits on some platforms.
+        bool Seek(std::uint64_t offset)
+        {
+#if defined(_WIN32)
+            return offset <= std::uint64_t(std::numeric_limits<__int64>::max()) && _fseeki64(file_, static_cast<__int64>(offset), SEEK_SET) == 0;
+#elif defined(BENT_SNAPSHOT_MMAP)
+            return offset <= std::uint64_t(std::numeric_limits<off_t>::max()) && fseeko(file_, static_cast<off_t>(offset), SEEK_SET) == 0;
+#else
+            return offset <= std::uint64_t(LONG_MAX) && std::fseek(file_, static_cast<long>(offset), SEEK_SET) == 0;
+#endif
+        }
+
+        std::FILE * file_;
+        std::string path_;
+        std::uint64_t offset_ = 0;
+    };
+
+    /// A snapshot file in memory, mapped privately where `mmap` is available and read otherwise.
+    ///
+    /// Bytes may be written: pages of a mapping are copied by the OS when first written, so the file never changes.
+    /// Blocks of components adopted from the file keep it in memory by sharing ownership of this.
+    struct SnapshotFile
+    {
+        /// Maps the file at PATH, throwing `std::runtime_error` when it can't.
+        explicit SnapshotFile(const std::string & path)
+        {
+#if defined(BENT_SNAPSHOT_MMAP)
+            auto fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw std::runtime_error("can't open the snapshot `" + path + "`");
+            }
+            struct stat status;
+            if (::fstat(fd, &status) != 0)
+            {
+                ::close(fd);
+                throw std::runtime_error("can't read the snapshot `" + path + "`");
+            }
+            size_ = static_cast<std::size_t>(status.st_size);
+            if (size_ != 0)
+            {
+                auto data = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED)
+                {
+                    ::close(fd);
+                    throw std::runtime_error("can't map the snapshot `" + path + "`");
+                }
+                data_ = static_cast<char*>(data);
+            }
+            ::close(fd);
+#else
+            auto file = std::fopen(path.c_str(), "rb");
+            if (!file)
+            {
+                throw std::runtime_error("can't open the snapshot `" + path + "`");
+            }
+            std::fseek(file, 0, SEEK_END);
+            auto size = std::ftell(file);
+            std::fseek(file, 0, SEEK_SET);
+            if (size < 0)
+            {
+                std::fclose(file);
+                throw std::runtime_error("can't read the snapshot `" + path + "`");
+            }
+            size_ = static_cast<std::size_t>(size);
+            // over-allocated to align the data like a mapping.
+            buffer_.reset(new char[size_ + SNAPSHOT_ALIGNMENT]);
+            auto address = reinterpret_cast<std::uintptr_t>(buffer_.get());
+            data_ = buffer_.get() + (SNAPSHOT_ALIGNMENT - address % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT;
+            auto read = std::fread(data_, 1, size_, file);
+            std::fclose(file);
+            if (read != size_)
+            {
+                throw std::runtime_error("can't read the snapshot `" + path + "`");
+            }
+#endif
+        }
+
+        SnapshotFile(const SnapshotFile&) = delete;
+        SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+        ~SnapshotFile()
+        {
+#if defined(BENT_SNAPSHOT_MMAP)
+            if (data_)
+            {
+                ::munmap(data_, size_);
+            }
+#endif
+        }
+
+        char * data() const
+        {
+            return data_;
+        }
+
+        std::size_t size() const
+        {
+            return size_;
+        }
+
+    private:
+
+        char * data_ = nullptr;
+        std::size_t size_ = 0;
+#if !defined(BENT_SNAPSHOT_MMAP)
+        std::unique_ptr<char []> buffer_;
+#endif
+    };
+
+    /// Reads a snapshot in place, checking every read is within the file.
+    struct SnapshotReader
+    {
+        explicit SnapshotReader(std::shared_ptr<SnapshotFile> file) :
+            file_(std::move(file))
+        {}
+
+        const std::shared_ptr<SnapshotFile> & file() const
+        {
+            return file_;
+        }
+
+        std::uint64_t offset() const
+        {
+            return offset_;
+        }
+
+        /// Returns SIZE bytes at the offset and skips them, throwing `std::runtime_error` when the file ends before.
+        char * Take(std::uint64_t size)
+        {
+            if (size > file_->size() - offset_)
+            {
+                throw std::runtime_error("the snapshot is truncated");
+            }
+            auto data = file_->data() + offset_;
+            offset_ += size;
+            return data;
+        }
+
+        template <typename T>
+        T Read()
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values are read as they are");
+            T value;
+            std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        /// Skips padding up to a multiple of SNAPSHOT_ALIGNMENT bytes.
+        void Align()
+        {
+            Take((SNAPSHOT_ALIGNMENT - offset_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+        }
+
+        /// Moves to OFFSET, throwing `std::runtime_error` when it is past the end of the file.
+        void Seek(std::uint64_t offset)
+        {
+            if (offset > file_->size())
+            {
+                throw std::runtime_error("the snapshot is truncated");
+            }
+            offset_ = offset;
+        }
+
+    private:
+
+        std::shared_ptr<SnapshotFile> file_;
+        std::uint64_t offset_ = 0;
+    };
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cassert>
+#include <algorithm>
+#include <utility>
+
+#include "definitions.hpp"
+
+namespace bent
+{
+    constexpr std::uint32_t NULL_POSITION = std::numeric_limits<std::uint32_t>::max();
+
+    /// A set of entity indices.
+    ///
+    /// Indices are packed in a dense array, and a paged sparse array maps each index back to its position in it.
+    /// Insertion appends and erasure swaps with the last element, so both are O(1).
+    struct SparseSet
+    {
+        SparseSet() = default;
+
+        SparseSet(const SparseSet & other) :
+            dense_(other.dense_),
+            pages_(other.pages_.size())
+        {
+            for (std::size_t i = 0; i < pages_.size(); i++)
+            {
+                if (other.pages_[i])
+                {
+                    pages_[i].reset(new std::uint32_t[SPARSE_PAGE_SIZE]);
+                    std::copy(other.pages_[i].get(), other.pages_[i].get() + SPARSE_PAGE_SIZE, pages_[i].get());
+                }
+            }
+        }
+
+        SparseSet(SparseSet&&) = default;
+
+        SparseSet & operator=(SparseSet other)
+        {
+            dense_.swap(other.dense_);
+            pages_.swap(other.pages_);
+            return *this;
+        }
+
+        /// Returns whether INDEX is in this set.
+        bool contains(std::uint32_t index) const
+        {
+            return position(index) != NULL_POSITION;
+        }
+
+        /// Returns the position of INDEX in the dense array, or NULL_POSITION.
+        std::uint32_t position(std::uint32_t index) const
+        {
+            auto i = index / SPARSE_PAGE_SIZE;
+            if (pages_.size() <= i || !pages_[i])
+            {
+                return NULL_POSITION;
+            }
+            return pages_[i][index % SPARSE_PAGE_SIZE];
+        }
+
+        /// Returns the index at POSITION of the dense array.
+        std::uint32_t index(std::uint32_t position) const
+        {
+            assert(position < dense_.size());
+            return dense_[position];
+        }
+
+        std::uint32_t size() const
+        {
+            return static_cast<std::uint32_t>(dense_.size());
+        }
+
+        bool empty() const
+        {
+            return dense_.empty();
+        }
+
+        const std::uint32_t * data() const
+        {
+            return dense_.data();
+        }
+
+        /// Reserves the dense array for COUNT indices.
+        void Reserve(std::size_t count)
+        {
+            dense_.reserve(count);
+        }
+
+        /// Appends INDEX to the dense array.
+        ///
+        /// @return position of INDEX.
+        std::uint32_t Insert(std::uint32_t index)
+        {
+            assert(!contains(index));
+            auto position = size();
+            dense_.push_back(index);
+            slot(index) = position;
+            return position;
+        }
+
+        /// Removes INDEX by moving the last index into its position.
+        ///
+        /// @return position INDEX was at. The last index now lives there.
+        std::uint32_t Erase(std::uint32_t index)
+        {
+            assert(contains(index));
+            auto position = slot(index);
+            auto last = dense_.back();
+            dense_[position] = last;
+            slot(last) = position;
+            slot(index) = NULL_POSITION;
+            dense_.pop_back();
+            return position;
+        }
+
+        /// Swaps indices at positions LHS and RHS of the dense array.
+        void Swap(std::uint32_t lhs, std::uint32_t rhs)
+        {
+            assert(lhs < dense_.size() && rhs < dense_.size());
+            std::swap(dense_[lhs], dense_[rhs]);
+            slot(dense_[lhs]) = lhs;
+            slot(dense_[rhs]) = rhs;
+        }
+
+    private:
+
+        std::uint32_t & slot(std::uint32_t index)
+        {
+            auto i = index / SPARSE_PAGE_SIZE;
+            if (pages_.size() <= i)
+            {
+                pages_.resize(i + 1);
+            }
+            auto & page = pages_[i];
+            if (!page)
+            {
+                page.reset(new std::uint32_t[SPARSE_PAGE_SIZE]);
+                std::fill(page.get(), page.get() + SPARSE_PAGE_SIZE, NULL_POSITION);
+            }
+            return page[index % SPARSE_PAGE_SIZE];
+        }
+
+        std::vector<std::uint32_t> dense_;
+        std::vector<std::unique_ptr<std::uint32_t []>> pages_;
+    };
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+namespace bent
+{
+    /// Work-stealing thread pool running batches of indexed tasks.
+    ///
+    /// Tasks of a batch are split into a contiguous range per worker.
+    /// A worker takes tasks from the front of its own range and, when it runs out, steals from the back of others.
+    /// The thread calling Run works as one of the workers.
+    struct ThreadPool
+    {
+        /// Creates a pool running tasks on CONCURRENCY threads, including the caller of Run.
+        explicit ThreadPool(std::size_t concurrency = default_concurrency())
+        {
+            Start(concurrency);
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool()
+        {
+            Stop();
+        }
+
+        /// Returns the pool shared by worlds.
+        static ThreadPool & instance()
+        {
+            static ThreadPool instance;
+            return instance;
+        }
+
+        static std::size_t default_concurrency()
+        {
+            auto concurrency = std::thread::hardware_concurrency();
+            return concurrency == 0 ? 1 : concurrency;
+        }
+
+        /// Returns the number of the worker running the current task, from 0 to concurrency() - 1.
+        ///
+        /// The caller of Run is the worker 0. Use this to pick per-thread data such as command buffers.
+        static std::size_t worker()
+        {
+            return worker_index();
+        }
+
+        /// Returns the number of threads running tasks, including the caller of Run.
+        std::size_t concurrency() const
+        {
+            return queues_.size();
+        }
+
+        /// Changes the number of threads running tasks.
+        ///
+        /// Must not be called while running tasks.
+        void Resize(std::size_t concurrency)
+        {
+            Stop();
+            Start(concurrency);
+        }
+
+        /// Calls FN with each of 0 to COUNT - 1 on worker threads and waits for all of them.
+        ///
+        /// An exception thrown by FN is rethrown here after all tasks are done.
+        /// Run called from a task runs its tasks on the calling thread.
+        void Run(std::uint32_t count, const std::function<void(std::uint32_t)> & fn)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+            if (queues_.size() == 1 || running_task())
+            {
+                for (std::uint32_t i = 0; i < count; i++)
+                {
+                    fn(i);
+                }
+                return;
+            }
+
+            std::lock_guard<std::mutex> run_lock(run_mutex_);
+            task_ = &fn;
+            exception_ = nullptr;
+            pending_ = count;
+            auto workers = static_cast<std::uint32_t>(queues_.size());
+            for (std::uint32_t i = 0; i < workers; i++)
+            {
+                auto & queue = *queues_[i];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.begin = static_cast<std::uint32_t>(std::uint64_t(count) * i / workers);
+                queue.end = static_cast<std::uint32_t>(std::uint64_t(count) * (i + 1) / workers);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++generation_;
+            }
+            wake_.notify_all();
+
+            Work(0);
+
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                done_.wait(lock, [this] { return pending_ == 0; });
+            }
+            task_ = nullptr;
+            if (exception_)
+            {
+                std::rethrow_exception(exception_);
+            }
+        }
+
+    private:
+
+        struct Queue
+        {
+            std::mutex mutex;
+            std::uint32_t begin = 0;
+            std::uint32_t end = 0;
+            char padding[64];
+        };
+
+        static bool & running_task()
+        {
+            static thread_local bool running = false;
+            return running;
+        }
+
+        static std::size_t & worker_index()
+        {
+            static thread_local std::size_t index = 0;
+            return index;
+        }
+
+        void Start(std::size_t concurrency)
+        {
+            if (concurrency == 0)
+            {
+                concurrency = 1;
+            }
+            stop_ = false;
+            for (std::size_t i = 0; i < concurrency; i++)
+            {
+                queues_.emplace_back(new Queue);
+            }
+            for (std::size_t i = 1; i < concurrency; i++)
+            {
+                threads_.emplace_back(&ThreadPool::Loop, this, i);
+            }
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            for (auto & thread : threads_)
+            {
+                thread.join();
+            }
+            threads_.clear();
+            queues_.clear();
+        }
+
+        void Loop(std::size_t worker)
+        {
+            worker_index() = worker;
+            std::uint64_t generation = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    wake_.wait(lock, [&] { return stop_ || generation_ != generation; });
+                    if (stop_)
+                    {
+                        return;
+                    }
+                    generation = generation_;
+                }
+                Work(worker);
+            }
+        }
+
+        /// Runs tasks until no worker has one left.
+        void Work(std::size_t worker)
+        {
+            std::uint32_t task;
+            while (Pop(worker, task) || Steal(worker, task))
+            {
+                running_task() = true;
+                try
+                {
+                    (*task_)(task);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!exception_)
+                    {
+                        exception_ = std::current_exception();
+                    }
+                }
+                running_task() = false;
+                if (--pending_ == 0)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    done_.notify_all();
+                }
+            }
+        }
+
+        bool Pop(std::size_t worker, std::uint32_t & task)
+        {
+            auto & queue = *queues_[worker];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.begin == queue.end)
+            {
+                return false;
+            }
+            task = queue.begin++;
+            return true;
+        }
+
+        bool Steal(std::size_t worker, std::uint32_t & task)
+        {
+            for (std::size_t i = 1; i < queues_.size(); i++)
+            {
+                auto & queue = *queues_[(worker + i) % queues_.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.begin != queue.end)
+                {
+                    task = --queue.end;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::vector<std::thread> threads_;
+
+        std::mutex run_mutex_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        std::uint64_t generation_ = 0;
+        bool stop_ = false;
+
+        const std::function<void(std::uint32_t)> * task_ = nullptr;
+        std::atomic<std::uint32_t> pending_ { 0 };
+        std::exception_ptr exception_;
+    };
+}
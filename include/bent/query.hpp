@@ -0,0 +1,84 @@
+#pragma once
+
+#include <type_traits>
+
+#include "component_storage.hpp"
+
+namespace bent
+{
+    /// Components entities must have in `World::query`, passed to `Query::each` as references.
+    template <typename... Ts>
+    struct With
+    {
+    };
+
+    /// Components entities must not have in `World::query`.
+    template <typename... Ts>
+    struct Without
+    {
+    };
+
+    /// Components passed to `Query::each` as pointers, nullptr for entities that don't have them.
+    template <typename... Ts>
+    struct Optional
+    {
+    };
+
+    /// Components entities must have got after the tick given to `World::query`. Implies `With`, without passing them to `Query::each`.
+    ///
+    /// Changes of the components must be tracked. See `ComponentChanges`.
+    template <typename... Ts>
+    struct Added
+    {
+    };
+
+    /// Components entities must have got or accessed mutably after the tick given to `World::query`. Implies `With` like `Added`.
+    template <typename... Ts>
+    struct Changed
+    {
+    };
+
+    /// Whether changes of all components Ts are tracked.
+    template <typename... Ts>
+    struct ChangesTracked : std::true_type
+    {
+    };
+
+    template <typename T, typename... Ts>
+    struct ChangesTracked<T, Ts...> : std::integral_constant<bool, std::is_same<typename ComponentChanges<T>::type, TrackedChanges>::value && ChangesTracked<Ts...>::value>
+    {
+    };
+
+    /// Finds the term of kind TERM among TERMS as `type`, or TERM<> when there is none.
+    template <template <typename...> class Term, typename... Terms>
+    struct TermOf
+    {
+        using type = Term<>;
+    };
+
+    template <template <typename...> class Term, typename... Ts, typename... Terms>
+    struct TermOf<Term, Term<Ts...>, Terms...>
+    {
+        using type = Term<Ts...>;
+    };
+
+    template <template <typename...> class Term, typename Other, typename... Terms>
+    struct TermOf<Term, Other, Terms...> : TermOf<Term, Terms...>
+    {
+    };
+
+    template <typename Required, typename Excluded, typename Optionals, typename AddedSince, typename ChangedSince>
+    struct Query;
+
+    template <typename Required, typename Excluded, typename Optionals>
+    struct CachedQuery;
+
+    /// The query of `With`, `Without`, `Optional`, `Added` and `Changed` terms in TERMS, each at most once and in any order.
+    template <typename... Terms>
+    using QueryOf = Query<typename TermOf<With, Terms...>::type, typename TermOf<Without, Terms...>::type, typename TermOf<Optional, Terms...>::type,
+        typename TermOf<Added, Terms...>::type, typename TermOf<Changed, Terms...>::type>;
+
+    /// The cached query of `With`, `Without` and `Optional` terms in TERMS, like `QueryOf`. Change filters aren't cached.
+    template <typename... Terms>
+    using CachedQueryOf = CachedQuery<typename TermOf<With, Terms...>::type, typename TermOf<Without, Terms...>::type, typename TermOf<Optional, Terms...>::type>;
+}
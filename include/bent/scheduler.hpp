@@ -0,0 +1,309 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <initializer_list>
+#include <algorithm>
+
+#include "internal/definitions.hpp"
+#include "internal/thread_pool.hpp"
+#include "component_manager.hpp"
+#include "world.hpp"
+
+namespace bent
+{
+    /// Declares that a system reads components Ts.
+    ///
+    /// Components whose changes are tracked count as written, as getting them by `Get` or `each` stamps them. See `ComponentChanges`.
+    template <typename... Ts>
+    struct Read
+    {
+    };
+
+    /// Declares that a system writes components Ts.
+    template <typename... Ts>
+    struct Write
+    {
+    };
+
+    /// Declares that a system creates or destroys entities, or adds or removes components.
+    ///
+    /// Such a system runs alone.
+    struct Exclusive
+    {
+    };
+
+    template <typename Access>
+    struct SystemAccess;
+
+    template <typename... Ts>
+    struct SystemAccess<Read<Ts...>>
+    {
+        static void Declare(ComponentMask & reads, ComponentMask & writes, bool &)
+        {
+            auto & manager = ComponentManager::instance();
+            (void) manager;
+            (void) std::initializer_list<int> { ((ChangesTracked<Ts>::value ? writes : reads)[manager.id<Ts>()] = true, 0)... };
+        }
+    };
+
+    template <typename... Ts>
+    struct SystemAccess<Write<Ts...>>
+    {
+        static void Declare(ComponentMask &, ComponentMask & writes, bool &)
+        {
+            auto & manager = ComponentManager::instance();
+            (void) manager;
+            (void) std::initializer_list<int> { (writes[manager.id<Ts>()] = true, 0)... };
+        }
+    };
+
+    template <>
+    struct SystemAccess<Exclusive>
+    {
+        static void Declare(ComponentMask &, ComponentMask &, bool & exclusive)
+        {
+            exclusive = true;
+        }
+    };
+
+    /// Components a system accesses, such as `System<Read<Velocity>, Write<Position>>`.
+    template <typename... Accesses>
+    struct System
+    {
+        static void Declare(ComponentMask & reads, ComponentMask & writes, bool & exclusive)
+        {
+            (void) std::initializer_list<int> { (SystemAccess<Accesses>::Declare(reads, writes, exclusive), 0)... };
+        }
+    };
+
+    /// Runs systems of a world, running systems that access no component in conflict concurrently.
+    ///
+    /// Each frame, a system waits for systems added before it that write a component it accesses,
+    /// or access a component it writes.
+    /// Systems that are not `Exclusive` can't create or destroy entities nor add or remove components.
+    struct Scheduler
+    {
+        using Function = std::function<void(World&)>;
+        using Duration = std::chrono::steady_clock::duration;
+
+        /// Timing of the last frame.
+        struct Report
+        {
+            /// Wall time of the frame.
+            Duration frame_time = Duration::zero();
+
+            /// Time of each system, in the order added.
+            std::vector<Duration> system_times;
+
+            /// Names of systems on the longest chain of dependent systems.
+            ///
+            /// However many threads run, a frame takes at least the time of this chain.
+            std::vector<std::string> critical_path;
+            Duration critical_path_time = Duration::zero();
+        };
+
+        explicit Scheduler(World & world, ThreadPool & thread_pool = ThreadPool::instance()) :
+            world_(world),
+            thread_pool_(thread_pool)
+        {}
+
+        /// Adds a system named NAME, accessing components as declared by SystemT.
+        ///
+        /// Systems run as tasks of the thread pool, so `parallel_each` and other batches run inside FN run serially on its thread.
+        /// Split work into more systems to run it concurrently.
+        template <typename SystemT>
+        void Add(const std::string & name, Function fn)
+        {
+            Node node;
+            node.name = name;
+            node.fn = std::move(fn);
+            SystemT::Declare(node.reads, node.writes, node.exclusive);
+            nodes_.push_back(std::move(node));
+        }
+
+        /// Runs all systems once, then delivers events of components to observers. See `World::Observe`.
+        void Run()
+        {
+            auto start = std::chrono::steady_clock::now();
+            Plan();
+
+            auto count = static_cast<std::uint32_t>(nodes_.size());
+            std::deque<std::uint32_t> ready;
+            for (std::uint32_t i = 0; i < count; i++)
+            {
+                auto & node = nodes_[i];
+                node.pending = static_cast<std::uint32_t>(node.predecessors.size());
+                if (node.pending == 0)
+                {
+                    ready.push_back(i);
+                }
+            }
+
+            std::mutex mutex;
+            std::condition_variable wake;
+            auto remaining = count;
+            auto failed = false;
+            auto workers = static_cast<std::uint32_t>(std::min<std::size_t>(thread_pool_.concurrency(), count));
+            thread_pool_.Run(workers, [&](std::uint32_t)
+            {
+                while (true)
+                {
+                    std::uint32_t i;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        wake.wait(lock, [&] { return !ready.empty() || remaining == 0 || failed; });
+                        if (remaining == 0 || failed)
+                        {
+                            return;
+                        }
+                        i = ready.front();
+                        ready.pop_front();
+                    }
+                    try
+                    {
+                        RunSystem(nodes_[i]);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        failed = true;
+                        wake.notify_all();
+                        throw;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        --remaining;
+                        for (auto successor : nodes_[i].successors)
+                        {
+                            if (--nodes_[successor].pending == 0)
+                            {
+                                ready.push_back(successor);
+                            }
+                        }
+                    }
+                    wake.notify_all();
+                }
+            });
+
+            world_.NotifyObservers();
+            MakeReport(std::chrono::steady_clock::now() - start);
+        }
+
+        const Report & report() const
+        {
+            return report_;
+        }
+
+    private:
+
+        struct Node
+        {
+            std::string name;
+            Function fn;
+            ComponentMask reads;
+            ComponentMask writes;
+            bool exclusive = false;
+
+            std::vector<std::uint32_t> predecessors;
+            std::vector<std::uint32_t> successors;
+            std::uint32_t pending = 0;
+            Duration time = Duration::zero();
+        };
+
+        static bool Conflicts(const Node & lhs, const Node & rhs)
+        {
+            return lhs.exclusive || rhs.exclusive
+                || (lhs.writes & (rhs.reads | rhs.writes)).any()
+                || (rhs.writes & lhs.reads).any();
+        }
+
+        /// Builds the graph of systems that must not run concurrently.
+        void Plan()
+        {
+            for (auto & node : nodes_)
+            {
+                node.predecessors.clear();
+                node.successors.clear();
+            }
+            for (std::uint32_t j = 0; j < nodes_.size(); j++)
+            {
+                for (std::uint32_t i = 0; i < j; i++)
+                {
+                    if (Conflicts(nodes_[i], nodes_[j]))
+                    {
+                        nodes_[j].predecessors.push_back(i);
+                        nodes_[i].successors.push_back(j);
+                    }
+                }
+            }
+        }
+
+        void RunSystem(Node & node)
+        {
+            auto start = std::chrono::steady_clock::now();
+            if (node.exclusive)
+            {
+                node.fn(world_);
+            }
+            else
+            {
+                World::StructureLock lock(world_.entity_manager_);
+                node.fn(world_);
+            }
+            node.time = std::chrono::steady_clock::now() - start;
+        }
+
+        /// Finds the critical path from times of systems. Systems are already in a topological order.
+        void MakeReport(Duration frame_time)
+        {
+            report_.frame_time = frame_time;
+            report_.system_times.clear();
+            report_.critical_path.clear();
+            report_.critical_path_time = Duration::zero();
+
+            const auto none = static_cast<std::uint32_t>(nodes_.size());
+            std::vector<Duration> finish(nodes_.size());
+            std::vector<std::uint32_t> previous(nodes_.size(), none);
+            auto last = none;
+            for (std::uint32_t i = 0; i < nodes_.size(); i++)
+            {
+                auto & node = nodes_[i];
+                report_.system_times.push_back(node.time);
+                finish[i] = node.time;
+                for (auto predecessor : node.predecessors)
+                {
+                    if (finish[predecessor] + node.time > finish[i])
+                    {
+                        finish[i] = finish[predecessor] + node.time;
+                        previous[i] = predecessor;
+                    }
+                }
+                if (last == none || finish[i] > finish[last])
+                {
+                    last = i;
+                }
+            }
+            if (last == none)
+            {
+                return;
+            }
+            report_.critical_path_time = finish[last];
+            for (auto i = last; i != none; i = previous[i])
+            {
+                report_.critical_path.push_back(nodes_[i].name);
+            }
+            std::reverse(report_.critical_path.begin(), report_.critical_path.end());
+        }
+
+        World & world_;
+        ThreadPool & thread_pool_;
+        std::vector<Node> nodes_;
+        Report report_;
+    };
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <iterator>
+#include <algorithm>
+#include <limits>
+#include <vector>
 
 #include "internal/entity_manager.hpp"
 #include "entity_handle.hpp"
@@ -25,7 +28,20 @@ namespace bent
 
             iterator & operator++()
             {
-                ++index_;
+                if (driver_ || archetypes_)
+                {
+                    --index_;
+                }
+                else
+                {
+                    extend();
+                    if (--remaining_ == 0)
+                    {
+                        index_ = std::numeric_limits<std::uint32_t>::max();
+                        return *this;
+                    }
+                    ++index_;
+                }
                 next();
                 return *this;
             }
@@ -39,7 +55,7 @@ namespace bent
 
             bool operator==(const iterator& rhs) const
             {
-                return index_ == rhs.index_;
+                return archetype_ == rhs.archetype_ && index_ == rhs.index_;
             }
 
             bool operator!=(const iterator& rhs) const
@@ -47,65 +63,367 @@ namespace bent
                 return !operator==(rhs);
             }
 
+            /// Returns the number of blocks of 64 entities whose masks this iterator has tested, telling what scanning cost.
+            std::uint32_t blocks_tested() const
+            {
+                return blocks_tested_;
+            }
+
         private:
             friend View;
-            using ComponentMask = EntityManager::ComponentMask;
-            using EntityVersionVectorIterator = EntityManager::EntityVersionVector::iterator;
+            using ArchetypeVector = std::vector<Archetype*>;
 
-            iterator(EntityManager & entity_manager, const ComponentMask & component_mask, std::uint32_t index, std::uint32_t end) :
+            /// Scans entity indices from INDEX to END until REMAINING entities are found,
+            /// or walks owners of DRIVER backwards from INDEX to 0.
+            ///
+            /// Scanning tests masks of 64 entities at once and visits the matching ones by count-trailing-zeros.
+            /// Occupancy summaries let it jump over blocks where no entity has all queried components.
+            /// Components added while scanning extend REMAINING and make the rest of the current block be tested again once its matches run out,
+            /// so entities they make match aren't missed; later blocks aren't tested yet.
+            ///
+            /// Walking backwards lets the current entity lose the driver component without skipping others.
+            /// Every iterator ends at archetype 0 and index `std::numeric_limits<std::uint32_t>::max()`, so any of them equals `View::end`.
+            iterator(EntityManager & entity_manager, const MaskQuery & query, const SparseSet * driver, std::uint32_t index, std::uint32_t end, std::uint32_t remaining,
+                const ChangeQuery * changes) :
                 entity_manager_(&entity_manager),
-                component_mask_(component_mask),
+                query_(query),
+                changes_(changes),
+                driver_(driver),
+                archetypes_(nullptr),
+                archetype_(0),
                 index_(index),
-                end_(end)
+                end_(end),
+                remaining_(remaining),
+                additions_(entity_manager.additions()),
+                matches_(0),
+                pending_(0),
+                base_(0),
+                scanned_(0),
+                retest_(std::numeric_limits<std::uint32_t>::max()),
+                page_(std::numeric_limits<std::uint32_t>::max()),
+                candidates_(0),
+                blocks_tested_(0)
+            {
+                next();
+            }
+
+            /// Walks rows of ARCHETYPES from ARCHETYPE, each backwards.
+            ///
+            /// Every entity in them has queried components, so no mask is tested.
+            iterator(EntityManager & entity_manager, const ArchetypeVector & archetypes, std::uint32_t archetype, const ChangeQuery * changes) :
+                entity_manager_(&entity_manager),
+                changes_(changes),
+                driver_(nullptr),
+                archetypes_(&archetypes),
+                archetype_(archetype),
+                index_(std::numeric_limits<std::uint32_t>::max()),
+                end_(0),
+                remaining_(0),
+                additions_(0),
+                matches_(0),
+                pending_(0),
+                base_(0),
+                scanned_(0),
+                retest_(std::numeric_limits<std::uint32_t>::max()),
+                page_(std::numeric_limits<std::uint32_t>::max()),
+                candidates_(0),
+                blocks_tested_(0)
             {
                 next();
             }
 
             void next()
             {
+                if (archetypes_)
+                {
+                    next_row();
+                    return;
+                }
+                if (!driver_)
+                {
+                    next_match();
+                    return;
+                }
+                std::uint32_t entity_index;
                 while (true)
                 {
-                    if (index_ == end_)
+                    index_ = std::min(index_, driver_->size());
+                    if (index_ == 0)
                     {
+                        index_ = std::numeric_limits<std::uint32_t>::max();
                         return;
                     }
-                    if (entity_manager_->alive(index_) && (entity_manager_->component_mask(index_) & component_mask_) == component_mask_)
+                    entity_index = driver_->index(index_ - 1);
+                    if (entity_manager_->alive(entity_index) && entity_manager_->matches(entity_index, query_) && changed(entity_index))
                     {
                         break;
                     }
-                    ++index_;
+                    --index_;
+                }
+                entity_handle_ = EntityHandle(*entity_manager_, entity_index, entity_manager_->version(entity_index));
+            }
+
+            /// Scans indices from INDEX in blocks of 64 entities tested at once, skipping blocks without queried components.
+            ///
+            /// Each entity found in a block is tested again, so removals made while iterating are seen.
+            void next_match()
+            {
+                if (index_ >= end_)
+                {
+                    index_ = std::numeric_limits<std::uint32_t>::max();
+                    return;
+                }
+                while (true)
+                {
+                    if (matches_ == 0 && retest_ < scanned_)
+                    {
+                        // entities after RETEST may match now, but those found before are already visited.
+                        auto matches = entity_manager_->match_block(base_, scanned_ - base_, query_);
+                        if (changes_ && matches != 0)
+                        {
+                            matches &= entity_manager_->changed_block(base_, scanned_ - base_, *changes_);
+                        }
+                        matches_ = matches & (~std::uint64_t(0) << (retest_ - base_)) & ~pending_;
+                        retest_ = std::numeric_limits<std::uint32_t>::max();
+                        ++blocks_tested_;
+                        continue;
+                    }
+                    if (matches_ == 0)
+                    {
+                        retest_ = std::numeric_limits<std::uint32_t>::max();
+                        index_ = std::max(index_, scanned_);
+                        auto size = std::min<std::uint32_t>(end_, static_cast<std::uint32_t>(entity_manager_->entity_versions_.size()));
+                        if (index_ < size)
+                        {
+                            index_ = std::max<std::uint64_t>(index_, std::uint64_t(next_block(index_ / 64)) * 64);
+                        }
+                        if (index_ >= size)
+                        {
+                            index_ = std::numeric_limits<std::uint32_t>::max();
+                            return;
+                        }
+                        auto count = std::min<std::uint32_t>((index_ / 64 + 1) * 64, size) - index_;
+                        matches_ = entity_manager_->match_block(index_, count, query_);
+                        if (changes_ && matches_ != 0)
+                        {
+                            matches_ &= entity_manager_->changed_block(index_, count, *changes_);
+                        }
+                        base_ = index_;
+                        scanned_ = index_ + count;
+                        ++blocks_tested_;
+                        continue;
+                    }
+                    auto entity_index = base_ + CountTrailingZeros(matches_);
+                    matches_ &= matches_ - 1;
+                    if (entity_manager_->alive(entity_index) && entity_manager_->matches(entity_index, query_) && changed(entity_index))
+                    {
+                        index_ = entity_index;
+                        entity_handle_ = EntityHandle(*entity_manager_, entity_index, entity_manager_->version(entity_index));
+                        return;
+                    }
+                }
+            }
+
+            /// Extends REMAINING by components added since the bound was taken, each of which may make one more entity match,
+            /// marks the current block to be tested again after the current entity, and forgets candidates of the page.
+            void extend()
+            {
+                auto additions = entity_manager_->additions();
+                if (additions == additions_)
+                {
+                    return;
+                }
+                remaining_ = static_cast<std::uint32_t>(std::min<std::uint64_t>(remaining_ + (additions - additions_), std::numeric_limits<std::uint32_t>::max()));
+                additions_ = additions;
+                if (retest_ == std::numeric_limits<std::uint32_t>::max())
+                {
+                    retest_ = index_ + 1;
+                    pending_ = matches_;
+                }
+                page_ = std::numeric_limits<std::uint32_t>::max();
+            }
+
+            /// Returns whether the entity indexed INDEX passes change filters of the query, if any.
+            bool changed(std::uint32_t index) const
+            {
+                return !changes_ || entity_manager_->changed(index, *changes_);
+            }
+
+            /// Returns the first candidate block from BLOCK, using candidates of the last page found while in it.
+            std::uint32_t next_block(std::uint32_t block)
+            {
+                auto candidates = block / 64 == page_ ? candidates_ & ~std::uint64_t(0) << (block % 64) : 0;
+                if (candidates != 0)
+                {
+                    return page_ * 64 + CountTrailingZeros(candidates);
+                }
+                block = entity_manager_->next_block(query_, block);
+                page_ = block / 64;
+                candidates_ = entity_manager_->candidate_blocks(query_, page_);
+                return block;
+            }
+
+            void next_row()
+            {
+                while (archetype_ != archetypes_->size())
+                {
+                    auto archetype = (*archetypes_)[archetype_];
+                    index_ = std::min(index_, archetype->size());
+                    if (index_ != 0)
+                    {
+                        // chunks not stamped since the tick are skipped whole.
+                        auto chunk = (index_ - 1) / archetype->chunk_capacity();
+                        if (changes_ && archetype->chunk_tick(chunk) <= changes_->since)
+                        {
+                            index_ = chunk * archetype->chunk_capacity();
+                            continue;
+                        }
+                        auto entity_index = archetype->entity(index_ - 1);
+                        if (!changed(entity_index))
+                        {
+                            --index_;
+                            continue;
+                        }
+                        entity_handle_ = EntityHandle(*entity_manager_, entity_index, entity_manager_->version(entity_index));
+                        return;
+                    }
+                    ++archetype_;
+                    index_ = std::numeric_limits<std::uint32_t>::max();
                 }
-                entity_handle_ = EntityHandle(*entity_manager_, index_, entity_manager_->version(index_));
+                archetype_ = 0;
             }
 
             EntityManager * entity_manager_;
-            ComponentMask component_mask_;
+            MaskQuery query_;
+            const ChangeQuery * changes_;
+            const SparseSet * driver_;
+            const ArchetypeVector * archetypes_;
+            std::uint32_t archetype_;
             std::uint32_t index_;
             std::uint32_t end_;
+            std::uint32_t remaining_;
+            std::uint64_t additions_;
+            std::uint64_t matches_;
+            std::uint64_t pending_; // matches of the block left when it was marked to be tested again
+            std::uint32_t base_;
+            std::uint32_t scanned_;
+            std::uint32_t retest_;
+            std::uint32_t page_;
+            std::uint64_t candidates_;
+            std::uint32_t blocks_tested_;
             EntityHandle entity_handle_;
         };
 
+        /// Plans the iteration on the world as it is now, so components added after making the view are found.
         iterator begin()
         {
-            return iterator(*entity_manager_, component_mask_, 0, entity_manager_->entity_versions_.size());
+            Plan();
+            if (use_archetypes_)
+            {
+                return iterator(*entity_manager_, archetypes_, 0, changes());
+            }
+            if (bound_ == 0)
+            {
+                return end();
+            }
+            if (driver_)
+            {
+                return iterator(*entity_manager_, query_, driver_, driver_->size(), 0, 0, changes());
+            }
+            return iterator(*entity_manager_, query_, nullptr, 0, entity_manager_->entity_versions_.size(), bound_, changes());
         }
 
         iterator end()
         {
-            return iterator(*entity_manager_, component_mask_, entity_manager_->entity_versions_.size(), entity_manager_->entity_versions_.size());
+            auto none = std::numeric_limits<std::uint32_t>::max();
+            return iterator(*entity_manager_, query_, nullptr, none, none, 0, changes());
         }
 
     private:
         friend World;
+        template <typename, typename, typename, typename, typename> friend struct Query;
+        template <typename, typename, typename> friend struct CachedQuery;
         using ComponentMask = EntityManager::ComponentMask;
 
-        View(EntityManager & entity_manager, const ComponentMask & component_mask) :
+        /// Finds entities having all components of COMPONENT_MASK and none of EXCLUDED_MASK.
+        View(EntityManager & entity_manager, const ComponentMask & component_mask, const ComponentMask & excluded_mask = ComponentMask()) :
             entity_manager_(&entity_manager),
-            component_mask_(component_mask)
+            component_mask_(component_mask),
+            excluded_mask_(excluded_mask),
+            query_(component_mask, excluded_mask),
+            driver_(nullptr),
+            bound_(std::numeric_limits<std::uint32_t>::max()),
+            // entities without components are in no archetype, so only the empty query scans.
+            use_archetypes_(entity_manager.archetypes() && component_mask.any()),
+            cached_(false)
         {
         }
 
+        /// Walks indices in MATCHES of a cached query, which are all alive and matching.
+        View(EntityManager & entity_manager, const SparseSet & matches) :
+            entity_manager_(&entity_manager),
+            driver_(&matches),
+            bound_(std::numeric_limits<std::uint32_t>::max()),
+            use_archetypes_(false),
+            cached_(true)
+        {}
+
+        /// Returns change filters of the query, or nullptr when there are none.
+        const ChangeQuery * changes() const
+        {
+            return changes_.empty() ? nullptr : &changes_;
+        }
+
+        /// Chooses how to find entities with queried components, from the world as it is now.
+        ///
+        /// In the archetype backend, archetypes having queried components are collected.
+        /// Otherwise the smallest owner set among queried components drives the iteration when a pool tracks owners,
+        /// or indices are scanned until as many entities as the rarest component has are found.
+        /// Called each time iteration starts, as pools and archetypes are made when components are first added.
+        void Plan()
+        {
+            if (cached_)
+            {
+                return;
+            }
+            if (use_archetypes_)
+            {
+                archetypes_.clear();
+                for (auto archetype : entity_manager_->archetypes()->archetypes())
+                {
+                    if ((archetype->mask() & component_mask_) == component_mask_ && (archetype->mask() & excluded_mask_).none())
+                    {
+                        archetypes_.push_back(archetype);
+                    }
+                }
+                return;
+            }
+            driver_ = nullptr;
+            bound_ = std::numeric_limits<std::uint32_t>::max();
+            for (std::uint16_t i = 0; i < MAX_COMPONENTS; i++)
+            {
+                if (!component_mask_[i])
+                {
+                    continue;
+                }
+                bound_ = std::min(bound_, entity_manager_->count(i));
+                auto owners = entity_manager_->owners(i);
+                if (owners && (!driver_ || owners->size() < driver_->size()))
+                {
+                    driver_ = owners;
+                }
+            }
+        }
+
         EntityManager * entity_manager_;
         ComponentMask component_mask_;
+        ComponentMask excluded_mask_;
+        MaskQuery query_;
+        ChangeQuery changes_;
+        const SparseSet * driver_;
+        std::uint32_t bound_;
+        bool use_archetypes_;
+        bool cached_;
+        std::vector<Archetype*> archetypes_;
     };
 }
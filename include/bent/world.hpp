@@ -2,19 +2,102 @@
 
 #include <bitset>
 #include <string>
+#include <initializer_list>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include <memory>
+#include <cstdio>
+#include <stdexcept>
 
 #include "internal/definitions.hpp"
 #include "internal/entity_manager.hpp"
+#include "internal/component_accessor.hpp"
+#include "internal/thread_pool.hpp"
+#include "command_buffer.hpp"
 #include "entity_handle.hpp"
 #include "view.hpp"
+#include "query.hpp"
 
 namespace bent
 {
     struct EntityHandle;
     struct View;
+    struct Scheduler;
+    template <typename... Ts> struct Group;
 
     struct World
     {
+        /// Creates a world storing components in BACKEND and evaluating queries over masks in LAYOUT.
+        explicit World(StorageBackend backend = StorageBackend::ComponentPools, MaskLayout layout = MaskLayout::Rows) :
+            entity_manager_(backend, layout)
+        {}
+
+        /// Returns a world with the same entities and components as this one, changing independently of it.
+        ///
+        /// Blocks of trivially copyable components in `ComponentPool`s are shared by both worlds,
+        /// and copied by either when a component in them is first accessed mutably, including by `each` and queries.
+        /// Other components are copied now, and so are entity tables, cached queries and groups.
+        /// Entity ids are the same in both worlds; get handles of the fork by `entity`. Observers aren't carried over.
+        /// Throws `std::logic_error` while structural changes are forbidden, e.g. in `parallel_each`.
+        std::unique_ptr<World> Fork()
+        {
+            std::unique_ptr<World> fork(new World(entity_manager_.archetypes() ? StorageBackend::Archetypes : StorageBackend::ComponentPools,
+                entity_manager_.layout()));
+            entity_manager_.ForkInto(fork->entity_manager_);
+            return fork;
+        }
+
+        /// Writes entities and components of this world to a file at PATH, which `LoadSnapshot` restores.
+        ///
+        /// Blocks of trivially copyable components in `ComponentPool`s are written as they are, aligned, so loading maps them in place.
+        /// Other trivially copyable components are written as their bytes, and the rest by serializers. See `RegisterSerializer`.
+        /// The file is written beside PATH, synced and renamed to it when complete, so a crash while saving leaves the previous snapshot.
+        /// Renaming replaces a previous snapshot atomically where `rename` does so, as on POSIX systems.
+        /// Components are identified by names, so all of them must be registered by `RegisterComponent`.
+        /// Throws `std::logic_error` in the archetype backend, when a component has no name or can't be saved,
+        /// or while structural changes are forbidden, and `std::runtime_error` when the file can't be written.
+        void SaveSnapshot(const std::string & path)
+        {
+            auto temporary = path + ".tmp";
+            try
+            {
+                SnapshotWriter writer(temporary);
+                entity_manager_.Save(writer);
+                writer.Close();
+            }
+            catch (...)
+            {
+                std::remove(temporary.c_str());
+                throw;
+            }
+            if (std::rename(temporary.c_str(), path.c_str()) != 0)
+            {
+                std::remove(temporary.c_str());
+                throw std::runtime_error("can't write a snapshot to `" + path + "`");
+            }
+        }
+
+        /// Loads entities and components from a snapshot at PATH that `SaveSnapshot` wrote into this world, which must never have had entities.
+        ///
+        /// The file is mapped into memory, and blocks saved from `ComponentPool`s of trivially copyable components are used in place,
+        /// so loading costs little more than setting component masks of entities; the file stays mapped until all of them are released.
+        /// Pages are copied as they are first written, and the file is never changed.
+        /// Other components are copied or loaded by serializers. Entities keep their ids.
+        /// The tick is raised to the one the world was saved at, when behind, and tracked components count as added at it.
+        /// Observers are notified of components added.
+        /// Throws `std::logic_error` in the archetype backend or when this world has had entities,
+        /// `std::out_of_range` when a component in the file isn't registered by its name,
+        /// and `std::runtime_error` when the file can't be read, isn't a snapshot or doesn't match the components.
+        /// The file is checked before loading, so this world is left empty then. Exceptions of serializers are rethrown,
+        /// after entities loaded so far are destroyed without notifying observers, so this world is left empty too.
+        void LoadSnapshot(const std::string & path)
+        {
+            SnapshotReader reader(std::make_shared<SnapshotFile>(path));
+            entity_manager_.Load(reader);
+        }
+
         /// Creates an entity.
         ///
         /// @return entity handle refering created entity.
@@ -24,6 +107,68 @@ namespace bent
             return EntityHandle(entity_manager_, res.first, res.second);
         }
 
+        /// Creates COUNT entities at once and writes their handles to OUT.
+        ///
+        /// @return OUT advanced past the last handle written.
+        template <typename OutputIterator>
+        OutputIterator Create(std::size_t count, OutputIterator out)
+        {
+            auto & entity_manager = entity_manager_;
+            entity_manager_.CreateEntities(count, [&](std::uint32_t index, std::uint32_t version)
+            {
+                *out++ = EntityHandle(entity_manager, index, version);
+            });
+            return out;
+        }
+
+        /// Reserves memory for COUNT entities in total, and for their components Ts.
+        ///
+        /// Creating entities and adding components Ts up to COUNT entities allocates no more memory.
+        template <typename... Ts>
+        void Reserve(std::size_t count)
+        {
+            ComponentMask component_mask;
+            for (auto& i : std::initializer_list<std::uint16_t> { ComponentManager::instance().id<Ts>()... })
+            {
+                component_mask[i] = true;
+            }
+            entity_manager_.Reserve(count, component_mask);
+        }
+
+        /// Reserves memory for COUNT entities in total, and for their components by names.
+        void Reserve(std::size_t count, int argc, const char * argv [])
+        {
+            ComponentMask component_mask;
+            for (auto i = 0; i < argc; ++i)
+            {
+                component_mask[ComponentManager::instance().id(argv[i])] = true;
+            }
+            entity_manager_.Reserve(count, component_mask);
+        }
+
+        /// Destroys ENTITIES, a container of entity handles, at once.
+        ///
+        /// Components are destructed per component type, and destructors of trivially destructible ones are skipped.
+        /// When any handle is invalid, throws logic_error exception and destroys none.
+        template <typename Entities>
+        void Destroy(const Entities & entities)
+        {
+            std::vector<std::uint32_t> indices;
+            for (auto & entity : entities)
+            {
+                const EntityHandle & handle = entity;
+                handle.ThrowsIfInvalid();
+                indices.push_back(handle.index_);
+            }
+            // sorted indices visit pools in address order; handles are often created in order already.
+            if (!std::is_sorted(indices.begin(), indices.end()))
+            {
+                std::sort(indices.begin(), indices.end());
+            }
+            indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+            entity_manager_.DestroyEntities(indices);
+        }
+
         /// Gets an entity handle.
         ///
         /// @return entity handle that found.
@@ -46,13 +191,7 @@ namespace bent
         template <typename... Args>
         View entities_with()
         {
-            ComponentMask component_mask;
-            for (auto& i : std::initializer_list<std::uint16_t> { ComponentManager::instance().id<Args>()... })
-            {
-                component_mask[i] = true;
-            }
-
-            return entities_with(component_mask);
+            return entities_with(mask_of<Args...>());
         }
 
         /// Returns a view with entities that have components requried by names.
@@ -67,16 +206,1008 @@ namespace bent
             return entities_with(component_mask);
         }
 
+        /// Returns the tick additions and changes of tracked components are stamped with now.
+        std::uint32_t change_tick() const
+        {
+            return entity_manager_.change_tick();
+        }
+
+        /// Advances the tick, returning the one before it.
+        ///
+        /// A system passes the tick returned at the end of its last run to `query` as SINCE,
+        /// so it finds changes made since then except ones it made itself.
+        std::uint32_t Tick()
+        {
+            return entity_manager_.Tick();
+        }
+
+        /// Returns the number of entities that have components Ts.
+        template <typename... Ts>
+        std::size_t count()
+        {
+            return entity_manager_.count_matches(MaskQuery(mask_of<Ts...>()));
+        }
+
+        /// Returns a query of entities by `With`, `Without` and `Optional` TERMS, e.g. `query<With<A, B>, Without<C>, Optional<D>>()`.
+        ///
+        /// Required and excluded components are tested together when matching component masks,
+        /// so excluding components costs nothing per entity over requiring them.
+        /// `Added` and `Changed` TERMS match entities whose components were added or changed after tick SINCE,
+        /// skipping whole blocks of 64 entities that weren't. See `Tick`.
+        template <typename... Terms>
+        QueryOf<Terms...> query(std::uint32_t since = 0)
+        {
+            return QueryOf<Terms...>(*this, since);
+        }
+
+        /// Returns a query like `query`, whose matching entity indices are kept in a dense array.
+        ///
+        /// The array is built on the first call for the terms, then updated whenever an entity starts or stops matching,
+        /// so iterating is a linear walk however many other entities there are.
+        /// It lives as long as the world and slows down adding and removing components it tests, so cache queries run often.
+        template <typename... Terms>
+        CachedQueryOf<Terms...> cached_query()
+        {
+            static_assert(std::is_same<typename TermOf<Added, Terms...>::type, Added<>>::value &&
+                std::is_same<typename TermOf<Changed, Terms...>::type, Changed<>>::value, "Cached queries can't filter changes");
+            return CachedQueryOf<Terms...>(*this);
+        }
+
+        /// Returns the group owning components Ts, which keeps entities having all of them at the front of their pools in the same order.
+        ///
+        /// Each of Ts must be stored in `PackedComponentPool`, and may be owned by one group only;
+        /// otherwise throws `std::logic_error`. The group lives as long as the world.
+        /// Adding or removing Ts swaps entities into or out of the group.
+        /// In the archetype backend, chunks keep components of entities in lockstep already, so nothing is owned.
+        template <typename... Ts>
+        Group<Ts...> group()
+        {
+            if (entity_manager_.archetypes())
+            {
+                return Group<Ts...>(*this, nullptr);
+            }
+            auto & manager = ComponentManager::instance();
+            return Group<Ts...>(*this, &entity_manager_.Own({ std::make_pair(manager.id<Ts>(), &swap_positions<Ts>)... }));
+        }
+
+        /// Reorders components T in their packed pool so that COMPARE, called as `compare(const T&, const T&)`, holds between neighbours.
+        ///
+        /// `each` visits entities of a query in the order of the packed component with the fewest owners,
+        /// so the query of T comes out sorted and walks its memory sequentially; views walk it in reverse.
+        /// The order holds until components T are added or removed.
+        /// When a group owns T, entities in the group and the others are sorted separately, and pools of the group follow.
+        /// T must be stored in `PackedComponentPool`; throws `std::logic_error` in the archetype backend.
+        template <typename T, typename Compare>
+        void sort(Compare compare, SortAlgorithm algorithm = SortAlgorithm::Standard)
+        {
+            auto pool = packed_pool_of<T>();
+            if (!pool)
+            {
+                return;
+            }
+            auto component_index = ComponentManager::instance().id<T>();
+            std::vector<std::uint32_t> order(pool->owners()->size());
+            for (std::uint32_t position = 0; position < order.size(); position++)
+            {
+                order[position] = position;
+            }
+            auto less = [&](std::uint32_t lhs, std::uint32_t rhs)
+            {
+                return compare(static_cast<const T&>(pool->at(lhs)), static_cast<const T&>(pool->at(rhs)));
+            };
+            auto grouped = order.begin() + entity_manager_.grouped_count(component_index);
+            sort_positions(order.begin(), grouped, less, algorithm);
+            sort_positions(grouped, order.end(), less, algorithm);
+            entity_manager_.Arrange(component_index, &swap_positions<T>, order);
+        }
+
+        /// Reorders components U in their packed pool to follow the order of components T of the same entities.
+        ///
+        /// Entities without T come after those with it, in their current order.
+        /// When a group owns U, entities in the group still come first.
+        /// Both must be stored in `PackedComponentPool`; throws `std::logic_error` in the archetype backend.
+        template <typename T, typename U>
+        void sort()
+        {
+            auto leader_pool = packed_pool_of<T>();
+            auto pool = packed_pool_of<U>();
+            if (!leader_pool || !pool)
+            {
+                return;
+            }
+            auto leader = leader_pool->owners();
+            auto & owners = *pool->owners();
+            auto component_index = ComponentManager::instance().id<U>();
+            std::vector<std::uint32_t> order;
+            order.reserve(owners.size());
+            std::vector<bool> placed(owners.size());
+            for (std::uint32_t position = 0; position < leader->size(); position++)
+            {
+                auto index = leader->index(position);
+                if (owners.contains(index))
+                {
+                    order.push_back(owners.position(index));
+                    placed[order.back()] = true;
+                }
+            }
+            for (std::uint32_t position = 0; position < owners.size(); position++)
+            {
+                if (!placed[position])
+                {
+                    order.push_back(position);
+                }
+            }
+            auto grouped = entity_manager_.grouped_count(component_index);
+            if (grouped != 0)
+            {
+                std::stable_partition(order.begin(), order.end(), [&](std::uint32_t position)
+                {
+                    return position < grouped;
+                });
+            }
+            entity_manager_.Arrange(component_index, &swap_positions<U>, order);
+        }
+
+        /// Calls FN with each entity that has components Ts and references to them.
+        ///
+        /// FN is called as `fn(EntityHandle, Ts&...)`.
+        /// Pools of Ts are resolved once per call, so components are accessed without looking them up per entity.
+        /// Components whose changes are tracked are marked changed for each entity, as by `EntityHandle::Get`.
+        /// FN must not add or remove components, nor create or destroy entities.
+        template <typename... Ts, typename F>
+        void each(F fn)
+        {
+            auto view = entities_with<Ts...>();
+            auto & manager = ComponentManager::instance();
+            if (view.use_archetypes_)
+            {
+                each_in_archetypes(view, fn, ComponentAccessor<Ts>(manager.id<Ts>(), nullptr)...);
+            }
+            else
+            {
+                each_in_view(view, fn, ComponentAccessor<Ts>(manager.id<Ts>(), pool_of(manager.id<Ts>()))...);
+            }
+        }
+
+        /// Calls FN with each entity that has components Ts and references to them, in parallel.
+        ///
+        /// Entities are split into tasks of about GRAIN entities run by `ThreadPool::instance()`.
+        /// A task covers whole blocks of component pools, or whole chunks in the archetype backend.
+        /// When GRAIN is 0, it is chosen to make a few tasks per thread.
+        /// FN must be safe to call concurrently for different entities.
+        /// Creating or destroying entities and adding or removing components throw `std::logic_error` until this returns.
+        template <typename... Ts, typename F>
+        void parallel_each(F fn, std::uint32_t grain = 0)
+        {
+            auto view = entities_with<Ts...>();
+            auto & manager = ComponentManager::instance();
+            auto & thread_pool = ThreadPool::instance();
+            StructureLock lock(entity_manager_);
+            if (view.use_archetypes_)
+            {
+                parallel_in_archetypes(thread_pool, view, fn, ComponentAccessor<Ts>(manager.id<Ts>(), nullptr)...);
+            }
+            else
+            {
+                parallel_in_view(thread_pool, view, fn, grain, ComponentAccessor<Ts>(manager.id<Ts>(), pool_of(manager.id<Ts>()))...);
+            }
+        }
+
+        /// Applies commands recorded in BUFFER and clears it.
+        void Flush(CommandBuffer & buffer)
+        {
+            std::vector<CommandBuffer*> buffers { &buffer };
+            Apply(buffers);
+        }
+
+        /// Applies commands recorded in BUFFERS and clears them.
+        ///
+        /// Entities are created first, in the order of buffers.
+        /// Then components are added, replaced and removed grouped by component type and entity index,
+        /// in the order recorded for the same component of the same entity.
+        /// Entities are destroyed last, and then observers are notified of events of components. See `Observe`.
+        /// Commands on entities already destroyed are ignored, and so is removing a component an entity doesn't have.
+        /// Adding a component an entity already has throws `std::out_of_range`, discarding commands not applied yet.
+        /// An entity created by a buffer must not be used with another; when it's beyond those the other created,
+        /// `std::invalid_argument` is thrown before anything is applied, discarding all commands.
+        template <typename Buffers>
+        void Flush(Buffers & buffers)
+        {
+            std::vector<CommandBuffer*> pointers;
+            for (auto & buffer : buffers)
+            {
+                pointers.push_back(pointer_of(buffer));
+            }
+            Apply(pointers);
+        }
+
+        /// Called with ids of entities, as `EntityHandle::id` gives, that an observed event happened to.
+        using Observer = EntityManager::Observer;
+
+        /// Registers OBSERVER of EVENT for components T, e.g. to keep an external index of entities having T.
+        ///
+        /// Events are queued as components are added and removed and entities destroyed,
+        /// and delivered in spans of entity ids by `NotifyObservers`, so indices can be updated in bulk.
+        /// When EVENT is `ComponentEvent::Remove` or `Destroy`, the components are already gone.
+        template <typename T>
+        void Observe(ComponentEvent event, Observer observer)
+        {
+            entity_manager_.Observe(ComponentManager::instance().id<T>(), event, std::move(observer));
+        }
+
+        /// Registers OBSERVER of EVENT for components named COMPONENT_NAME like `Observe<T>`.
+        void Observe(const std::string & component_name, ComponentEvent event, Observer observer)
+        {
+            entity_manager_.Observe(ComponentManager::instance().id(component_name), event, std::move(observer));
+        }
+
+        /// Delivers events queued since the last call to observers.
+        ///
+        /// Consecutive events of the same kind on a component type come in one span, in the order they happened.
+        /// `Flush` and `Scheduler::Run` call this when done. Observers may change the world; their events are delivered next time.
+        void NotifyObservers()
+        {
+            entity_manager_.Notify();
+        }
+
     private:
+        friend Scheduler;
+        template <typename, typename, typename, typename, typename> friend struct Query;
+        template <typename, typename, typename> friend struct CachedQuery;
+        template <typename...> friend struct Group;
+
+        static CommandBuffer * pointer_of(CommandBuffer & buffer)
+        {
+            return &buffer;
+        }
+
+        static CommandBuffer * pointer_of(CommandBuffer * buffer)
+        {
+            return buffer;
+        }
+
+        void Apply(std::vector<CommandBuffer*> & buffers)
+        {
+            using Command = CommandBuffer::Command;
+
+            // clears buffers even when a command throws, destructing components not moved yet.
+            struct Clearer
+            {
+                ~Clearer()
+                {
+                    for (auto buffer : buffers)
+                    {
+                        buffer->Clear();
+                    }
+                }
+                std::vector<CommandBuffer*> & buffers;
+            } clearer { buffers };
+
+            // a spawned handle is only meaningful in the buffer that created it.
+            for (auto buffer : buffers)
+            {
+                for (auto & command : buffer->commands_)
+                {
+                    if (command.target.spawned && command.target.index >= buffer->spawned_)
+                    {
+                        throw std::invalid_argument("entity created by another command buffer");
+                    }
+                }
+            }
+
+            std::vector<std::vector<std::uint32_t>> spawned(buffers.size());
+            for (std::size_t i = 0; i < buffers.size(); i++)
+            {
+                auto & indices = spawned[i];
+                indices.reserve(buffers[i]->spawned_);
+                entity_manager_.CreateEntities(buffers[i]->spawned_, [&](std::uint32_t index, std::uint32_t)
+                {
+                    indices.push_back(index);
+                });
+            }
+
+            auto resolve = [&](std::size_t buffer, const CommandBuffer::Target & target, std::uint32_t & index)
+            {
+                index = target.spawned ? spawned[buffer][target.index] : target.index;
+                return index < entity_manager_.entity_versions_.size() && entity_manager_.alive(index)
+                    && (target.spawned || entity_manager_.version(index) == target.version);
+            };
+
+            struct Change
+            {
+                std::uint16_t component_index;
+                std::uint32_t index;
+                std::uint32_t order;
+                Command * command;
+            };
+            std::vector<Change> changes;
+            for (std::size_t i = 0; i < buffers.size(); i++)
+            {
+                for (auto & command : buffers[i]->commands_)
+                {
+                    std::uint32_t index;
+                    if (command.type != CommandBuffer::CREATE && command.type != CommandBuffer::DESTROY && resolve(i, command.target, index))
+                    {
+                        Change change = { command.component_index, index, static_cast<std::uint32_t>(changes.size()), &command };
+                        changes.push_back(change);
+                    }
+                }
+            }
+            std::sort(changes.begin(), changes.end(), [](const Change & lhs, const Change & rhs)
+            {
+                if (lhs.component_index != rhs.component_index)
+                {
+                    return lhs.component_index < rhs.component_index;
+                }
+                if (lhs.index != rhs.index)
+                {
+                    return lhs.index < rhs.index;
+                }
+                return lhs.order < rhs.order;
+            });
+
+            auto & manager = ComponentManager::instance();
+            for (auto & change : changes)
+            {
+                auto & command = *change.command;
+                auto has = entity_manager_.has_component(change.index, change.component_index);
+                if (command.type == CommandBuffer::REMOVE)
+                {
+                    if (has)
+                    {
+                        entity_manager_.RemoveComponent(change.index, change.component_index);
+                    }
+                    continue;
+                }
+                if (command.type == CommandBuffer::REPLACE && has)
+                {
+                    entity_manager_.RemoveComponent(change.index, change.component_index);
+                }
+                entity_manager_.AddComponentFromMove(change.index, change.component_index, command.payload);
+                manager.dynamic_constructor(change.component_index).Destroy(command.payload);
+                command.payload = nullptr;
+            }
+
+            for (std::size_t i = 0; i < buffers.size(); i++)
+            {
+                for (auto & command : buffers[i]->commands_)
+                {
+                    std::uint32_t index;
+                    if (command.type == CommandBuffer::DESTROY && resolve(i, command.target, index))
+                    {
+                        entity_manager_.DestroyEntity(index);
+                    }
+                }
+            }
+            entity_manager_.Notify();
+        }
 
         using ComponentMask = EntityManager::ComponentMask;
 
-        /// Returns a view with entities that have components requried by bit mask.
-        View entities_with(const ComponentMask & component_mask)
+        /// Forbids structural changes of the world while alive.
+        struct StructureLock
+        {
+            explicit StructureLock(EntityManager & entity_manager) :
+                entity_manager_(entity_manager)
+            {
+                entity_manager_.Lock();
+            }
+
+            ~StructureLock()
+            {
+                entity_manager_.Unlock();
+            }
+
+            EntityManager & entity_manager_;
+        };
+
+        static std::uint32_t grain_of(const ThreadPool & thread_pool, std::uint32_t count, std::uint32_t grain, std::size_t alignment)
+        {
+            if (grain == 0)
+            {
+                grain = static_cast<std::uint32_t>(count / (thread_pool.concurrency() * 4) + 1);
+            }
+            return static_cast<std::uint32_t>((grain + alignment - 1) / alignment * alignment);
+        }
+
+        template <typename F, typename... Accessors>
+        void parallel_in_view(ThreadPool & thread_pool, View & view, F & fn, std::uint32_t grain, Accessors... accessors)
+        {
+            view.Plan();
+            if (view.bound_ == 0)
+            {
+                return;
+            }
+            auto & query = view.query_;
+            auto changes = view.changes();
+            auto driver = view.driver_;
+            if (driver)
+            {
+                // owners are packed, so tasks are aligned to cache lines of their indices.
+                auto count = driver->size();
+                grain = grain_of(thread_pool, count, grain, 16);
+                thread_pool.Run((count + grain - 1) / grain, [&](std::uint32_t task)
+                {
+                    auto last = std::min(count, (task + 1) * grain);
+                    for (auto position = task * grain; position < last; position++)
+                    {
+                        auto index = driver->index(position);
+                        if (entity_manager_.matches(index, query) && changed(index, changes))
+                        {
+                            mark_changed(index, accessors...);
+                            fn(EntityHandle(entity_manager_, index, entity_manager_.version(index)), accessors(index)...);
+                        }
+                    }
+                });
+                return;
+            }
+
+            auto count = static_cast<std::uint32_t>(entity_manager_.entity_versions_.size());
+            std::size_t alignment = 1;
+            (void) std::initializer_list<int> { (alignment = std::max(alignment, accessors.block_size()), 0)... };
+            grain = grain_of(thread_pool, count, grain, alignment);
+            thread_pool.Run((count + grain - 1) / grain, [&](std::uint32_t task)
+            {
+                auto last = static_cast<std::uint32_t>(std::min<std::uint64_t>(count, std::uint64_t(task + 1) * grain));
+                each_match(query, changes, task * grain, last, [&](std::uint32_t index)
+                {
+                    mark_changed(index, accessors...);
+                    fn(EntityHandle(entity_manager_, index, entity_manager_.version(index)), accessors(index)...);
+                });
+            });
+        }
+
+        template <typename F, typename... Accessors>
+        void parallel_in_archetypes(ThreadPool & thread_pool, View & view, F & fn, Accessors... accessors)
+        {
+            view.Plan();
+            std::vector<std::pair<Archetype*, std::uint32_t>> chunks;
+            for (auto archetype : view.archetypes_)
+            {
+                for (std::uint32_t chunk = 0; chunk < archetype->chunk_count(); chunk++)
+                {
+                    chunks.emplace_back(archetype, chunk);
+                }
+            }
+            thread_pool.Run(static_cast<std::uint32_t>(chunks.size()), [&](std::uint32_t task)
+            {
+                each_in_chunk(*chunks[task].first, chunks[task].second, view.changes(), fn, accessors...);
+            });
+        }
+
+        /// Returns the pool of the component, or nullptr for tags, archetypes and components no entity has had, which no entity has now.
+        ///
+        /// Pools aren't created here, so concurrent systems may iterate.
+        ComponentPoolInterface * pool_of(std::uint16_t component_index)
+        {
+            return entity_manager_.find_component_pool(component_index);
+        }
+
+        template <typename F, typename... Accessors>
+        void each_in_view(View & view, F & fn, Accessors... accessors)
+        {
+            view.Plan();
+            if (view.bound_ == 0)
+            {
+                return;
+            }
+            if (view.driver_)
+            {
+                // FN doesn't change structure, so owners are walked forwards, in the order they are sorted in.
+                // Cached indices all match without testing masks.
+                auto indices = view.driver_->data();
+                for (std::uint32_t position = 0, size = view.driver_->size(); position < size; position++)
+                {
+                    auto index = indices[position];
+                    if ((view.cached_ || entity_manager_.matches(index, view.query_)) && changed(index, view.changes()))
+                    {
+                        mark_changed(index, accessors...);
+                        fn(EntityHandle(entity_manager_, index, entity_manager_.version(index)), accessors(index)...);
+                    }
+                }
+                return;
+            }
+            // FN doesn't change structure, so matches of a block are used without testing them again.
+            each_match(view.query_, view.changes(), 0, static_cast<std::uint32_t>(entity_manager_.entity_versions_.size()), [&](std::uint32_t index)
+            {
+                mark_changed(index, accessors...);
+                fn(EntityHandle(entity_manager_, index, entity_manager_.version(index)), accessors(index)...);
+            });
+        }
+
+        /// Calls FN with the index of each alive entity from FIRST to LAST - 1 matching QUERY and passing CHANGES, if any.
+        ///
+        /// Pages of 4096 entities and blocks of 64 entities are found by occupancy summaries, and each block is tested at once.
+        template <typename F>
+        void each_match(const MaskQuery & query, const ChangeQuery * changes, std::uint32_t first, std::uint32_t last, F fn)
+        {
+            if (first >= last)
+            {
+                return;
+            }
+            auto first_block = first / 64;
+            auto last_block = (last - 1) / 64;
+            for (auto page = first_block / 64; page <= last_block / 64; page++)
+            {
+                auto pages = entity_manager_.candidate_pages(query, page / 64) & ~std::uint64_t(0) << (page % 64);
+                if (pages == 0)
+                {
+                    page = page / 64 * 64 + 63;
+                    continue;
+                }
+                page = page / 64 * 64 + CountTrailingZeros(pages);
+                if (page > last_block / 64)
+                {
+                    return;
+                }
+                auto blocks = entity_manager_.candidate_blocks(query, page);
+                if (page == first_block / 64)
+                {
+                    blocks &= ~std::uint64_t(0) << (first_block % 64);
+                }
+                if (page == last_block / 64)
+                {
+                    blocks &= ~std::uint64_t(0) >> (63 - last_block % 64);
+                }
+                for (; blocks != 0; blocks &= blocks - 1)
+                {
+                    auto block = page * 64 + CountTrailingZeros(blocks);
+                    auto begin = std::max(block * 64, first);
+                    auto end = static_cast<std::uint32_t>(std::min<std::uint64_t>(std::uint64_t(block) * 64 + 64, last));
+                    auto matches = entity_manager_.match_block(begin, end - begin, query);
+                    if (changes && matches != 0)
+                    {
+                        matches &= entity_manager_.changed_block(begin, end - begin, *changes);
+                    }
+                    for (; matches != 0; matches &= matches - 1)
+                    {
+                        fn(begin + CountTrailingZeros(matches));
+                    }
+                }
+            }
+        }
+
+        template <typename F, typename... Accessors>
+        void each_in_archetypes(View & view, F & fn, Accessors... accessors)
+        {
+            view.Plan();
+            for (auto archetype : view.archetypes_)
+            {
+                for (std::uint32_t chunk = 0; chunk < archetype->chunk_count(); chunk++)
+                {
+                    each_in_chunk(*archetype, chunk, view.changes(), fn, accessors...);
+                }
+            }
+        }
+
+        template <typename F, typename... Accessors>
+        void each_in_chunk(Archetype & archetype, std::uint32_t chunk, const ChangeQuery * changes, F & fn, Accessors... accessors)
+        {
+            if (changes && archetype.chunk_tick(chunk) <= changes->since)
+            {
+                return;
+            }
+            (void) std::initializer_list<int> { (accessors.Bind(archetype, chunk), 0)... };
+            auto entities = archetype.entities(chunk);
+            auto rows = archetype.chunk_rows(chunk);
+            for (std::uint32_t row = 0; row < rows; row++)
+            {
+                auto index = entities[row];
+                if (changed(index, changes))
+                {
+                    mark_changed(index, accessors...);
+                    fn(EntityHandle(entity_manager_, index, entity_manager_.version(index)), accessors[row]...);
+                }
+            }
+        }
+
+        /// Marks components ACCESSORS hand out by reference changed on the entity indexed INDEX, for those whose changes are tracked.
+        template <typename... Accessors>
+        void mark_changed(std::uint32_t index, const Accessors &... accessors)
+        {
+            (void) std::initializer_list<int> { (accessors.Mark(entity_manager_, index), 0)... };
+        }
+
+        /// Returns whether the entity indexed INDEX passes CHANGES, or true when there are no change filters.
+        bool changed(std::uint32_t index, const ChangeQuery * changes) const
+        {
+            return !changes || entity_manager_.changed(index, *changes);
+        }
+
+        /// Returns a view with entities that have components requried by bit mask and none of EXCLUDED_MASK.
+        View entities_with(const ComponentMask & component_mask, const ComponentMask & excluded_mask = ComponentMask())
+        {
+            return View(entity_manager_, component_mask, excluded_mask);
+        }
+
+        template <typename... Ts>
+        static ComponentMask mask_of()
+        {
+            ComponentMask component_mask;
+            for (auto& i : std::initializer_list<std::uint16_t> { ComponentManager::instance().id<Ts>()... })
+            {
+                component_mask[i] = true;
+            }
+            return component_mask;
+        }
+
+        template <typename T>
+        static void swap_positions(ComponentPoolInterface & pool, std::uint32_t lhs, std::uint32_t rhs)
+        {
+            static_assert(std::is_same<typename ComponentStorage<T>::type, PackedComponentPool<T>>::value, "Only components stored in PackedComponentPool can be grouped or sorted");
+            static_cast<PackedComponentPool<T>&>(pool).Swap(lhs, rhs);
+        }
+
+        /// Returns the packed pool of T, or nullptr when no entity has had T.
+        template <typename T>
+        PackedComponentPool<T> * packed_pool_of()
+        {
+            static_assert(std::is_same<typename ComponentStorage<T>::type, PackedComponentPool<T>>::value, "Only components stored in PackedComponentPool can be grouped or sorted");
+            if (entity_manager_.archetypes())
+            {
+                throw std::logic_error("Components stored in archetypes can't be sorted");
+            }
+            return static_cast<PackedComponentPool<T>*>(pool_of(ComponentManager::instance().id<T>()));
+        }
+
+        template <typename Iterator, typename Less>
+        static void sort_positions(Iterator first, Iterator last, Less less, SortAlgorithm algorithm)
+        {
+            if (algorithm == SortAlgorithm::Standard)
+            {
+                std::sort(first, last, less);
+                return;
+            }
+            for (auto i = first; i != last; ++i)
+            {
+                auto position = *i;
+                auto j = i;
+                for (; j != first && less(position, *(j - 1)); --j)
+                {
+                    *j = *(j - 1);
+                }
+                *j = position;
+            }
+        }
+
+        /// Looks components of type T up per entity, which must have them.
+        template <typename T>
+        struct LookupAccessor
+        {
+            std::size_t block_size() const
+            {
+                return 1;
+            }
+
+            T & operator()(std::uint32_t index) const
+            {
+                return *static_cast<T*>(entity_manager->GetComponent(index, component_index));
+            }
+
+            void Mark(EntityManager & manager, std::uint32_t index) const
+            {
+                if (ChangesTracked<T>::value)
+                {
+                    manager.MarkChanged(index, component_index);
+                }
+            }
+
+            EntityManager * entity_manager;
+            std::uint16_t component_index;
+        };
+
+        /// Looks components of type T up per entity, as nullptr for entities lacking them.
+        template <typename T>
+        struct OptionalLookupAccessor
+        {
+            std::size_t block_size() const
+            {
+                return 1;
+            }
+
+            T * operator()(std::uint32_t index) const
+            {
+                return static_cast<T*>(entity_manager->GetComponent(index, component_index));
+            }
+
+            void Mark(EntityManager & manager, std::uint32_t index) const
+            {
+                if (ChangesTracked<T>::value && manager.has_component(index, component_index))
+                {
+                    manager.MarkChanged(index, component_index);
+                }
+            }
+
+            EntityManager * entity_manager;
+            std::uint16_t component_index;
+        };
+
+        /// Calls FN as `fn(EntityHandle, Ws&..., Os*...)` with each entity of VIEW.
+        template <typename F, typename... Ws, typename... Os>
+        void each_in_query(View & view, F & fn, With<Ws...>, Optional<Os...>)
+        {
+            auto & manager = ComponentManager::instance();
+            auto & masks = entity_manager_.entity_component_masks_;
+            if (view.use_archetypes_)
+            {
+                each_in_archetypes(view, fn, ComponentAccessor<Ws>(manager.id<Ws>(), nullptr)...,
+                    OptionalComponentAccessor<Os>(manager.id<Os>(), nullptr, masks)...);
+            }
+            else if (entity_manager_.archetypes())
+            {
+                // queries requiring nothing and cached ones visit entities of archetypes one by one, so components are looked up.
+                each_in_view(view, fn, LookupAccessor<Ws> { &entity_manager_, manager.id<Ws>() }...,
+                    OptionalLookupAccessor<Os> { &entity_manager_, manager.id<Os>() }...);
+            }
+            else
+            {
+                each_in_view(view, fn, ComponentAccessor<Ws>(manager.id<Ws>(), pool_of(manager.id<Ws>()))...,
+                    OptionalComponentAccessor<Os>(manager.id<Os>(), pool_of(manager.id<Os>()), masks)...);
+            }
+        }
+
+        template <typename F, typename... Ws, typename... Os>
+        void parallel_in_query(View & view, F & fn, std::uint32_t grain, With<Ws...>, Optional<Os...>)
         {
-            return View(entity_manager_, component_mask);
+            auto & manager = ComponentManager::instance();
+            auto & masks = entity_manager_.entity_component_masks_;
+            auto & thread_pool = ThreadPool::instance();
+            StructureLock lock(entity_manager_);
+            if (view.use_archetypes_)
+            {
+                parallel_in_archetypes(thread_pool, view, fn, ComponentAccessor<Ws>(manager.id<Ws>(), nullptr)...,
+                    OptionalComponentAccessor<Os>(manager.id<Os>(), nullptr, masks)...);
+            }
+            else if (entity_manager_.archetypes())
+            {
+                parallel_in_view(thread_pool, view, fn, grain, LookupAccessor<Ws> { &entity_manager_, manager.id<Ws>() }...,
+                    OptionalLookupAccessor<Os> { &entity_manager_, manager.id<Os>() }...);
+            }
+            else
+            {
+                parallel_in_view(thread_pool, view, fn, grain, ComponentAccessor<Ws>(manager.id<Ws>(), pool_of(manager.id<Ws>()))...,
+                    OptionalComponentAccessor<Os>(manager.id<Os>(), pool_of(manager.id<Os>()), masks)...);
+            }
         }
 
         EntityManager entity_manager_;
     };
+
+    /// Entities having all components Ws, As and Cs and none of Xs, made by `World::query`.
+    ///
+    /// Only entities whose components As were added, and whose components Cs were changed, after the given tick are matched.
+    /// Iterating it gives `EntityHandle`s like `View`.
+    template <typename... Ws, typename... Xs, typename... Os, typename... As, typename... Cs>
+    struct Query<With<Ws...>, Without<Xs...>, Optional<Os...>, Added<As...>, Changed<Cs...>>
+    {
+        static_assert(ChangesTracked<As..., Cs...>::value, "Changes of components in Added and Changed terms must be tracked");
+
+        View::iterator begin()
+        {
+            return view_.begin();
+        }
+
+        View::iterator end()
+        {
+            return view_.end();
+        }
+
+        /// Returns the number of matching entities.
+        ///
+        /// With `Added` or `Changed` terms, matching entities are iterated to count them.
+        std::size_t count() const
+        {
+            if (view_.changes_.empty())
+            {
+                return world_->entity_manager_.count_matches(view_.query_);
+            }
+            auto view = view_;
+            std::size_t count = 0;
+            for (auto it = view.begin(), last = view.end(); it != last; ++it)
+            {
+                count++;
+            }
+            return count;
+        }
+
+        /// Calls FN with each matching entity, references to components Ws and pointers to components Os.
+        ///
+        /// FN is called as `fn(EntityHandle, Ws&..., Os*...)`, with nullptr for components Os the entity doesn't have.
+        /// FN must not add or remove components, nor create or destroy entities.
+        template <typename F>
+        void each(F fn)
+        {
+            auto view = world_->entities_with(required_, excluded_);
+            view.changes_ = view_.changes_;
+            world_->each_in_query(view, fn, With<Ws...>(), Optional<Os...>());
+        }
+
+        /// Calls FN like `each` in parallel, splitting entities into tasks of about GRAIN entities like `World::parallel_each`.
+        template <typename F>
+        void parallel_each(F fn, std::uint32_t grain = 0)
+        {
+            auto view = world_->entities_with(required_, excluded_);
+            view.changes_ = view_.changes_;
+            world_->parallel_in_query(view, fn, grain, With<Ws...>(), Optional<Os...>());
+        }
+
+    private:
+        friend World;
+
+        Query(World & world, std::uint32_t since) :
+            world_(&world),
+            required_(World::mask_of<Ws..., As..., Cs...>()),
+            excluded_(World::mask_of<Xs...>()),
+            view_(world.entities_with(required_, excluded_))
+        {
+            auto & manager = ComponentManager::instance();
+            view_.changes_.added = { manager.id<As>()... };
+            view_.changes_.changed = { manager.id<Cs>()... };
+            view_.changes_.since = since;
+        }
+
+        World * world_;
+        World::ComponentMask required_;
+        World::ComponentMask excluded_;
+        View view_;
+    };
+
+    /// Entities having all components Ws and none of Xs, kept in a dense array of indices. Made by `World::cached_query`.
+    ///
+    /// Iterating it gives `EntityHandle`s like `View`, in no particular order.
+    /// Changes of the world are reflected in it, including ones made while iterating.
+    template <typename... Ws, typename... Xs, typename... Os>
+    struct CachedQuery<With<Ws...>, Without<Xs...>, Optional<Os...>>
+    {
+        View::iterator begin()
+        {
+            return view_.begin();
+        }
+
+        View::iterator end()
+        {
+            return view_.end();
+        }
+
+        /// Returns the number of matching entities.
+        std::size_t count() const
+        {
+            return matches_->size();
+        }
+
+        /// Calls FN with each matching entity like `Query::each`.
+        ///
+        /// Archetypes already keep matching entities together, so their chunks are walked instead of cached indices.
+        template <typename F>
+        void each(F fn)
+        {
+            auto view = chunks() ? world_->entities_with(required_, excluded_) : view_;
+            world_->each_in_query(view, fn, With<Ws...>(), Optional<Os...>());
+        }
+
+        /// Calls FN like `each` in parallel, like `Query::parallel_each`.
+        template <typename F>
+        void parallel_each(F fn, std::uint32_t grain = 0)
+        {
+            auto view = chunks() ? world_->entities_with(required_, excluded_) : view_;
+            world_->parallel_in_query(view, fn, grain, With<Ws...>(), Optional<Os...>());
+        }
+
+    private:
+        friend World;
+
+        explicit CachedQuery(World & world) :
+            world_(&world),
+            required_(World::mask_of<Ws...>()),
+            excluded_(World::mask_of<Xs...>()),
+            matches_(&world.entity_manager_.Cache(MaskQuery(required_, excluded_))),
+            view_(world.entity_manager_, *matches_)
+        {}
+
+        /// Returns whether matching entities are found by archetypes, which is when any component is required.
+        bool chunks() const
+        {
+            return world_->entity_manager_.archetypes() && required_.any();
+        }
+
+        World * world_;
+        World::ComponentMask required_;
+        World::ComponentMask excluded_;
+        const SparseSet * matches_;
+        View view_;
+    };
+
+    /// Entities having all components Ts, whose packed pools are owned to keep them at the front. Made by `World::group`.
+    template <typename... Ts>
+    struct Group
+    {
+        /// Returns the number of entities in the group.
+        std::size_t size() const
+        {
+            return group_ ? group_->size : world_->template count<Ts...>();
+        }
+
+        /// Calls FN as `fn(Ts&...)` with components of each entity in the group.
+        ///
+        /// Components are walked in contiguous arrays in lockstep, without looking entities up nor testing masks,
+        /// so the loop vectorizes when FN is simple enough to be inlined.
+        /// Components whose changes are tracked are marked changed afterwards, as FN gets them by reference.
+        /// FN must not add or remove components, nor create or destroy entities.
+        template <typename F>
+        void each(F fn)
+        {
+            if (!group_)
+            {
+                world_->template each<Ts...>(Components<F> { fn });
+                return;
+            }
+            walk(fn, static_cast<PackedComponentPool<Ts>*>(world_->pool_of(ComponentManager::instance().id<Ts>()))...);
+            mark_changed();
+        }
+
+    private:
+        friend World;
+
+        /// Drops the entity handle for `World::each`.
+        template <typename F>
+        struct Components
+        {
+            void operator()(EntityHandle, Ts&... components)
+            {
+                fn(components...);
+            }
+
+            F & fn;
+        };
+
+        Group(World & world, EntityManager::OwningGroup * group) :
+            world_(&world),
+            group_(group)
+        {}
+
+        /// Walks runs of positions contiguous in all POOLS, up to the end of the group.
+        template <typename F, typename... Pools>
+        void walk(F & fn, Pools*... pools)
+        {
+            auto size = group_->size;
+            for (std::uint32_t position = 0; position < size;)
+            {
+                auto length = size - position;
+                (void) std::initializer_list<int> { (length = std::min<std::uint32_t>(length, static_cast<std::uint32_t>(pools->block_size() - position % pools->block_size())), 0)... };
+                run(fn, length, &pools->at(position)...);
+                position += length;
+            }
+        }
+
+        /// Marks components Ts of entities in the group changed, for those whose changes are tracked.
+        void mark_changed()
+        {
+            auto & manager = ComponentManager::instance();
+            auto & entity_manager = world_->entity_manager_;
+            for (auto component_index : { manager.id<Ts>()... })
+            {
+                if (!manager.tracks_changes(component_index))
+                {
+                    continue;
+                }
+                auto & owners = *world_->pool_of(group_->components[0])->owners();
+                for (std::uint32_t position = 0; position < group_->size; position++)
+                {
+                    entity_manager.MarkChanged(owners.index(position), component_index);
+                }
+            }
+        }
+
+        template <typename F, typename... Us>
+        static void run(F & fn, std::uint32_t length, Us*... columns)
+        {
+            for (std::uint32_t i = 0; i < length; i++)
+            {
+                fn(columns[i]...);
+            }
+        }
+
+        World * world_;
+        EntityManager::OwningGroup * group_;
+    };
 }
@@ -0,0 +1,83 @@
+#include "catch.hpp"
+
+#include <bent/internal/archetype_storage.hpp>
+
+#include "components/unko.hpp"
+
+struct AsPosition
+{
+    float x, y;
+};
+
+struct AsBig
+{
+    char data[20000];
+};
+
+struct alignas(64) AsAligned
+{
+    float value;
+};
+
+TEST_CASE("ArchetypeStorage well works", "[archetype_storage]")
+{
+    auto & manager = bent::ComponentManager::instance();
+    auto position = manager.id<AsPosition>();
+    auto u = manager.id<unko>();
+
+    bent::ArchetypeStorage storage;
+
+    new (storage.Add(0, position)) AsPosition { 1.0f, 2.0f };
+    new (storage.Add(1, u)) unko();
+    new (storage.Add(1, position)) AsPosition { 3.0f, 4.0f };
+    REQUIRE(storage.archetypes().size() == 3);
+
+    auto p = static_cast<AsPosition*>(storage.Get(1, position));
+    REQUIRE(p->x == 3.0f);
+    REQUIRE(static_cast<unko*>(storage.Get(1, u))->state == unko::MOVE_CONSTRUCTED);
+    REQUIRE(static_cast<AsPosition*>(storage.Get(0, position))->x == 1.0f);
+
+    SECTION("removing moves the entity back")
+    {
+        static_cast<unko*>(storage.Get(1, u))->~unko();
+        storage.Remove(1, u);
+        REQUIRE(storage.archetypes()[0]->size() == 2);
+        REQUIRE(storage.archetypes()[2]->size() == 0);
+        REQUIRE(static_cast<AsPosition*>(storage.Get(1, position))->y == 4.0f);
+    }
+
+    SECTION("destroying packs the archetype")
+    {
+        new (storage.Add(2, position)) AsPosition { 5.0f, 6.0f };
+        storage.Destroy(0);
+        auto & archetype = *storage.archetypes()[0];
+        REQUIRE(archetype.size() == 1);
+        REQUIRE(archetype.entity(0) == 2);
+        REQUIRE(static_cast<AsPosition*>(storage.Get(2, position))->x == 5.0f);
+    }
+
+    SECTION("chunks fit in ARCHETYPE_CHUNK_SIZE")
+    {
+        auto & archetype = *storage.archetypes()[0];
+        REQUIRE(archetype.chunk_capacity() * (sizeof(std::uint32_t) + sizeof(AsPosition)) <= bent::ARCHETYPE_CHUNK_SIZE);
+
+        new (storage.Add(3, manager.id<AsBig>())) AsBig();
+        REQUIRE(storage.archetypes().back()->chunk_capacity() == 1);
+    }
+
+    SECTION("over-aligned components are aligned in every chunk")
+    {
+        auto aligned = manager.id<AsAligned>();
+        for (std::uint32_t i = 10; i < 1000; i++)
+        {
+            new (storage.Add(i, aligned)) AsAligned { static_cast<float>(i) };
+        }
+        REQUIRE(storage.archetypes().back()->chunk_count() > 1);
+        for (std::uint32_t i = 10; i < 1000; i++)
+        {
+            auto address = reinterpret_cast<std::uintptr_t>(storage.Get(i, aligned));
+            REQUIRE(address % alignof(AsAligned) == 0);
+            REQUIRE(static_cast<AsAligned*>(storage.Get(i, aligned))->value == static_cast<float>(i));
+        }
+    }
+}
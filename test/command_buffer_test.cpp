@@ -0,0 +1,204 @@
+#include "catch.hpp"
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <bent/command_buffer.hpp>
+#include <bent/world.hpp>
+
+#include "components/position.hpp"
+#include "components/velocity.hpp"
+#include "components/unko.hpp"
+
+struct CbLabel
+{
+    explicit CbLabel(std::string text) : text(std::move(text)) { ++alive; }
+    CbLabel(const CbLabel& other) : text(other.text) { ++alive; }
+    CbLabel(CbLabel&& other) : text(std::move(other.text)) { ++alive; }
+    ~CbLabel() { --alive; }
+    std::string text;
+    static int alive;
+};
+
+int CbLabel::alive = 0;
+
+struct alignas(64) CbAligned
+{
+    explicit CbAligned(int value) : value(value) { misaligned += reinterpret_cast<std::uintptr_t>(this) % alignof(CbAligned) != 0; }
+    CbAligned(const CbAligned& other) : value(other.value) {}
+    int value;
+    static int misaligned;
+};
+
+int CbAligned::misaligned = 0;
+
+TEST_CASE("CommandBuffer well works", "[command_buffer]")
+{
+    bent::World world;
+    auto e1 = world.Create();
+    auto e2 = world.Create();
+    e1.Add<Position>(1.0f, 2.0f);
+    e2.Add<Position>(3.0f, 4.0f);
+
+    SECTION("recording")
+    {
+        bent::CommandBuffer buffer;
+        auto spawned = buffer.Create();
+        buffer.Add<Position>(spawned, 5.0f, 6.0f);
+        buffer.Add<Velocity>(spawned, 7.0f, 8.0f);
+        buffer.Replace<Position>(e1, 9.0f, 10.0f);
+        buffer.Add<Velocity>(e2, 1.0f, 1.0f);
+        buffer.Remove<Position>(e2);
+        buffer.Destroy(e1);
+        REQUIRE(buffer.size() == 7);
+
+        REQUIRE(e1.Get<Position>()->x == 1.0f);
+        REQUIRE(e2.Get<Velocity>() == nullptr);
+
+        world.Flush(buffer);
+        REQUIRE(buffer.empty());
+
+        REQUIRE_FALSE(e1.valid());
+        REQUIRE(e2.Get<Position>() == nullptr);
+        REQUIRE(e2.Get<Velocity>()->x == 1.0f);
+
+        std::size_t count = 0;
+        for (auto& entity : world.entities_with<Position, Velocity>())
+        {
+            REQUIRE(entity.Get<Position>()->x == 5.0f);
+            REQUIRE(entity.Get<Velocity>()->y == 8.0f);
+            ++count;
+        }
+        REQUIRE(count == 1);
+    }
+
+    SECTION("commands on destroyed entities are ignored")
+    {
+        bent::CommandBuffer buffer;
+        buffer.Add<Velocity>(e1, 1.0f, 1.0f);
+        buffer.Destroy(e1);
+        e1.Destroy();
+        REQUIRE_NOTHROW(world.Flush(buffer));
+        REQUIRE(world.entities_with<Velocity>().begin() == world.entities_with<Velocity>().end());
+    }
+
+    SECTION("payloads are moved and destructed")
+    {
+        bent::CommandBuffer buffer;
+        buffer.Add<unko>(e1);
+        world.Flush(buffer);
+        REQUIRE(e1.Get<unko>()->state == unko::MOVE_CONSTRUCTED);
+
+        buffer.Add<unko>(e1);
+        REQUIRE_THROWS_AS(world.Flush(buffer), std::out_of_range);
+        REQUIRE(buffer.empty());
+    }
+
+    SECTION("entities created by another buffer are rejected")
+    {
+        bent::CommandBuffer a, b;
+        a.Create();
+        auto spawned = a.Create();
+        b.Add<Position>(spawned, 1.0f, 1.0f);
+        b.Add<Velocity>(e1, 1.0f, 1.0f);
+        std::vector<bent::CommandBuffer*> buffers { &a, &b };
+        REQUIRE_THROWS_AS(world.Flush(buffers), std::invalid_argument);
+        REQUIRE(a.empty());
+        REQUIRE(b.empty());
+        REQUIRE(e1.Get<Velocity>() == nullptr);
+        std::size_t positions = 0;
+        for (auto& entity : world.entities_with<Position>())
+        {
+            (void) entity;
+            ++positions;
+        }
+        REQUIRE(positions == 2);
+    }
+
+    SECTION("over-aligned payloads are aligned")
+    {
+        bent::CommandBuffer buffer;
+        for (int i = 0; i < 1000; i++)
+        {
+            buffer.Add<Position>(e1, 1.0f, 1.0f);
+            buffer.Add<CbAligned>(e1, i);
+        }
+        REQUIRE(CbAligned::misaligned == 0);
+        buffer.Clear();
+    }
+
+    SECTION("moving buffers")
+    {
+        {
+            bent::CommandBuffer a;
+            bent::CommandBuffer b;
+            a.Add<CbLabel>(e1, std::string(100, 'a'));
+            b.Add<CbLabel>(e2, std::string(100, 'b'));
+            REQUIRE(CbLabel::alive == 2);
+
+            // payloads recorded in A are discarded, and B is left empty to record again.
+            a = std::move(b);
+            REQUIRE(CbLabel::alive == 1);
+            REQUIRE(a.size() == 1);
+            REQUIRE(b.empty());
+            b.Add<CbLabel>(e1, std::string(100, 'c'));
+            REQUIRE(CbLabel::alive == 2);
+
+            bent::CommandBuffer c(std::move(b));
+            REQUIRE(b.empty());
+            b.Add<CbLabel>(e1, std::string(100, 'd'));
+            REQUIRE(CbLabel::alive == 3);
+
+            world.Flush(a);
+            world.Flush(c);
+            REQUIRE(e1.Get<CbLabel>()->text == std::string(100, 'c'));
+            REQUIRE(e2.Get<CbLabel>()->text == std::string(100, 'b'));
+            REQUIRE(CbLabel::alive == 3);
+        }
+        REQUIRE(CbLabel::alive == 2);
+        e1.Remove<CbLabel>();
+        e2.Remove<CbLabel>();
+        REQUIRE(CbLabel::alive == 0);
+    }
+
+    SECTION("a buffer per thread")
+    {
+        bent::ThreadPool::instance().Resize(4);
+        std::vector<bent::CommandBuffer> buffers(bent::ThreadPool::instance().concurrency());
+        for (int i = 0; i < 1000; i++)
+        {
+            world.Create().Add<Velocity>(float(i), 0.0f);
+        }
+        world.parallel_each<Velocity>([&](bent::EntityHandle entity, Velocity& vel)
+        {
+            auto & buffer = buffers[bent::ThreadPool::worker()];
+            if (int(vel.x) % 2 == 0)
+            {
+                buffer.Destroy(entity);
+            }
+            else
+            {
+                buffer.Add<Position>(buffer.Create(), vel.x, 0.0f);
+            }
+        }, 64);
+        world.Flush(buffers);
+
+        std::size_t velocities = 0;
+        for (auto& entity : world.entities_with<Velocity>())
+        {
+            REQUIRE(int(entity.Get<Velocity>()->x) % 2 == 1);
+            ++velocities;
+        }
+        REQUIRE(velocities == 500);
+        std::size_t positions = 0;
+        for (auto& entity : world.entities_with<Position>())
+        {
+            (void) entity;
+            ++positions;
+        }
+        REQUIRE(positions == 502);
+        bent::ThreadPool::instance().Resize(bent::ThreadPool::default_concurrency());
+    }
+}
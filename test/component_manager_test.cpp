@@ -2,6 +2,9 @@
 
 #include <bent/component_manager.hpp>
 
+#include <thread>
+#include <vector>
+
 struct CmPosition
 {
     float x, y;
@@ -16,6 +19,11 @@ struct CmFlag
 {
 };
 
+template <int N>
+struct CmConcurrent
+{
+};
+
 TEST_CASE("Component type manager well works", "[component_manager]")
 {
     bent::ComponentManager& manager = bent::ComponentManager::instance();
@@ -54,3 +62,33 @@ TEST_CASE("Component type manager well works", "[component_manager]")
     REQUIRE(typeid(manager.component_pool_factory(cmvelocity)) == typeid(bent::ComponentPoolFactory<CmVelocity>));
     REQUIRE(typeid(manager.component_pool_factory(cmflag)) == typeid(bent::ComponentPoolFactory<CmFlag>));
 }
+
+TEST_CASE("Component type ids are assigned once across threads", "[component_manager]")
+{
+    bent::ComponentManager& manager = bent::ComponentManager::instance();
+
+    std::vector<std::vector<std::uint16_t>> ids(4);
+    std::vector<std::thread> threads;
+    for (auto& thread_ids : ids)
+    {
+        threads.emplace_back([&thread_ids, &manager]
+        {
+            thread_ids.push_back(manager.id<CmConcurrent<0>>());
+            thread_ids.push_back(manager.id<CmConcurrent<1>>());
+            thread_ids.push_back(manager.id<CmConcurrent<2>>());
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    for (auto& thread_ids : ids)
+    {
+        REQUIRE(thread_ids == ids[0]);
+    }
+    REQUIRE(ids[0][0] != ids[0][1]);
+    REQUIRE(ids[0][1] != ids[0][2]);
+    REQUIRE(ids[0][0] != ids[0][2]);
+    REQUIRE(typeid(manager.dynamic_constructor(ids[0][1])) == typeid(bent::DynamicConstructor<CmConcurrent<1>>));
+}
@@ -2,10 +2,95 @@
 
 #include <bent/internal/component_pool.hpp>
 
+#include <string>
+#include <vector>
+#include <memory>
+
 TEST_CASE("ComponentPool well works", "[component_pool]")
 {
     bent::ComponentPool<int> pool;
     auto p1 = (int*) pool.Allocate(1);
     REQUIRE(p1 == pool.Get(1));
     REQUIRE(p1 == pool.Allocate(1));
+    REQUIRE(pool.owners() == nullptr);
+}
+
+TEST_CASE("PackedComponentPool well works", "[component_pool]")
+{
+    bent::PackedComponentPool<int> pool(2 * sizeof(int));
+    new (pool.Allocate(100000)) int(1);
+    new (pool.Allocate(5)) int(2);
+    new (pool.Allocate(42)) int(3);
+    REQUIRE(pool.Allocate(5) == pool.Get(5));
+    REQUIRE(pool.owners()->size() == 3);
+
+    pool.Deallocate(100000);
+    REQUIRE(pool.owners()->size() == 2);
+    REQUIRE_FALSE(pool.owners()->contains(100000));
+    REQUIRE(*(int*) pool.Get(5) == 2);
+    REQUIRE(*(int*) pool.Get(42) == 3);
+    REQUIRE(pool.owners()->index(0) == 42);
+}
+
+TEST_CASE("PackedComponentPool swaps positions", "[component_pool]")
+{
+    bent::PackedComponentPool<int> pool(2 * sizeof(int));
+    for (std::uint32_t i = 0; i < 5; i++)
+    {
+        new (pool.Allocate(i * 10)) int(int(i));
+    }
+    pool.Swap(0, 3);
+    pool.Swap(1, 1);
+    REQUIRE(pool.owners()->index(0) == 30);
+    REQUIRE(pool.owners()->index(3) == 0);
+    REQUIRE(pool.owners()->position(30) == 0);
+    REQUIRE(pool.owners()->position(0) == 3);
+    REQUIRE(pool.at(0) == 3);
+    REQUIRE(pool.at(3) == 0);
+    REQUIRE(*(int*) pool.Get(0) == 0);
+    REQUIRE(*(int*) pool.Get(30) == 3);
+}
+
+TEST_CASE("ComponentPool shares blocks with forks until written", "[component_pool]")
+{
+    bent::ComponentPool<int> pool(4 * sizeof(int));
+    for (std::uint32_t i = 0; i < 8; i++)
+    {
+        new (pool.Allocate(i)) int(int(i));
+    }
+    std::unique_ptr<bent::ComponentPoolInterface> fork(pool.Fork(std::vector<std::uint32_t>()));
+    auto & forked = static_cast<bent::ComponentPool<int>&>(*fork);
+    REQUIRE(&forked.GetRef(1) != &pool.GetRef(1));
+    REQUIRE(forked.GetRef(1) == 1);
+
+    // the first write copies the block; the other pool keeps the original.
+    auto original = &pool.GetRef(5);
+    forked.GetRef(5) = 50;
+    REQUIRE(pool.GetRef(5) == 5);
+    REQUIRE(&pool.GetRef(5) == original);
+    new (forked.Allocate(9)) int(9);
+    REQUIRE(forked.GetRef(9) == 9);
+
+    std::unique_ptr<bent::ComponentPoolInterface> strings(bent::ComponentPool<std::string>().Fork(std::vector<std::uint32_t>()));
+    REQUIRE(strings);
+}
+
+TEST_CASE("PackedComponentPool copies components for forks", "[component_pool]")
+{
+    bent::PackedComponentPool<std::string> pool(2 * sizeof(std::string));
+    for (std::uint32_t i = 0; i < 5; i++)
+    {
+        new (pool.Allocate(i * 10)) std::string(1, char('a' + i));
+    }
+    std::unique_ptr<bent::ComponentPoolInterface> fork(pool.Fork(std::vector<std::uint32_t>()));
+    REQUIRE(fork->owners()->size() == 5);
+    REQUIRE(fork->owners()->index(3) == 30);
+    REQUIRE(*static_cast<std::string*>(fork->Get(40)) == "e");
+    *static_cast<std::string*>(fork->Get(40)) = "z";
+    REQUIRE(*static_cast<std::string*>(pool.Get(40)) == "e");
+    for (std::uint32_t i = 0; i < 5; i++)
+    {
+        static_cast<std::string*>(pool.Get(i * 10))->~basic_string();
+        static_cast<std::string*>(fork->Get(i * 10))->~basic_string();
+    }
 }
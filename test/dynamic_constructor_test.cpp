@@ -18,3 +18,53 @@ TEST_CASE("DynamicConstructor well works", "[dynamic_constructor]")
     dctor.Destroy(p);
     REQUIRE(p->state == unko::DESTRUCTED);
 }
+
+struct DcPoint
+{
+    int x, y;
+};
+
+TEST_CASE("DynamicConstructor constructs and relocates many objects", "[dynamic_constructor]")
+{
+    bent::DynamicConstructor<unko> dctor;
+    REQUIRE(!dctor.trivially_copyable());
+    std::allocator<unko> alloc;
+    auto src = alloc.allocate(4);
+    auto p = alloc.allocate(4);
+    for (int i = 0; i < 4; i++)
+    {
+        new (src + i) unko();
+    }
+    dctor.CopyConstruct(p, src, 4);
+    REQUIRE(p[3].state == unko::COPY_CONSTRUCTED);
+    dctor.Destroy(p, 4);
+    REQUIRE(p[0].state == unko::DESTRUCTED);
+    REQUIRE(p[3].state == unko::DESTRUCTED);
+    dctor.MoveConstruct(p, src, 4);
+    REQUIRE(p[2].state == unko::MOVE_CONSTRUCTED);
+    REQUIRE(src[2].state == unko::DEFAULT_CONSTRUCTED);
+    dctor.Destroy(p, 4);
+    dctor.Relocate(p, src, 3);
+    REQUIRE(p[0].state == unko::MOVE_CONSTRUCTED);
+    REQUIRE(src[0].state == unko::DESTRUCTED);
+    REQUIRE(src[2].state == unko::DESTRUCTED);
+    REQUIRE(src[3].state == unko::DEFAULT_CONSTRUCTED);
+    dctor.Relocate(p + 3, src + 3);
+    REQUIRE(p[3].state == unko::MOVE_CONSTRUCTED);
+    REQUIRE(src[3].state == unko::DESTRUCTED);
+    dctor.Destroy(p, 4);
+    alloc.deallocate(src, 4);
+    alloc.deallocate(p, 4);
+
+    // trivially copyable objects are copied as bytes.
+    bent::DynamicConstructor<DcPoint> points;
+    REQUIRE(points.trivially_copyable());
+    DcPoint from[3] = { { 1, 2 }, { 3, 4 }, { 5, 6 } };
+    DcPoint to[3];
+    points.Relocate(to, from, 3);
+    REQUIRE(to[2].x == 5);
+    REQUIRE(to[2].y == 6);
+    points.CopyConstruct(to, from + 1, 1);
+    REQUIRE(to[0].x == 3);
+    points.Destroy(to, 3);
+}
@@ -0,0 +1,41 @@
+#include "catch.hpp"
+
+#include <bent/internal/entity_bitmap.hpp>
+
+TEST_CASE("EntityBitmap well works", "[entity_bitmap]")
+{
+    bent::EntityBitmap bitmap;
+    REQUIRE(bitmap.word(0) == 0);
+    REQUIRE(bitmap.count() == 0);
+
+    bitmap.Resize(70, true);
+    REQUIRE(bitmap.word_count() == 2);
+    REQUIRE(bitmap.word(0) == ~std::uint64_t(0));
+    REQUIRE(bitmap.word(1) == 63);
+    REQUIRE(bitmap.count() == 70);
+
+    bitmap.Reset(3);
+    bitmap.Reset(65);
+    REQUIRE(!bitmap.test(3));
+    REQUIRE(bitmap.test(4));
+    REQUIRE(bitmap.bits(0, 8) == 0xf7);
+    REQUIRE(bitmap.bits(60, 8) == 0xdf);
+    REQUIRE(bitmap.bits(64, 64) == 61);
+    REQUIRE(bitmap.count() == 68);
+
+    bitmap.Set(200);
+    REQUIRE(bitmap.word_count() == 4);
+    REQUIRE(bitmap.test(200));
+    REQUIRE(!bitmap.test(1000));
+    REQUIRE(bitmap.bits(190, 64) == (std::uint64_t(1) << 10));
+    bitmap.Reset(1000);
+    REQUIRE(bitmap.count() == 69);
+
+    std::uint64_t words[] = { 5, ~std::uint64_t(0) };
+    bitmap.Assign(words, 70);
+    REQUIRE(bitmap.word_count() == 2);
+    REQUIRE(bitmap.word(1) == 63);
+    REQUIRE(bitmap.count() == 8);
+    bitmap.Resize(72, true);
+    REQUIRE(bitmap.test(71));
+}
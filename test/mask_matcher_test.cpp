@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <bent/internal/mask_matcher.hpp>
+
+TEST_CASE("Mask matching kernels agree", "[mask_matcher]")
+{
+    std::vector<bent::MatchFunction> kernels { &bent::mask_matcher::MatchScalar, bent::mask_matcher_function() };
+#if defined(BENT_MASK_MATCHER_X86)
+    kernels.push_back(&bent::mask_matcher::MatchSSE2);
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back(&bent::mask_matcher::MatchAVX2);
+    }
+#endif
+
+    std::mt19937_64 random(42);
+    for (std::uint32_t words : { 1u, 2u, 4u })
+    {
+        // sparse bits so that some rows match and others don't.
+        std::vector<std::uint64_t> rows(64 * words);
+        for (auto& word : rows)
+        {
+            word = random() & random() & random();
+        }
+        std::uint64_t query[bent::MAX_MASK_WORDS] = {};
+        query[0] = 0x11;
+        query[words - 1] |= std::uint64_t(1) << 40;
+        for (std::uint32_t i = 0; i < 64; i += 3)
+        {
+            rows[i * words] |= 0x11;
+            rows[i * words + words - 1] |= std::uint64_t(1) << 40;
+        }
+
+        // the second pass excludes bits some of the matching rows have.
+        std::uint64_t excluding[bent::MAX_MASK_WORDS] = {};
+        std::copy(query, query + bent::MAX_MASK_WORDS, excluding);
+        excluding[0] |= 0x100;
+        excluding[words - 1] |= std::uint64_t(1) << 50;
+        for (auto tested : { query, excluding })
+        {
+            for (std::uint32_t count = 0; count <= 64; count++)
+            {
+                std::uint64_t expected = 0;
+                for (std::uint32_t i = 0; i < count; i++)
+                {
+                    auto match = true;
+                    for (std::uint32_t j = 0; j < words; j++)
+                    {
+                        match = match && (rows[i * words + j] & tested[j]) == query[j];
+                    }
+                    expected |= std::uint64_t(match) << i;
+                }
+                if (count == 64)
+                {
+                    REQUIRE(expected != 0);
+                }
+                for (auto kernel : kernels)
+                {
+                    REQUIRE(kernel(rows.data(), words, count, tested, query, words) == expected);
+                }
+            }
+        }
+    }
+}
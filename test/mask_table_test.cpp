@@ -0,0 +1,75 @@
+#include "catch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <bent/internal/mask_table.hpp>
+
+TEST_CASE("MaskTable well works", "[mask_table]")
+{
+    bent::MaskTable table;
+    REQUIRE(table.words() == 1);
+
+    table.Resize(3);
+    REQUIRE(table.size() == 3);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(table.data()) % bent::MASK_TABLE_ALIGNMENT == 0);
+    REQUIRE_FALSE(table.test(1, 5));
+
+    table.Set(1, 5);
+    table.Set(1, 63);
+    table.Set(2, 5);
+    REQUIRE(table.test(1, 5));
+    REQUIRE(table.test(1, 63));
+    REQUIRE_FALSE(table.test(0, 5));
+
+    bent::ComponentMask mask;
+    mask[5] = true;
+    bent::MaskQuery query(mask);
+    REQUIRE(query.size == 1);
+    REQUIRE_FALSE(table.Contains(0, query));
+    REQUIRE(table.Contains(1, query));
+    REQUIRE(table.Contains(2, query));
+
+    SECTION("widening")
+    {
+        table.Set(2, 200);
+        REQUIRE(table.words() == 4);
+        REQUIRE(table.test(1, 5));
+        REQUIRE(table.test(1, 63));
+        REQUIRE(table.test(2, 200));
+        REQUIRE(table.Contains(1, query));
+
+        mask[200] = true;
+        bent::MaskQuery wide(mask);
+        REQUIRE(wide.size == 4);
+        REQUIRE_FALSE(table.Contains(1, wide));
+        REQUIRE(table.Contains(2, wide));
+
+        std::vector<std::uint16_t> components;
+        table.ForEach(2, [&](std::uint16_t i)
+        {
+            components.push_back(i);
+        });
+        REQUIRE(components == (std::vector<std::uint16_t> { 5, 200 }));
+        REQUIRE(table.mask(2) == mask);
+    }
+
+    SECTION("a query wider than the table matches nothing")
+    {
+        mask[100] = true;
+        REQUIRE_FALSE(table.Contains(1, bent::MaskQuery(mask)));
+    }
+
+    SECTION("resetting and clearing")
+    {
+        table.Reset(1, 5);
+        REQUIRE_FALSE(table.test(1, 5));
+        REQUIRE(table.test(1, 63));
+        table.Clear(1);
+        REQUIRE_FALSE(table.test(1, 63));
+
+        table.Resize(1000);
+        REQUIRE(table.test(2, 5));
+        REQUIRE_FALSE(table.test(999, 5));
+    }
+}
@@ -0,0 +1,31 @@
+#include "catch.hpp"
+
+#include <bent/internal/occupancy_summary.hpp>
+
+TEST_CASE("OccupancySummary well works", "[occupancy_summary]")
+{
+    bent::OccupancySummary summary;
+    REQUIRE(summary.blocks(0) == 0);
+    REQUIRE(summary.pages(0) == 0);
+
+    summary.Insert(3);
+    summary.Insert(10);
+    summary.Insert(64 * 5 + 1);
+    summary.Insert(4096 * 70);
+    REQUIRE(summary.blocks(0) == ((1u << 0) | (1u << 5)));
+    REQUIRE(summary.pages(0) == 1);
+    REQUIRE(summary.blocks(70) == 1);
+    REQUIRE(summary.pages(1) == (std::uint64_t(1) << 6));
+    REQUIRE(summary.blocks(1000) == 0);
+
+    summary.Erase(3);
+    REQUIRE(summary.blocks(0) == ((1u << 0) | (1u << 5)));
+    summary.Erase(10);
+    REQUIRE(summary.blocks(0) == (1u << 5));
+    REQUIRE(summary.pages(0) == 1);
+    summary.Erase(64 * 5 + 1);
+    REQUIRE(summary.blocks(0) == 0);
+    REQUIRE(summary.pages(0) == 0);
+    summary.Erase(4096 * 70);
+    REQUIRE(summary.pages(1) == 0);
+}
@@ -0,0 +1,92 @@
+#include "catch.hpp"
+
+#include <vector>
+
+#include <bent/internal/roaring_set.hpp>
+
+static std::vector<std::uint32_t> members(const bent::RoaringSet & set)
+{
+    std::vector<std::uint32_t> members;
+    set.ForEach([&](std::uint32_t index)
+    {
+        members.push_back(index);
+    });
+    return members;
+}
+
+TEST_CASE("RoaringSet keeps sparse members in arrays", "[roaring_set]")
+{
+    bent::RoaringSet set;
+    REQUIRE(set.size() == 0);
+    REQUIRE(set.word(0) == 0);
+    REQUIRE(set.pages(0) == 0);
+
+    set.Insert(70);
+    set.Insert(3);
+    set.Insert(3);
+    set.Insert(4096 * 70 + 1);
+    set.Insert(30000000);
+    REQUIRE(set.size() == 4);
+    REQUIRE(set.container_count() == 3);
+    REQUIRE(members(set) == (std::vector<std::uint32_t> { 3, 70, 4096 * 70 + 1, 30000000 }));
+    REQUIRE(set.contains(70));
+    REQUIRE(!set.contains(71));
+    REQUIRE(set.word(0) == (1u << 3));
+    REQUIRE(set.word(1) == (1u << 6));
+    REQUIRE(set.bits(60, 16) == (1u << 10));
+    REQUIRE(set.blocks(0) == 3);
+    REQUIRE(set.blocks(70) == 1);
+    REQUIRE(set.pages(0) == 1);
+    REQUIRE(set.pages(1) == (std::uint64_t(1) << 6));
+    REQUIRE(set.pages(30000000 / 4096 / 64) == (std::uint64_t(1) << (30000000 / 4096 % 64)));
+
+    set.Erase(70);
+    set.Erase(71);
+    set.Erase(30000000);
+    REQUIRE(set.size() == 2);
+    REQUIRE(set.container_count() == 2);
+    REQUIRE(set.blocks(0) == 1);
+}
+
+TEST_CASE("RoaringSet turns full arrays into runs or bitmaps", "[roaring_set]")
+{
+    bent::RoaringSet runs;
+    for (std::uint32_t i = 1000; i < 7000; i++)
+    {
+        runs.Insert(i);
+    }
+    REQUIRE(runs.size() == 6000);
+    REQUIRE(runs.contains(1000));
+    REQUIRE(runs.contains(6999));
+    REQUIRE(!runs.contains(7000));
+    REQUIRE(runs.word(15) == ~std::uint64_t(0) << 40);
+    REQUIRE(runs.blocks(0) == ~std::uint64_t(0) << 15);
+    REQUIRE(runs.blocks(1) == (std::uint64_t(1) << 46) - 1);
+    REQUIRE(runs.pages(0) == 3);
+    runs.Erase(3000);
+    runs.Insert(7000);
+    REQUIRE(!runs.contains(3000));
+    REQUIRE(runs.word(46) == ~(std::uint64_t(1) << 56));
+    runs.Insert(3000);
+    REQUIRE(runs.word(46) == ~std::uint64_t(0));
+    REQUIRE(runs.size() == 6001);
+
+    bent::RoaringSet bitmap;
+    std::vector<std::uint32_t> expected;
+    for (std::uint32_t i = 0; i < 65536; i += 3)
+    {
+        bitmap.Insert(65536 + i);
+        expected.push_back(65536 + i);
+    }
+    REQUIRE(bitmap.size() == expected.size());
+    REQUIRE(members(bitmap) == expected);
+    REQUIRE(bitmap.word(1024) == 0x9249249249249249ull);
+    REQUIRE(bitmap.blocks(16) == ~std::uint64_t(0));
+    REQUIRE(bitmap.pages(0) == 0xffff0000ull);
+    for (std::uint32_t i = 0; i < 65536; i += 3)
+    {
+        bitmap.Erase(65536 + i);
+    }
+    REQUIRE(bitmap.size() == 0);
+    REQUIRE(bitmap.container_count() == 0);
+}
@@ -0,0 +1,270 @@
+#include "catch.hpp"
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <iterator>
+#include <stdexcept>
+
+#include <bent/scheduler.hpp>
+
+struct SdPosition
+{
+    float x, y;
+};
+
+struct SdVelocity
+{
+    float x, y;
+};
+
+struct SdHealth
+{
+    int value;
+};
+
+struct SdHeat
+{
+    int value;
+};
+
+struct SdCharge
+{
+    int value;
+};
+
+namespace bent
+{
+    template <>
+    struct ComponentChanges<SdHeat>
+    {
+        using type = TrackedChanges;
+    };
+
+    template <>
+    struct ComponentChanges<SdCharge>
+    {
+        using type = TrackedChanges;
+    };
+}
+
+TEST_CASE("Scheduler well works", "[scheduler]")
+{
+    bent::ThreadPool thread_pool(4);
+    bent::World world;
+    bent::Scheduler scheduler(world, thread_pool);
+
+    std::mutex mutex;
+    std::vector<std::string> order;
+    auto record = [&](const std::string & name)
+    {
+        return [&, name](bent::World&)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(name == "movement" ? 20 : 1));
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(name);
+        };
+    };
+    auto position = [&](const std::string & name)
+    {
+        return std::find(order.begin(), order.end(), name) - order.begin();
+    };
+
+    scheduler.Add<bent::System<bent::Read<SdVelocity>, bent::Write<SdPosition>>>("movement", record("movement"));
+    scheduler.Add<bent::System<bent::Write<SdHealth>>>("regeneration", record("regeneration"));
+    scheduler.Add<bent::System<bent::Read<SdPosition>>>("render", record("render"));
+    scheduler.Add<bent::System<bent::Read<SdPosition, SdHealth>>>("hud", record("hud"));
+    scheduler.Add<bent::System<bent::Write<SdVelocity>>>("input", record("input"));
+
+    scheduler.Run();
+
+    REQUIRE(order.size() == 5);
+    REQUIRE(position("movement") < position("render"));
+    REQUIRE(position("movement") < position("hud"));
+    REQUIRE(position("regeneration") < position("hud"));
+    REQUIRE(position("movement") < position("input"));
+
+    auto & report = scheduler.report();
+    REQUIRE(report.system_times.size() == 5);
+    REQUIRE(report.critical_path.size() == 2);
+    REQUIRE(report.critical_path.front() == "movement");
+    REQUIRE(report.critical_path_time <= report.frame_time);
+
+    SECTION("structural changes")
+    {
+        scheduler.Add<bent::System<bent::Read<SdPosition>>>("spawn", [](bent::World& world)
+        {
+            world.Create();
+        });
+        REQUIRE_THROWS_AS(scheduler.Run(), std::logic_error);
+    }
+
+    SECTION("exclusive systems")
+    {
+        std::size_t spawned = 0;
+        std::size_t spawned_in_system = 0;
+        world.Observe<SdPosition>(bent::ComponentEvent::Add, [&](const std::uint64_t *, std::size_t count)
+        {
+            spawned += count;
+        });
+        scheduler.Add<bent::System<bent::Exclusive>>("spawn", [&](bent::World& world)
+        {
+            world.Create().Add<SdPosition>(SdPosition { 0.0f, 0.0f });
+            spawned_in_system = spawned;
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back("spawn");
+        });
+        order.clear();
+        scheduler.Run();
+        REQUIRE(order.back() == "spawn");
+        REQUIRE(spawned_in_system == 0);
+        REQUIRE(spawned == 1);
+    }
+}
+
+TEST_CASE("Scheduler runs systems reading components no entity has concurrently", "[scheduler]")
+{
+    bent::ThreadPool thread_pool(4);
+    bent::World world;
+    std::vector<bent::EntityHandle> entities;
+    world.Create(1000, std::back_inserter(entities));
+    for (auto & entity : entities)
+    {
+        entity.Add<SdVelocity>(SdVelocity { 1.0f, 0.0f });
+    }
+    world.cached_query<bent::With<SdVelocity>>();
+
+    // no entity has had SdPosition, so it has no pool, and readers must not make one at once.
+    bent::Scheduler scheduler(world, thread_pool);
+    std::atomic<int> visited { 0 };
+    std::atomic<int> cached { 0 };
+    std::atomic<int> rejected { 0 };
+    for (int i = 0; i < 4; i++)
+    {
+        scheduler.Add<bent::System<bent::Read<SdPosition, SdVelocity>>>("reader" + std::to_string(i), [&](bent::World & w)
+        {
+            w.each<SdPosition>([&](bent::EntityHandle, SdPosition&)
+            {
+                ++visited;
+            });
+            for (auto entity : w.entities_with<SdPosition, SdVelocity>())
+            {
+                (void) entity;
+                ++visited;
+            }
+            w.each<SdVelocity>([&](bent::EntityHandle, SdVelocity&)
+            {
+                ++cached;
+            });
+            cached += static_cast<int>(w.cached_query<bent::With<SdVelocity>>().count());
+            try
+            {
+                w.cached_query<bent::With<SdPosition>>();
+            }
+            catch (const std::logic_error &)
+            {
+                ++rejected;
+            }
+        });
+    }
+    scheduler.Run();
+    REQUIRE(visited == 0);
+    REQUIRE(cached == 8000);
+    REQUIRE(rejected == 4);
+
+    // exclusive systems run alone, so they may cache queries.
+    bent::Scheduler exclusive(world, thread_pool);
+    exclusive.Add<bent::System<bent::Exclusive>>("cache", [&](bent::World & w)
+    {
+        REQUIRE(w.cached_query<bent::With<SdPosition>>().count() == 0);
+    });
+    exclusive.Run();
+}
+
+TEST_CASE("Scheduler runs systems changing components of the same chunks concurrently", "[scheduler]")
+{
+    bent::ThreadPool thread_pool(4);
+    bent::World world(bent::StorageBackend::Archetypes);
+    std::vector<bent::EntityHandle> entities;
+    world.Create(1000, std::back_inserter(entities));
+    for (auto & entity : entities)
+    {
+        entity.Add<SdHeat>(SdHeat { 0 });
+        entity.Add<SdCharge>(SdCharge { 0 });
+    }
+    auto last_run = world.Tick();
+
+    // both systems stamp the chunks they share at once.
+    bent::Scheduler scheduler(world, thread_pool);
+    std::atomic<int> started { 0 };
+    auto meet = [&]
+    {
+        ++started;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (started < 2 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    };
+    scheduler.Add<bent::System<bent::Write<SdHeat>>>("heating", [&](bent::World &)
+    {
+        meet();
+        for (std::size_t i = 0; i < entities.size(); i += 2)
+        {
+            entities[i].Get<SdHeat>()->value++;
+        }
+    });
+    scheduler.Add<bent::System<bent::Write<SdCharge>>>("charging", [&](bent::World &)
+    {
+        meet();
+        for (std::size_t i = 1; i < entities.size(); i += 2)
+        {
+            entities[i].Get<SdCharge>()->value++;
+        }
+    });
+    scheduler.Run();
+    REQUIRE(world.query<bent::Changed<SdHeat>>(last_run).count() == 500);
+    REQUIRE(world.query<bent::Changed<SdCharge>>(last_run).count() == 500);
+}
+
+TEST_CASE("Scheduler runs systems reading tracked components one at a time", "[scheduler]")
+{
+    bent::ThreadPool thread_pool(4);
+    bent::World world;
+    std::vector<bent::EntityHandle> entities;
+    world.Create(1000, std::back_inserter(entities));
+    for (auto & entity : entities)
+    {
+        entity.Add<SdHeat>(SdHeat { 0 });
+    }
+    auto last_run = world.Tick();
+
+    // getting tracked components stamps them, so readers of them don't overlap.
+    bent::Scheduler scheduler(world, thread_pool);
+    std::atomic<int> running { 0 };
+    std::atomic<int> overlapped { 0 };
+    for (int i = 0; i < 4; i++)
+    {
+        scheduler.Add<bent::System<bent::Read<SdHeat>>>("reader" + std::to_string(i), [&](bent::World & w)
+        {
+            if (++running > 1)
+            {
+                ++overlapped;
+            }
+            w.each<SdHeat>([&](bent::EntityHandle, SdHeat & heat)
+            {
+                (void) heat;
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            --running;
+        });
+    }
+    scheduler.Run();
+    REQUIRE(overlapped == 0);
+    REQUIRE(scheduler.report().critical_path.size() == 4);
+    REQUIRE(world.query<bent::Changed<SdHeat>>(last_run).count() == 1000);
+}
@@ -0,0 +1,101 @@
+#include "catch.hpp"
+
+#include <bent/internal/snapshot.hpp>
+#include <bent/internal/component_pool.hpp>
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <memory>
+
+TEST_CASE("SnapshotWriter writes aligned sections SnapshotReader reads in place", "[snapshot]")
+{
+    const char * path = "bent_snapshot_test.bin";
+    {
+        bent::SnapshotWriter writer(path);
+        writer.Write(std::uint32_t(7));
+        writer.Align();
+        REQUIRE(writer.offset() == bent::SNAPSHOT_ALIGNMENT);
+        writer.Write(std::uint64_t(0));
+        writer.Write("abc", 3);
+        writer.Patch(bent::SNAPSHOT_ALIGNMENT, std::uint64_t(42));
+        writer.Align();
+        writer.Close();
+    }
+
+    auto file = std::make_shared<bent::SnapshotFile>(path);
+    REQUIRE(file->size() == 2 * bent::SNAPSHOT_ALIGNMENT);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(file->data()) % bent::SNAPSHOT_ALIGNMENT == 0);
+    bent::SnapshotReader reader(file);
+    REQUIRE(reader.Read<std::uint32_t>() == 7);
+    reader.Align();
+    REQUIRE(reader.Read<std::uint64_t>() == 42);
+    REQUIRE(std::string(reader.Take(3), 3) == "abc");
+    reader.Align();
+    REQUIRE(reader.offset() == file->size());
+    REQUIRE_THROWS_AS(reader.Take(1), std::runtime_error);
+    REQUIRE_THROWS_AS(reader.Seek(file->size() + 1), std::runtime_error);
+
+    // the mapping is private, so writes to it don't reach the file.
+    file->data()[0] = 9;
+    REQUIRE(bent::SnapshotFile(path).data()[0] == 7);
+
+    std::remove(path);
+    REQUIRE_THROWS_AS(std::make_shared<bent::SnapshotFile>(path), std::runtime_error);
+}
+
+TEST_CASE("ComponentPool adopts blocks of snapshots", "[snapshot]")
+{
+    const char * path = "bent_snapshot_test.bin";
+    bent::ComponentPool<int> pool(4 * sizeof(int));
+    for (std::uint32_t i = 0; i < 10; i++)
+    {
+        if (i / 4 != 1)
+        {
+            new (pool.Allocate(i)) int(int(i) * 10);
+        }
+    }
+    {
+        bent::SnapshotWriter writer(path);
+        REQUIRE(pool.Save(writer));
+        writer.Close();
+    }
+    bent::SnapshotWriter strings("bent_snapshot_strings.bin");
+    REQUIRE(!bent::ComponentPool<std::string>().Save(strings));
+    REQUIRE(!bent::PackedComponentPool<int>().Save(strings));
+    strings.Close();
+    std::remove("bent_snapshot_strings.bin");
+
+    auto file = std::make_shared<bent::SnapshotFile>(path);
+    std::remove(path);
+    bent::ComponentPool<int> adopted(4 * sizeof(int));
+    {
+        bent::SnapshotReader reader(file);
+        REQUIRE(adopted.Load(reader));
+    }
+    auto & component = adopted.GetRef(9);
+    REQUIRE(component == 90);
+    REQUIRE(reinterpret_cast<char*>(&component) >= file->data());
+    REQUIRE(reinterpret_cast<char*>(&component) < file->data() + file->size());
+
+    // blocks of another size are copied.
+    bent::ComponentPool<int> copied(3 * sizeof(int));
+    {
+        bent::SnapshotReader reader(file);
+        REQUIRE(copied.Load(reader));
+    }
+    REQUIRE(copied.GetRef(8) == 80);
+    REQUIRE(copied.GetRef(9) == 90);
+    auto copy = reinterpret_cast<char*>(&copied.GetRef(9));
+    REQUIRE((copy < file->data() || copy >= file->data() + file->size()));
+
+    component = 91;
+    new (adopted.Allocate(5)) int(50);
+    REQUIRE(adopted.GetRef(5) == 50);
+    REQUIRE(adopted.GetRef(0) == 0);
+    REQUIRE(copied.GetRef(9) == 90);
+
+    // blocks keep the file mapped after it's released here.
+    file.reset();
+    REQUIRE(adopted.GetRef(2) == 20);
+}
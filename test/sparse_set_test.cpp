@@ -0,0 +1,29 @@
+#include "catch.hpp"
+
+#include <bent/internal/sparse_set.hpp>
+
+TEST_CASE("SparseSet well works", "[sparse_set]")
+{
+    bent::SparseSet set;
+    REQUIRE(set.empty());
+    REQUIRE_FALSE(set.contains(3));
+
+    REQUIRE(set.Insert(3) == 0);
+    REQUIRE(set.Insert(10000) == 1);
+    REQUIRE(set.Insert(7) == 2);
+    REQUIRE(set.size() == 3);
+    REQUIRE(set.contains(10000));
+    REQUIRE(set.position(7) == 2);
+    REQUIRE(set.index(1) == 10000);
+
+    REQUIRE(set.Erase(3) == 0);
+    REQUIRE_FALSE(set.contains(3));
+    REQUIRE(set.position(7) == 0);
+    REQUIRE(set.index(0) == 7);
+    REQUIRE(set.size() == 2);
+
+    REQUIRE(set.Erase(10000) == 1);
+    REQUIRE(set.Erase(7) == 0);
+    REQUIRE(set.empty());
+    REQUIRE(set.position(7) == bent::NULL_POSITION);
+}
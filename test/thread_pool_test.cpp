@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+
+#include <bent/internal/thread_pool.hpp>
+
+TEST_CASE("ThreadPool well works", "[thread_pool]")
+{
+    bent::ThreadPool pool(4);
+    REQUIRE(pool.concurrency() == 4);
+
+    SECTION("runs every task once")
+    {
+        std::vector<std::atomic<int>> counts(1000);
+        for (auto & count : counts)
+        {
+            count = 0;
+        }
+        pool.Run(1000, [&](std::uint32_t task)
+        {
+            ++counts[task];
+        });
+        for (auto & count : counts)
+        {
+            REQUIRE(count == 1);
+        }
+    }
+
+    SECTION("rethrows an exception of a task")
+    {
+        std::atomic<int> done(0);
+        REQUIRE_THROWS_AS(pool.Run(100, [&](std::uint32_t task)
+        {
+            if (task == 42)
+            {
+                throw std::runtime_error("42");
+            }
+            ++done;
+        }), std::runtime_error);
+        REQUIRE(done == 99);
+    }
+
+    SECTION("runs nested tasks on the calling thread")
+    {
+        std::atomic<int> count(0);
+        pool.Run(8, [&](std::uint32_t)
+        {
+            pool.Run(8, [&](std::uint32_t)
+            {
+                ++count;
+            });
+        });
+        REQUIRE(count == 64);
+    }
+
+    SECTION("resizes")
+    {
+        pool.Resize(2);
+        REQUIRE(pool.concurrency() == 2);
+        std::atomic<int> count(0);
+        pool.Run(10, [&](std::uint32_t)
+        {
+            ++count;
+        });
+        REQUIRE(count == 10);
+    }
+}
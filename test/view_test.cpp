@@ -1,7 +1,11 @@
 #include "catch.hpp"
 
+#include <vector>
+#include <algorithm>
+
 #include <bent/view.hpp>
 #include <bent/world.hpp>
+#include <bent/component_storage.hpp>
 
 #include "components/position.hpp"
 #include "components/velocity.hpp"
@@ -10,6 +14,20 @@ struct Flag
 {
 };
 
+struct VtMarker
+{
+    int value;
+};
+
+namespace bent
+{
+    template <>
+    struct ComponentStorage<VtMarker>
+    {
+        using type = PackedComponentPool<VtMarker>;
+    };
+}
+
 TEST_CASE("Entity iteration by View", "[view]")
 {
     bent::World world;
@@ -93,4 +111,203 @@ TEST_CASE("Entity iteration by View", "[view]")
             REQUIRE(it == view.end());
         }
     }
+
+    SECTION("after removals")
+    {
+        e1.Remove<Velocity>();
+        {
+            auto view = world.entities_with<Velocity>();
+            REQUIRE(view.begin() == view.end());
+        }
+        {
+            auto view = world.entities_with<Position, Velocity>();
+            REQUIRE(view.begin() == view.end());
+        }
+        e3.Destroy();
+        {
+            auto view = world.entities_with<Position>();
+            auto it = view.begin();
+            REQUIRE(*it == e1);
+            ++it;
+            REQUIRE(it == view.end());
+        }
+        e2.Add<Velocity>(0.0f, 0.0f);
+        {
+            auto view = world.entities_with<Flag, Velocity>();
+            auto it = view.begin();
+            REQUIRE(*it == e2);
+            ++it;
+            REQUIRE(it == view.end());
+        }
+    }
+
+    SECTION("driven by packed owners")
+    {
+        e1.Add<VtMarker>(VtMarker { 1 });
+        e3.Add<VtMarker>(VtMarker { 3 });
+        {
+            auto view = world.entities_with<VtMarker>();
+            auto it = view.begin();
+            REQUIRE(*it == e3);
+            ++it;
+            REQUIRE(*it == e1);
+            ++it;
+            REQUIRE(it == view.end());
+        }
+        {
+            auto view = world.entities_with<Position, Velocity, VtMarker>();
+            auto it = view.begin();
+            REQUIRE(*it == e1);
+            ++it;
+            REQUIRE(it == view.end());
+        }
+        for (auto& entity : world.entities_with<VtMarker>())
+        {
+            entity.Remove<VtMarker>();
+        }
+        auto view = world.entities_with<VtMarker>();
+        REQUIRE(view.begin() == view.end());
+    }
+}
+
+TEST_CASE("View finds components added after it was made", "[view]")
+{
+    bent::World world;
+    auto e1 = world.Create();
+    auto e2 = world.Create();
+    auto e3 = world.Create();
+
+    SECTION("by scanning")
+    {
+        auto view = world.entities_with<Position>();
+        e1.Add<Position>(10.0f, 20.0f);
+        std::vector<bent::EntityHandle> found;
+        for (auto& entity : view)
+        {
+            // components added to later entities while iterating are found, too.
+            if (entity == e1)
+            {
+                e3.Add<Position>(20.0f, 30.0f);
+            }
+            found.push_back(entity);
+        }
+        REQUIRE(found == std::vector<bent::EntityHandle>({ e1, e3 }));
+    }
+    SECTION("by scanning, testing each block again only once")
+    {
+        std::vector<bent::EntityHandle> entities;
+        world.Create(64 * 50, std::back_inserter(entities));
+        for (auto& entity : entities)
+        {
+            entity.Add<Position>(1.0f, 2.0f);
+        }
+        auto view = world.entities_with<Position>();
+        std::size_t count = 0;
+        auto it = view.begin();
+        for (; it != view.end(); ++it)
+        {
+            it->Add<Velocity>(3.0f, 4.0f);
+            ++count;
+        }
+        REQUIRE(count == entities.size());
+        REQUIRE(it.blocks_tested() <= 2 * (3 + entities.size() + 63) / 64);
+    }
+    SECTION("by owners")
+    {
+        auto view = world.entities_with<VtMarker>();
+        e2.Add<VtMarker>(VtMarker { 1 });
+        auto it = view.begin();
+        REQUIRE(*it == e2);
+        ++it;
+        REQUIRE(it == view.end());
+    }
+    SECTION("by archetypes")
+    {
+        bent::World chunked(bent::StorageBackend::Archetypes);
+        auto entity = chunked.Create();
+        auto view = chunked.entities_with<Position>();
+        entity.Add<Position>(10.0f, 20.0f);
+        auto it = view.begin();
+        REQUIRE(*it == entity);
+        ++it;
+        REQUIRE(it == view.end());
+    }
+    SECTION("by queries")
+    {
+        auto query = world.query<bent::With<Position>>();
+        e2.Add<Position>(10.0f, 20.0f);
+        std::size_t count = 0;
+        for (auto& entity : query)
+        {
+            REQUIRE(entity == e2);
+            ++count;
+        }
+        REQUIRE(count == 1);
+        query.each([&](bent::EntityHandle, Position & position)
+        {
+            REQUIRE(position.x == 10.0f);
+            ++count;
+        });
+        REQUIRE(count == 2);
+    }
+}
+
+TEST_CASE("Entity iteration by View over archetypes", "[view]")
+{
+    bent::World world(bent::StorageBackend::Archetypes);
+    auto e1 = world.Create();
+    auto e2 = world.Create();
+    auto e3 = world.Create();
+    auto e4 = world.Create();
+
+    e1.Add<Position>(10.0f, 20.0f);
+    e1.Add<Velocity>(1.0f, 2.0f);
+    e2.Add<Flag>();
+    e3.Add<Position>(20.0f, 30.0f);
+    e3.Add<Flag>();
+    e4.Add<Velocity>(3.0f, 4.0f);
+    e4.Add<Position>(30.0f, 40.0f);
+
+    REQUIRE(e1.Get<Position>()->x == 10.0f);
+    REQUIRE(e4.Get<Velocity>()->y == 4.0f);
+
+    std::vector<bent::EntityHandle> found;
+    for (auto& entity : world.entities_with<Position, Velocity>())
+    {
+        found.push_back(entity);
+    }
+    REQUIRE(found.size() == 2);
+    REQUIRE(std::find(found.begin(), found.end(), e1) != found.end());
+    REQUIRE(std::find(found.begin(), found.end(), e4) != found.end());
+
+    e1.Remove<Velocity>();
+    REQUIRE(e1.Get<Velocity>() == nullptr);
+    REQUIRE(e1.Get<Position>()->y == 20.0f);
+    e3.Destroy();
+
+    {
+        auto view = world.entities_with<Position, Velocity>();
+        auto it = view.begin();
+        REQUIRE(*it == e4);
+        ++it;
+        REQUIRE(it == view.end());
+    }
+    {
+        std::size_t count = 0;
+        for (auto& entity : world.entities_with<Position>())
+        {
+            REQUIRE((entity == e1 || entity == e4));
+            ++count;
+        }
+        REQUIRE(count == 2);
+    }
+    {
+        std::size_t count = 0;
+        for (auto& entity : world.entities_with<>())
+        {
+            (void) entity;
+            ++count;
+        }
+        REQUIRE(count == 3);
+    }
 }
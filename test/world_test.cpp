@@ -3,6 +3,15 @@
 #include <bent/world.hpp>
 #include <bent/view.hpp>
 
+#include <vector>
+#include <atomic>
+#include <iterator>
+#include <algorithm>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
 struct WtPosition
 {
     WtPosition(float x, float y) : x(x), y(y) {}
@@ -19,6 +28,114 @@ struct WtFlag
 {
 };
 
+struct WtCounted
+{
+    WtCounted() { ++alive; }
+    WtCounted(const WtCounted&) { ++alive; }
+    ~WtCounted() { --alive; }
+    static int alive;
+};
+
+int WtCounted::alive = 0;
+
+struct WtQuest
+{
+    int step;
+};
+
+struct WtBody
+{
+    float x, y;
+};
+
+struct WtMotion
+{
+    float x, y;
+};
+
+struct WtHealth
+{
+    int hp;
+};
+
+struct WtStamina
+{
+    int points;
+};
+
+struct WtPoint
+{
+    float x, y;
+};
+
+struct WtMark
+{
+};
+
+struct WtLabel
+{
+    std::string text;
+};
+
+struct WtNote
+{
+    std::string text;
+};
+
+struct WtPin
+{
+    float x, y;
+};
+
+struct WtPeg
+{
+    float x, y;
+};
+
+struct WtScroll
+{
+    std::string text;
+};
+
+namespace bent
+{
+    template <>
+    struct ComponentMembership<WtQuest>
+    {
+        using type = CompressedMembership;
+    };
+
+    template <>
+    struct ComponentStorage<WtBody>
+    {
+        using type = PackedComponentPool<WtBody>;
+    };
+
+    template <>
+    struct ComponentStorage<WtMotion>
+    {
+        using type = PackedComponentPool<WtMotion>;
+    };
+
+    template <>
+    struct ComponentChanges<WtHealth>
+    {
+        using type = TrackedChanges;
+    };
+
+    template <>
+    struct ComponentStorage<WtStamina>
+    {
+        using type = PackedComponentPool<WtStamina>;
+    };
+
+    template <>
+    struct ComponentChanges<WtStamina>
+    {
+        using type = TrackedChanges;
+    };
+}
+
 TEST_CASE("World is good", "[world]")
 {
     bent::World world;
@@ -54,3 +171,1264 @@ TEST_CASE("World is good", "[world]")
         REQUIRE(it == view.end());
     }
 }
+
+TEST_CASE("World iterates components by each", "[world]")
+{
+    bent::World pools;
+    bent::World archetypes(bent::StorageBackend::Archetypes);
+
+    for (auto world : { &pools, &archetypes })
+    {
+        auto e1 = world->Create();
+        auto e2 = world->Create();
+        auto e3 = world->Create();
+
+        e1.Add<WtPosition>(10.0f, 20.0f);
+        e2.Add<WtPosition>(15.0f, 25.0f);
+        e3.Add<WtPosition>(20.0f, 30.0f);
+
+        e1.Add<WtVelocity>(1.0f, 2.0f);
+        e3.Add<WtVelocity>(3.0f, 4.0f);
+        e3.Add<WtFlag>();
+
+        std::size_t count = 0;
+        world->each<WtPosition, WtVelocity>([&](bent::EntityHandle entity, WtPosition& pos, WtVelocity& vel)
+        {
+            REQUIRE((entity == e1 || entity == e3));
+            pos.x += vel.x;
+            pos.y += vel.y;
+            ++count;
+        });
+        REQUIRE(count == 2);
+        REQUIRE(e1.Get<WtPosition>()->x == 11.0f);
+        REQUIRE(e2.Get<WtPosition>()->x == 15.0f);
+        REQUIRE(e3.Get<WtPosition>()->y == 34.0f);
+
+        count = 0;
+        world->each<>([&](bent::EntityHandle)
+        {
+            ++count;
+        });
+        REQUIRE(count == 3);
+    }
+}
+
+TEST_CASE("World iterates components by parallel_each", "[world]")
+{
+    bent::ThreadPool::instance().Resize(4);
+
+    bent::World pools;
+    bent::World archetypes(bent::StorageBackend::Archetypes);
+
+    for (auto world : { &pools, &archetypes })
+    {
+        std::vector<bent::EntityHandle> entities;
+        for (int i = 0; i < 5000; i++)
+        {
+            auto entity = world->Create();
+            entity.Add<WtPosition>(float(i), 0.0f);
+            if (i % 3 == 0)
+            {
+                entity.Add<WtVelocity>(1.0f, 2.0f);
+            }
+            entities.push_back(entity);
+        }
+
+        std::atomic<int> count(0);
+        world->parallel_each<WtPosition, WtVelocity>([&](bent::EntityHandle, WtPosition& pos, WtVelocity& vel)
+        {
+            pos.x += vel.x;
+            pos.y += vel.y;
+            ++count;
+        }, 100);
+        REQUIRE(count == 1667);
+        for (int i = 0; i < 5000; i++)
+        {
+            REQUIRE(entities[i].Get<WtPosition>()->y == (i % 3 == 0 ? 2.0f : 0.0f));
+        }
+
+        REQUIRE_THROWS_AS(world->parallel_each<WtVelocity>([&](bent::EntityHandle entity, WtVelocity&)
+        {
+            entity.Destroy();
+        }), std::logic_error);
+        REQUIRE_NOTHROW(world->Create());
+    }
+
+    bent::ThreadPool::instance().Resize(bent::ThreadPool::default_concurrency());
+}
+
+TEST_CASE("World creates entities in bulk", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        bent::World world(backend);
+        world.Reserve<WtPosition, WtVelocity>(1000);
+
+        std::vector<bent::EntityHandle> entities;
+        world.Create(1000, std::back_inserter(entities));
+        REQUIRE(entities.size() == 1000);
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            REQUIRE(entities[i].valid());
+            REQUIRE(entities[i].id() == i);
+            entities[i].Add<WtPosition>(float(i), 0.0f);
+        }
+
+        for (std::size_t i = 0; i < 300; i++)
+        {
+            entities[i].Destroy();
+        }
+        std::vector<bent::EntityHandle> reused;
+        world.Create(500, std::back_inserter(reused));
+        REQUIRE(reused.size() == 500);
+        std::vector<std::uint64_t> ids;
+        for (auto& entity : reused)
+        {
+            REQUIRE(entity.valid());
+            REQUIRE(entity.Get<WtPosition>() == nullptr);
+            ids.push_back(entity.id() & 0xffffffff);
+        }
+        std::sort(ids.begin(), ids.end());
+        for (std::size_t i = 0; i < 300; i++)
+        {
+            REQUIRE(ids[i] == i);
+        }
+        for (std::size_t i = 300; i < 500; i++)
+        {
+            REQUIRE(ids[i] == i + 700);
+        }
+
+        std::size_t count = 0;
+        world.each<WtPosition>([&](bent::EntityHandle, WtPosition& pos)
+        {
+            REQUIRE(pos.x >= 300.0f);
+            ++count;
+        });
+        REQUIRE(count == 700);
+    }
+}
+
+TEST_CASE("World destroys entities in bulk", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        bent::World world(backend);
+        std::vector<bent::EntityHandle> entities;
+        world.Create(100, std::back_inserter(entities));
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            entities[i].Add<WtPosition>(float(i), 0.0f);
+            if (i % 2 == 0)
+            {
+                entities[i].Add<WtCounted>();
+            }
+        }
+        REQUIRE(WtCounted::alive == 50);
+
+        std::vector<bent::EntityHandle> doomed(entities.begin(), entities.begin() + 60);
+        doomed.push_back(entities[0]);
+        world.Destroy(doomed);
+        REQUIRE(WtCounted::alive == 20);
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            REQUIRE(entities[i].valid() == (i >= 60));
+        }
+
+        std::size_t count = 0;
+        world.each<WtPosition>([&](bent::EntityHandle, WtPosition& pos)
+        {
+            REQUIRE(pos.x >= 60.0f);
+            ++count;
+        });
+        REQUIRE(count == 40);
+
+        std::vector<bent::EntityHandle> rest(entities.begin() + 60, entities.end());
+        rest.push_back(entities[0]);
+        REQUIRE_THROWS_AS(world.Destroy(rest), std::logic_error);
+        REQUIRE(entities[60].valid());
+
+        rest.pop_back();
+        world.Destroy(rest);
+        REQUIRE(WtCounted::alive == 0);
+        REQUIRE(world.entities_with<WtPosition>().begin() == world.entities_with<WtPosition>().end());
+    }
+}
+
+TEST_CASE("World skips ranges without queried components", "[world]")
+{
+    bent::World world;
+    std::vector<bent::EntityHandle> entities;
+    world.Create(100000, std::back_inserter(entities));
+    for (std::size_t i = 0; i < entities.size(); i++)
+    {
+        entities[i].Add<WtPosition>(float(i), 0.0f);
+        if (i % 1000 == 999 || i == 64 || i == 99999)
+        {
+            entities[i].Add<WtVelocity>(0.0f, 0.0f);
+        }
+    }
+    std::vector<bent::EntityHandle> doomed(entities.begin(), entities.begin() + 50000);
+    world.Destroy(doomed);
+    entities[70999].Remove<WtVelocity>();
+
+    std::vector<float> each;
+    world.each<WtPosition, WtVelocity>([&](bent::EntityHandle, WtPosition& pos, WtVelocity&)
+    {
+        each.push_back(pos.x);
+    });
+    std::vector<float> view;
+    for (auto& entity : world.entities_with<WtPosition, WtVelocity>())
+    {
+        view.push_back(entity.Get<WtPosition>()->x);
+    }
+    std::vector<float> expected;
+    for (std::size_t i = 50000; i < entities.size(); i++)
+    {
+        if ((i % 1000 == 999 || i == 99999) && i != 70999)
+        {
+            expected.push_back(float(i));
+        }
+    }
+    REQUIRE(each == expected);
+    REQUIRE(view == expected);
+}
+
+TEST_CASE("World evaluates queries by column bitmaps", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        bent::World rows(backend);
+        bent::World columns(backend, bent::MaskLayout::Columns);
+        for (auto world : { &rows, &columns })
+        {
+            std::vector<bent::EntityHandle> entities;
+            world->Create(1000, std::back_inserter(entities));
+            for (std::size_t i = 0; i < entities.size(); i++)
+            {
+                entities[i].Add<WtPosition>(float(i), 0.0f);
+                if (i % 3 == 0)
+                {
+                    entities[i].Add<WtVelocity>(0.0f, 0.0f);
+                }
+            }
+            std::vector<bent::EntityHandle> doomed(entities.begin() + 100, entities.begin() + 200);
+            world->Destroy(doomed);
+            entities[300].Destroy();
+            entities[303].Remove<WtVelocity>();
+            world->Create().Add<WtVelocity>(0.0f, 0.0f);
+
+            std::vector<float> view;
+            for (auto& entity : world->entities_with<WtPosition, WtVelocity>())
+            {
+                view.push_back(entity.Get<WtPosition>()->x);
+            }
+            std::sort(view.begin(), view.end());
+            std::vector<float> expected;
+            for (std::size_t i = 0; i < entities.size(); i++)
+            {
+                if (i % 3 == 0 && (i < 100 || i >= 200) && i != 300 && i != 303)
+                {
+                    expected.push_back(float(i));
+                }
+            }
+            REQUIRE(view == expected);
+            REQUIRE((world->count<WtPosition, WtVelocity>() == expected.size()));
+            REQUIRE(world->count<WtPosition>() == 899);
+            REQUIRE(world->count<WtVelocity>() == expected.size() + 1);
+            REQUIRE(world->count<>() == 900);
+        }
+    }
+}
+
+TEST_CASE("World evaluates queries of compressed components", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+        {
+            bent::World world(backend, layout);
+            std::vector<bent::EntityHandle> entities;
+            world.Create(300000, std::back_inserter(entities));
+            std::vector<int> expected;
+            for (std::size_t i = 0; i < entities.size(); i++)
+            {
+                if (i % 2 == 0)
+                {
+                    entities[i].Add<WtPosition>(float(i), 0.0f);
+                }
+                // a run of 6000 owners in one range, and a few owners elsewhere.
+                if (i % 40000 == 8 || (i >= 200000 && i < 206000))
+                {
+                    entities[i].Add<WtQuest>(WtQuest { int(i) });
+                }
+            }
+            entities[203000].Remove<WtQuest>();
+            entities[120008].Destroy();
+            for (int i = 0; i < 300000; i += 2)
+            {
+                if ((i % 40000 == 8 || (i >= 200000 && i < 206000)) && i != 203000 && i != 120008)
+                {
+                    expected.push_back(i);
+                }
+            }
+
+            std::vector<int> view;
+            for (auto& entity : world.entities_with<WtPosition, WtQuest>())
+            {
+                view.push_back(entity.Get<WtQuest>()->step);
+            }
+            std::sort(view.begin(), view.end());
+            std::vector<int> each;
+            world.each<WtPosition, WtQuest>([&](bent::EntityHandle, WtPosition&, WtQuest& quest)
+            {
+                each.push_back(quest.step);
+            });
+            std::sort(each.begin(), each.end());
+            REQUIRE(view == expected);
+            REQUIRE(each == expected);
+            REQUIRE((world.count<WtPosition, WtQuest>() == expected.size()));
+            REQUIRE(world.count<WtQuest>() == 6005);
+        }
+    }
+}
+
+TEST_CASE("World keeps tag components as mask bits", "[world]")
+{
+    REQUIRE(bent::IsTagComponent<WtFlag>::value);
+    REQUIRE(!bent::IsTagComponent<WtCounted>::value);
+    REQUIRE(!bent::IsTagComponent<WtPosition>::value);
+
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        bent::World world(backend);
+        std::vector<bent::EntityHandle> entities;
+        world.Create(10, std::back_inserter(entities));
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            entities[i].Add<WtPosition>(float(i), 0.0f);
+            if (i % 2 == 0)
+            {
+                entities[i].Add<WtFlag>();
+            }
+        }
+        REQUIRE(entities[0].Get<WtFlag>() == &bent::TagInstance<WtFlag>());
+        REQUIRE(entities[2].Get<WtFlag>() == entities[0].Get<WtFlag>());
+        REQUIRE(entities[1].Get<WtFlag>() == nullptr);
+        REQUIRE_THROWS_AS(entities[0].Add<WtFlag>(), std::out_of_range);
+
+        entities[4].Remove<WtFlag>();
+        REQUIRE(entities[4].Get<WtFlag>() == nullptr);
+        REQUIRE(entities[4].Get<WtPosition>()->x == 4.0f);
+        REQUIRE_THROWS_AS(entities[4].Remove<WtFlag>(), std::out_of_range);
+        entities[6].Destroy();
+
+        std::vector<float> each;
+        world.each<WtPosition, WtFlag>([&](bent::EntityHandle, WtPosition& pos, WtFlag& flag)
+        {
+            REQUIRE(&flag == &bent::TagInstance<WtFlag>());
+            each.push_back(pos.x);
+        });
+        std::sort(each.begin(), each.end());
+        REQUIRE(each == (std::vector<float> { 0.0f, 2.0f, 8.0f }));
+        REQUIRE(world.count<WtFlag>() == 3);
+
+        std::vector<bent::EntityHandle> doomed { entities[0], entities[1] };
+        world.Destroy(doomed);
+        REQUIRE(world.count<WtFlag>() == 2);
+        entities[1] = world.Create();
+        entities[1].Add<WtFlag>();
+        REQUIRE(entities[1].Get<WtFlag>() != nullptr);
+        REQUIRE(world.count<WtFlag>() == 3);
+    }
+}
+
+TEST_CASE("World queries entities with, without and optionally with components", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+        {
+            bent::World world(backend, layout);
+            std::vector<bent::EntityHandle> entities;
+            world.Create(300, std::back_inserter(entities));
+            for (std::size_t i = 0; i < entities.size(); i++)
+            {
+                if (i % 2 == 0)
+                {
+                    entities[i].Add<WtPosition>(float(i), 0.0f);
+                }
+                if (i % 3 == 0)
+                {
+                    entities[i].Add<WtVelocity>(float(i), 1.0f);
+                }
+                if (i % 5 == 0)
+                {
+                    entities[i].Add<WtFlag>();
+                }
+            }
+            entities[12].Destroy();
+
+            // positions without flags, with velocities when they have them.
+            std::vector<float> each;
+            std::size_t moving = 0;
+            world.query<bent::Optional<WtVelocity>, bent::Without<WtFlag>, bent::With<WtPosition>>().each([&](bent::EntityHandle entity, WtPosition& pos, WtVelocity* vel)
+            {
+                REQUIRE(vel == entity.Get<WtVelocity>());
+                moving += vel != nullptr;
+                each.push_back(pos.x);
+            });
+            std::sort(each.begin(), each.end());
+            std::vector<float> expected;
+            std::size_t expected_moving = 0;
+            for (std::size_t i = 0; i < entities.size(); i += 2)
+            {
+                if (i % 5 != 0 && i != 12)
+                {
+                    expected.push_back(float(i));
+                    expected_moving += i % 3 == 0;
+                }
+            }
+            REQUIRE(each == expected);
+            REQUIRE(moving == expected_moving);
+
+            auto query = world.query<bent::With<WtPosition>, bent::Without<WtFlag>>();
+            std::vector<float> view;
+            for (auto& entity : query)
+            {
+                view.push_back(entity.Get<WtPosition>()->x);
+            }
+            std::sort(view.begin(), view.end());
+            REQUIRE(view == expected);
+            REQUIRE(query.count() == expected.size());
+
+            std::atomic<int> parallel(0);
+            world.query<bent::With<WtPosition>, bent::Without<WtFlag>>().parallel_each([&](bent::EntityHandle, WtPosition&)
+            {
+                ++parallel;
+            }, 16);
+            REQUIRE(parallel == int(expected.size()));
+
+            // entities without positions, including ones without any component.
+            std::size_t optional = 0;
+            std::size_t count = 0;
+            world.query<bent::Without<WtPosition>, bent::Optional<WtVelocity>>().each([&](bent::EntityHandle entity, WtVelocity* vel)
+            {
+                REQUIRE(vel == entity.Get<WtVelocity>());
+                optional += vel != nullptr;
+                ++count;
+            });
+            REQUIRE(count == 150);
+            REQUIRE(optional == 50);
+            REQUIRE(world.query<bent::Without<WtPosition>>().count() == 150);
+            REQUIRE((world.query<bent::With<WtPosition, WtVelocity>, bent::Without<WtFlag>>().count() == expected_moving));
+        }
+    }
+}
+
+TEST_CASE("World queries components added or changed since a tick", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+        {
+            bent::World world(backend, layout);
+            std::vector<bent::EntityHandle> entities;
+            world.Create(200, std::back_inserter(entities));
+            for (std::size_t i = 0; i < entities.size(); i += 2)
+            {
+                entities[i].Add<WtHealth>(WtHealth { 10 });
+            }
+            REQUIRE(world.query<bent::Changed<WtHealth>>().count() == 100);
+            auto last_run = world.Tick();
+
+            for (std::size_t i = 1; i < 20; i += 2)
+            {
+                entities[i].Add<WtHealth>(WtHealth { 5 });
+            }
+            REQUIRE(world.query<bent::Added<WtHealth>>(last_run).count() == 10);
+            REQUIRE(world.query<bent::Changed<WtHealth>>(last_run).count() == 10);
+
+            // mutable access and patches count as changes, reading doesn't.
+            entities[40].Get<WtHealth>()->hp = 1;
+            entities[100].Patch<WtHealth>();
+            const bent::EntityHandle & reader = entities[160];
+            REQUIRE(reader.Get<WtHealth>()->hp == 10);
+            REQUIRE_THROWS_AS(entities[21].Patch<WtHealth>(), std::out_of_range);
+
+            std::vector<int> changed;
+            world.query<bent::With<WtHealth>, bent::Changed<WtHealth>>(last_run).each([&](bent::EntityHandle entity, WtHealth& health)
+            {
+                REQUIRE(entity.Get<WtHealth>() == &health);
+                changed.push_back(health.hp);
+            });
+            std::sort(changed.begin(), changed.end());
+            std::vector<int> expected(10, 5);
+            expected.insert(expected.begin(), 1);
+            expected.push_back(10);
+            REQUIRE(changed == expected);
+            REQUIRE((world.query<bent::Added<WtHealth>, bent::Changed<WtHealth>>(last_run).count() == 10));
+
+            last_run = world.Tick();
+            REQUIRE(world.query<bent::Changed<WtHealth>>(last_run).count() == 0);
+
+            // references handed out by each and queries count as changes, too.
+            world.each<WtHealth>([&](bent::EntityHandle, WtHealth& health)
+            {
+                health.hp++;
+            });
+            REQUIRE(world.query<bent::Changed<WtHealth>>(last_run).count() == world.count<WtHealth>());
+            last_run = world.Tick();
+            world.query<bent::With<WtHealth>>().parallel_each([&](bent::EntityHandle, WtHealth& health)
+            {
+                health.hp++;
+            }, 16);
+            REQUIRE(world.query<bent::Changed<WtHealth>>(last_run).count() == world.count<WtHealth>());
+            last_run = world.Tick();
+            world.query<bent::Optional<WtHealth>>().each([&](bent::EntityHandle, WtHealth*)
+            {
+            });
+            REQUIRE(world.query<bent::Changed<WtHealth>>(last_run).count() == world.count<WtHealth>());
+            last_run = world.Tick();
+
+            entities[150].Remove<WtHealth>();
+            entities[150].Add<WtHealth>(WtHealth { 0 });
+            entities[198].Get<WtHealth>();
+            std::vector<bent::EntityHandle> found;
+            for (auto& entity : world.query<bent::Changed<WtHealth>, bent::Without<WtPosition>>(last_run))
+            {
+                found.push_back(entity);
+            }
+            REQUIRE(found.size() == 2);
+            REQUIRE(std::count(found.begin(), found.end(), entities[150]) == 1);
+            REQUIRE(std::count(found.begin(), found.end(), entities[198]) == 1);
+            REQUIRE(world.query<bent::Added<WtHealth>>(last_run).count() == 1);
+
+            std::atomic<int> parallel(0);
+            world.query<bent::Changed<WtHealth>>(last_run).parallel_each([&](bent::EntityHandle)
+            {
+                ++parallel;
+            }, 16);
+            REQUIRE(parallel == 2);
+        }
+    }
+}
+
+TEST_CASE("World stamps changes from parallel_each", "[world]")
+{
+    bent::ThreadPool::instance().Resize(4);
+
+    bent::World world;
+    std::vector<bent::EntityHandle> entities;
+    world.Create(1000, std::back_inserter(entities));
+    for (auto & entity : entities)
+    {
+        entity.Add<WtStamina>(WtStamina { 0 });
+    }
+    auto last_run = world.Tick();
+
+    // tasks over packed owners split blocks of 64 entities, which share a block tick.
+    world.parallel_each<WtStamina>([&](bent::EntityHandle entity, WtStamina&)
+    {
+        entity.Get<WtStamina>()->points++;
+    }, 16);
+    REQUIRE(world.query<bent::Changed<WtStamina>>(last_run).count() == 1000);
+    for (auto & entity : entities)
+    {
+        REQUIRE(entity.Get<WtStamina>()->points == 1);
+    }
+
+    bent::ThreadPool::instance().Resize(bent::ThreadPool::default_concurrency());
+}
+
+TEST_CASE("World delivers component events to observers in batches", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        bent::World world(backend);
+        std::vector<std::vector<std::uint64_t>> added, removed, destroyed;
+        auto collect = [](std::vector<std::vector<std::uint64_t>> & batches)
+        {
+            return [&batches](const std::uint64_t * ids, std::size_t count)
+            {
+                batches.emplace_back(ids, ids + count);
+            };
+        };
+        world.Observe<WtPosition>(bent::ComponentEvent::Add, collect(added));
+        world.Observe<WtPosition>(bent::ComponentEvent::Remove, collect(removed));
+        world.Observe<WtPosition>(bent::ComponentEvent::Destroy, collect(destroyed));
+
+        std::vector<bent::EntityHandle> entities;
+        world.Create(10, std::back_inserter(entities));
+        std::vector<std::uint64_t> ids;
+        for (auto& entity : entities)
+        {
+            entity.Add<WtPosition>(0.0f, 0.0f);
+            entity.Add<WtVelocity>(0.0f, 0.0f);
+            ids.push_back(entity.id());
+        }
+        REQUIRE(added.empty());
+        world.NotifyObservers();
+        REQUIRE(added.size() == 1);
+        REQUIRE(added[0] == ids);
+        world.NotifyObservers();
+        REQUIRE(added.size() == 1);
+
+        // runs of the same event come in order, and velocities aren't observed.
+        entities[1].Remove<WtPosition>();
+        entities[2].Remove<WtPosition>();
+        entities[2].Remove<WtVelocity>();
+        entities[1].Add<WtPosition>(1.0f, 1.0f);
+        entities[3].Destroy();
+        world.Destroy(std::vector<bent::EntityHandle> { entities[4], entities[5] });
+        world.NotifyObservers();
+        REQUIRE(removed.size() == 1);
+        REQUIRE((removed[0] == std::vector<std::uint64_t> { ids[1], ids[2] }));
+        REQUIRE(added.size() == 2);
+        REQUIRE((added[1] == std::vector<std::uint64_t> { ids[1] }));
+        REQUIRE(destroyed.size() == 1);
+        REQUIRE((destroyed[0] == std::vector<std::uint64_t> { ids[3], ids[4], ids[5] }));
+
+        // command buffers notify once applied, and events of observers wait for the next notification.
+        world.Observe<WtPosition>(bent::ComponentEvent::Add, [&](const std::uint64_t * ids, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; i++)
+            {
+                world.entity(ids[i]).Remove<WtPosition>();
+            }
+        });
+        bent::CommandBuffer buffer;
+        buffer.Add<WtPosition>(entities[2], 2.0f, 2.0f);
+        buffer.Destroy(entities[6]);
+        world.Flush(buffer);
+        REQUIRE(added.size() == 3);
+        REQUIRE((added[2] == std::vector<std::uint64_t> { ids[2] }));
+        REQUIRE(destroyed.size() == 2);
+        REQUIRE((destroyed[1] == std::vector<std::uint64_t> { ids[6] }));
+        REQUIRE(removed.size() == 1);
+        REQUIRE(!entities[2].Get<WtPosition>());
+        world.NotifyObservers();
+        REQUIRE(removed.size() == 2);
+        REQUIRE((removed[1] == std::vector<std::uint64_t> { ids[2] }));
+    }
+}
+
+TEST_CASE("World forks sharing components until written", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+        {
+            bent::World world(backend, layout);
+            std::vector<bent::EntityHandle> entities;
+            world.Create(3000, std::back_inserter(entities));
+            for (std::size_t i = 0; i < entities.size(); i++)
+            {
+                entities[i].Add<WtPosition>(float(i), 0.0f);
+                if (i % 2 == 0)
+                {
+                    entities[i].Add<WtCounted>();
+                    entities[i].Add<WtFlag>();
+                }
+                if (i % 3 == 0)
+                {
+                    entities[i].Add<WtBody>(WtBody { float(i), 0.0f });
+                }
+            }
+            entities[7].Destroy();
+            auto cached = world.cached_query<bent::With<WtPosition>, bent::Without<WtFlag>>();
+            REQUIRE(cached.count() == 1499);
+            auto alive = WtCounted::alive;
+
+            auto fork = world.Fork();
+            REQUIRE(WtCounted::alive == alive + 1500);
+            REQUIRE(fork->count<WtPosition>() == 2999);
+            REQUIRE((fork->count<WtBody, WtFlag>() == 500));
+            REQUIRE((fork->cached_query<bent::With<WtPosition>, bent::Without<WtFlag>>().count() == 1499));
+            REQUIRE_THROWS_AS(fork->entity(entities[7].id()), std::out_of_range);
+
+            // reading every component leaves blocks shared, at the same addresses in both worlds.
+            if (backend == bent::StorageBackend::ComponentPools)
+            {
+                for (const auto & entity : entities)
+                {
+                    if (entity.valid())
+                    {
+                        const auto reader = fork->entity(entity.id());
+                        REQUIRE(reader.Get<WtPosition>() == entity.Get<WtPosition>());
+                    }
+                }
+            }
+
+            // writes to either world aren't seen by the other.
+            auto forked = fork->entity(entities[12].id());
+            forked.Get<WtPosition>()->x = -1.0f;
+            forked.Get<WtBody>()->y = -1.0f;
+            REQUIRE(entities[12].Get<WtPosition>()->x == 12.0f);
+            REQUIRE(entities[12].Get<WtBody>()->y == 0.0f);
+            entities[11].Get<WtPosition>()->x = -2.0f;
+            REQUIRE(fork->entity(entities[11].id()).Get<WtPosition>()->x == 11.0f);
+            fork->each<WtPosition>([](bent::EntityHandle, WtPosition& pos)
+            {
+                pos.y = 1.0f;
+            });
+            float sum = 0.0f;
+            world.each<WtPosition>([&](bent::EntityHandle, WtPosition& pos)
+            {
+                sum += pos.y;
+            });
+            REQUIRE(sum == 0.0f);
+
+            // structure changes independently, and so do cached queries.
+            forked.Remove<WtFlag>();
+            forked.Remove<WtCounted>();
+            fork->entity(entities[20].id()).Destroy();
+            fork->Create().Add<WtPosition>(0.0f, 0.0f);
+            REQUIRE(fork->count<WtPosition>() == 2999);
+            REQUIRE((fork->cached_query<bent::With<WtPosition>, bent::Without<WtFlag>>().count() == 1501));
+            REQUIRE(cached.count() == 1499);
+            REQUIRE(world.count<WtPosition>() == 2999);
+            REQUIRE(entities[20].valid());
+            REQUIRE(entities[12].Get<WtCounted>() != nullptr);
+
+            // forks of forks, outliving the origin of their blocks.
+            auto second = fork->Fork();
+            fork.reset();
+            REQUIRE(second->entity(entities[12].id()).Get<WtPosition>()->x == -1.0f);
+            REQUIRE(second->entity(entities[12].id()).Get<WtPosition>()->y == 1.0f);
+            second.reset();
+            REQUIRE(entities[12].Get<WtPosition>()->y == 0.0f);
+
+            REQUIRE_THROWS_AS(world.parallel_each<WtPosition>([&](bent::EntityHandle, WtPosition&)
+            {
+                world.Fork();
+            }), std::logic_error);
+        }
+    }
+}
+
+TEST_CASE("World keeps cached queries up to date", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        bent::World world(backend);
+        std::vector<bent::EntityHandle> entities;
+        world.Create(200, std::back_inserter(entities));
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            entities[i].Add<WtPosition>(float(i), 0.0f);
+            if (i % 2 == 0)
+            {
+                entities[i].Add<WtVelocity>(0.0f, 0.0f);
+            }
+        }
+
+        auto moving = world.cached_query<bent::With<WtPosition, WtVelocity>, bent::Without<WtFlag>>();
+        auto bare = world.cached_query<bent::Without<WtPosition>, bent::Optional<WtVelocity>>();
+        REQUIRE(moving.count() == 100);
+        REQUIRE(bare.count() == 0);
+
+        entities[0].Add<WtFlag>();
+        entities[1].Add<WtVelocity>(0.0f, 0.0f);
+        entities[2].Remove<WtVelocity>();
+        entities[4].Destroy();
+        entities[5].Remove<WtPosition>();
+        std::vector<bent::EntityHandle> doomed { entities[6], entities[7] };
+        world.Destroy(doomed);
+        auto created = world.Create();
+        auto spawned = world.Create();
+        spawned.Add<WtVelocity>(0.0f, 0.0f);
+        spawned.Add<WtPosition>(-1.0f, 0.0f);
+
+        auto check = [&]
+        {
+            std::vector<float> cached;
+            world.cached_query<bent::With<WtPosition, WtVelocity>, bent::Without<WtFlag>>().each([&](bent::EntityHandle entity, WtPosition& pos, WtVelocity&)
+            {
+                REQUIRE(entity.Get<WtFlag>() == nullptr);
+                cached.push_back(pos.x);
+            });
+            std::sort(cached.begin(), cached.end());
+            std::vector<float> scanned;
+            world.query<bent::With<WtPosition, WtVelocity>, bent::Without<WtFlag>>().each([&](bent::EntityHandle, WtPosition& pos, WtVelocity&)
+            {
+                scanned.push_back(pos.x);
+            });
+            std::sort(scanned.begin(), scanned.end());
+            REQUIRE(cached == scanned);
+            REQUIRE(moving.count() == scanned.size());
+        };
+        check();
+        REQUIRE(moving.count() == 98);
+
+        std::vector<bent::EntityHandle> handles;
+        for (auto& entity : bare)
+        {
+            handles.push_back(entity);
+        }
+        REQUIRE(handles.size() == 2);
+        REQUIRE(bare.count() == 2);
+        std::size_t velocities = 0;
+        bare.each([&](bent::EntityHandle entity, WtVelocity* vel)
+        {
+            REQUIRE((entity == entities[5] || entity == created));
+            velocities += vel != nullptr;
+        });
+        REQUIRE(velocities == 0);
+
+        // iterating may remove the current entity from the query.
+        for (auto& entity : moving)
+        {
+            if (entity.Get<WtPosition>()->x < 50.0f)
+            {
+                entity.Add<WtFlag>();
+            }
+        }
+        check();
+        REQUIRE(moving.count() == 75);
+    }
+}
+
+TEST_CASE("World keeps entities of owning groups packed at the front", "[world]")
+{
+    for (auto backend : { bent::StorageBackend::ComponentPools, bent::StorageBackend::Archetypes })
+    {
+        bent::World world(backend);
+        std::vector<bent::EntityHandle> entities;
+        world.Create(3000, std::back_inserter(entities));
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            if (i % 2 == 0)
+            {
+                entities[i].Add<WtBody>(WtBody { float(i), 0.0f });
+            }
+            if (i % 3 == 0)
+            {
+                entities[i].Add<WtMotion>(WtMotion { 1.0f, float(i) });
+            }
+        }
+        auto group = world.group<WtBody, WtMotion>();
+        REQUIRE(group.size() == 500);
+
+        entities[0].Remove<WtMotion>();
+        entities[1].Add<WtBody>(WtBody { 1.0f, 0.0f });
+        entities[1].Add<WtMotion>(WtMotion { 1.0f, 1.0f });
+        entities[6].Remove<WtBody>();
+        entities[12].Destroy();
+        std::vector<bent::EntityHandle> doomed { entities[18], entities[20], entities[24] };
+        world.Destroy(doomed);
+        entities[20] = world.Create();
+        entities[20].Add<WtMotion>(WtMotion { 1.0f, 20.0f });
+        entities[20].Add<WtBody>(WtBody { 20.0f, 0.0f });
+        REQUIRE((world.group<WtBody, WtMotion>().size() == 497));
+
+        // each pair is of the same entity, whose components of the group are all moved.
+        std::vector<float> each;
+        group.each([&](WtBody& body, WtMotion& motion)
+        {
+            REQUIRE(body.x == motion.y);
+            body.x += motion.x;
+            each.push_back(motion.y);
+        });
+        std::sort(each.begin(), each.end());
+        std::vector<float> expected;
+        world.each<WtBody, WtMotion>([&](bent::EntityHandle, WtBody& body, WtMotion& motion)
+        {
+            REQUIRE(body.x == motion.y + 1.0f);
+            expected.push_back(motion.y);
+        });
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(each == expected);
+        REQUIRE(each.size() == 497);
+        REQUIRE(entities[1].Get<WtBody>()->x == 2.0f);
+        REQUIRE(entities[30].Get<WtBody>()->x == 31.0f);
+        REQUIRE(entities[4].Get<WtBody>()->x == 4.0f);
+
+        if (backend == bent::StorageBackend::ComponentPools)
+        {
+            REQUIRE_THROWS_AS(world.group<WtBody>(), std::logic_error);
+
+            // tracked components walked by reference count as changes.
+            for (std::size_t i = 0; i < 100; i++)
+            {
+                entities[2000 + i].Add<WtStamina>(WtStamina { 0 });
+            }
+            auto last_run = world.Tick();
+            world.group<WtStamina>().each([](WtStamina & stamina)
+            {
+                stamina.points++;
+            });
+            REQUIRE(world.query<bent::Changed<WtStamina>>(last_run).count() == 100);
+        }
+    }
+}
+
+TEST_CASE("World sorts packed components", "[world]")
+{
+    bent::World world;
+    std::vector<bent::EntityHandle> entities;
+    world.Create(100, std::back_inserter(entities));
+    for (std::size_t i = 0; i < entities.size(); i++)
+    {
+        entities[i].Add<WtBody>(WtBody { float(i * 37 % 100), 0.0f });
+        if (i % 2 == 0)
+        {
+            entities[i].Add<WtMotion>(WtMotion { 0.0f, float(i) });
+        }
+    }
+    auto bodies = [&]
+    {
+        std::vector<float> xs;
+        world.each<WtBody>([&](bent::EntityHandle, WtBody& body)
+        {
+            xs.push_back(body.x);
+        });
+        return xs;
+    };
+    auto by_x = [](const WtBody & lhs, const WtBody & rhs)
+    {
+        return lhs.x < rhs.x;
+    };
+
+    world.sort<WtBody>(by_x);
+    auto xs = bodies();
+    REQUIRE(xs.size() == 100);
+    REQUIRE(std::is_sorted(xs.begin(), xs.end()));
+    std::vector<float> view;
+    for (auto& entity : world.entities_with<WtBody>())
+    {
+        view.push_back(entity.Get<WtBody>()->x);
+    }
+    REQUIRE(std::is_sorted(view.rbegin(), view.rend()));
+    REQUIRE(entities[3].Get<WtBody>()->x == 11.0f);
+
+    // a few entities move between frames.
+    entities[10].Get<WtBody>()->x = 45.5f;
+    entities[20].Get<WtBody>()->x = -1.0f;
+    world.sort<WtBody>(by_x, bent::SortAlgorithm::Insertion);
+    xs = bodies();
+    REQUIRE(std::is_sorted(xs.begin(), xs.end()));
+    REQUIRE(xs.front() == -1.0f);
+    REQUIRE(entities[10].Get<WtBody>()->x == 45.5f);
+
+    // motions follow bodies of the same entities.
+    world.sort<WtBody, WtMotion>();
+    std::vector<float> motions;
+    world.each<WtMotion>([&](bent::EntityHandle entity, WtMotion&)
+    {
+        motions.push_back(entity.Get<WtBody>()->x);
+    });
+    REQUIRE(motions.size() == 50);
+    REQUIRE(std::is_sorted(motions.begin(), motions.end()));
+
+    // in a group, members and others are sorted apart, and motions of members move along.
+    auto group = world.group<WtBody, WtMotion>();
+    world.sort<WtBody>([](const WtBody & lhs, const WtBody & rhs)
+    {
+        return lhs.x > rhs.x;
+    });
+    std::vector<float> grouped;
+    group.each([&](WtBody& body, WtMotion& motion)
+    {
+        REQUIRE(entities[std::size_t(motion.y)].Get<WtBody>() == &body);
+        grouped.push_back(body.x);
+    });
+    REQUIRE(grouped.size() == 50);
+    REQUIRE(std::is_sorted(grouped.rbegin(), grouped.rend()));
+    xs = bodies();
+    REQUIRE(std::is_sorted(xs.rbegin(), xs.rbegin() + 50));
+    REQUIRE(std::is_sorted(xs.rbegin() + 50, xs.rend()));
+
+    bent::World archetypes(bent::StorageBackend::Archetypes);
+    archetypes.Create().Add<WtBody>(WtBody { 0.0f, 0.0f });
+    REQUIRE_THROWS_AS(archetypes.sort<WtBody>(by_x), std::logic_error);
+}
+
+TEST_CASE("World saves and loads snapshots", "[world]")
+{
+    bent::RegisterComponent<WtPoint>("WtPoint");
+    bent::RegisterComponent<WtMark>("WtMark");
+    bent::RegisterComponent<WtBody>("WtBody");
+    bent::RegisterComponent<WtQuest>("WtQuest");
+    bent::RegisterComponent<WtHealth>("WtHealth");
+    bent::RegisterComponent<WtLabel>("WtLabel");
+    bent::RegisterComponent<WtNote>("WtNote");
+    bent::RegisterSerializer<WtLabel>([](const WtLabel & label, std::string & out)
+    {
+        out += label.text;
+    }, [](const char * data, std::size_t size)
+    {
+        return WtLabel { std::string(data, size) };
+    });
+    const char * path = "bent_world_test.snapshot";
+
+    for (auto layout : { bent::MaskLayout::Rows, bent::MaskLayout::Columns })
+    {
+        bent::World world(bent::StorageBackend::ComponentPools, layout);
+        std::vector<bent::EntityHandle> entities;
+        world.Create(5000, std::back_inserter(entities));
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            entities[i].Add<WtPoint>(WtPoint { float(i), -float(i) });
+            if (i % 2 == 0)
+            {
+                entities[i].Add<WtMark>();
+            }
+            if (i % 3 == 0)
+            {
+                entities[i].Add<WtBody>(WtBody { float(i), 1.0f });
+            }
+            if (i % 1000 == 1)
+            {
+                entities[i].Add<WtQuest>(WtQuest { int(i) });
+            }
+            if (i % 5 == 0)
+            {
+                entities[i].Add<WtHealth>(WtHealth { int(i) });
+            }
+            if (i % 7 == 0)
+            {
+                entities[i].Add<WtLabel>(WtLabel { "e" + std::to_string(i) });
+            }
+        }
+        entities[9].Destroy();
+        entities[4000].Destroy();
+        entities[4000] = world.Create();
+        entities[4000].Add<WtPoint>(WtPoint { -1.0f, -1.0f });
+        entities[21].Destroy();
+        world.Tick();
+        auto tick = world.Tick();
+        world.SaveSnapshot(path);
+
+        bent::World loaded(bent::StorageBackend::ComponentPools, layout);
+        auto cached = loaded.cached_query<bent::With<WtBody>, bent::Without<WtMark>>();
+        std::size_t labels_added = 0;
+        loaded.Observe<WtLabel>(bent::ComponentEvent::Add, [&](const std::uint64_t *, std::size_t count)
+        {
+            labels_added += count;
+        });
+        loaded.LoadSnapshot(path);
+        REQUIRE(loaded.count<WtPoint>() == 4998);
+        REQUIRE(loaded.count<WtMark>() == world.count<WtMark>());
+        REQUIRE((loaded.count<WtBody, WtMark>() == world.count<WtBody, WtMark>()));
+        REQUIRE(loaded.count<WtQuest>() == 5);
+        REQUIRE(loaded.count<WtHealth>() == world.count<WtHealth>());
+        REQUIRE(loaded.count<WtLabel>() == world.count<WtLabel>());
+        REQUIRE((cached.count() == world.cached_query<bent::With<WtBody>, bent::Without<WtMark>>().count()));
+        for (std::size_t i = 0; i < entities.size(); i++)
+        {
+            if (!entities[i].valid())
+            {
+                REQUIRE_THROWS_AS(loaded.entity(entities[i].id()), std::out_of_range);
+                continue;
+            }
+            auto entity = loaded.entity(entities[i].id());
+            REQUIRE(entity.Get<WtPoint>()->x == entities[i].Get<WtPoint>()->x);
+            REQUIRE(entity.Get<WtPoint>()->y == entities[i].Get<WtPoint>()->y);
+            REQUIRE((entity.Get<WtMark>() != nullptr) == (entities[i].Get<WtMark>() != nullptr));
+            if (auto body = entities[i].Get<WtBody>())
+            {
+                REQUIRE(entity.Get<WtBody>()->x == body->x);
+            }
+            if (auto quest = entities[i].Get<WtQuest>())
+            {
+                REQUIRE(entity.Get<WtQuest>()->step == quest->step);
+            }
+            if (auto label = entities[i].Get<WtLabel>())
+            {
+                REQUIRE(entity.Get<WtLabel>()->text == label->text);
+            }
+        }
+        REQUIRE(loaded.change_tick() == world.change_tick());
+        REQUIRE(loaded.query<bent::Added<WtHealth>>(tick).count() == loaded.count<WtHealth>());
+        REQUIRE(loaded.Create().id() == world.Create().id());
+        loaded.NotifyObservers();
+        REQUIRE(labels_added == loaded.count<WtLabel>());
+
+        // writes to a loaded world don't reach the file.
+        loaded.entity(entities[2].id()).Get<WtPoint>()->x = 100.0f;
+        loaded.each<WtPoint>([](bent::EntityHandle, WtPoint & point)
+        {
+            point.y = 0.0f;
+        });
+        bent::World again(bent::StorageBackend::ComponentPools, layout);
+        again.LoadSnapshot(path);
+        REQUIRE(again.entity(entities[2].id()).Get<WtPoint>()->x == 2.0f);
+        REQUIRE(again.entity(entities[2].id()).Get<WtPoint>()->y == -2.0f);
+        REQUIRE(loaded.entity(entities[2].id()).Get<WtPoint>()->x == 100.0f);
+
+        // worlds that have had entities can't load.
+        REQUIRE_THROWS_AS(again.LoadSnapshot(path), std::logic_error);
+    }
+
+    // a component that can't be saved fails before writing, leaving the last snapshot.
+    bent::World world;
+    world.Create().Add<WtNote>(WtNote { "note" });
+    REQUIRE_THROWS_AS(world.SaveSnapshot(path), std::logic_error);
+    bent::World loaded;
+    loaded.LoadSnapshot(path);
+    REQUIRE(loaded.count<WtPoint>() == 4998);
+
+    bent::World archetypes(bent::StorageBackend::Archetypes);
+    archetypes.Create().Add<WtPoint>(WtPoint { 0.0f, 0.0f });
+    REQUIRE_THROWS_AS(archetypes.SaveSnapshot(path), std::logic_error);
+    REQUIRE_THROWS_AS(bent::World(bent::StorageBackend::Archetypes).LoadSnapshot(path), std::logic_error);
+
+    // files that aren't snapshots are rejected, leaving the world empty.
+    std::remove(path);
+    REQUIRE_THROWS_AS(bent::World().LoadSnapshot(path), std::runtime_error);
+    auto file = std::fopen(path, "wb");
+    std::fputs("not a snapshot of a world", file);
+    std::fclose(file);
+    bent::World rejected;
+    REQUIRE_THROWS_AS(rejected.LoadSnapshot(path), std::runtime_error);
+    REQUIRE(rejected.Create().id() == 0);
+    std::remove(path);
+}
+
+TEST_CASE("World loads snapshots whole or not at all", "[world]")
+{
+    // sections run the test again, but components are registered once.
+    static bool registered = []
+    {
+        bent::RegisterComponent<WtPin>("WtPin");
+        bent::RegisterComponent<WtPeg>("WtPeg");
+        bent::RegisterComponent<WtScroll>("WtScroll");
+        bent::RegisterSerializer<WtScroll>([](const WtScroll & scroll, std::string & out)
+        {
+            out += scroll.text;
+        }, [](const char * data, std::size_t size)
+        {
+            if (std::string(data, size) == "cursed")
+            {
+                throw std::invalid_argument("a cursed scroll");
+            }
+            return WtScroll { std::string(data, size) };
+        });
+        return true;
+    }();
+    (void) registered;
+    const char * path = "bent_world_test_whole.snapshot";
+
+    auto save = [&](const char * second)
+    {
+        bent::World world;
+        std::vector<bent::EntityHandle> entities;
+        world.Create(100, std::back_inserter(entities));
+        for (auto & entity : entities)
+        {
+            entity.Add<WtPin>(WtPin { 1.0f, 2.0f });
+        }
+        entities[10].Add<WtScroll>(WtScroll { "first scroll" });
+        entities[20].Add<WtScroll>(WtScroll { second });
+        world.SaveSnapshot(path);
+    };
+    auto check_empty = [](bent::World & world, std::size_t & points_added)
+    {
+        REQUIRE(world.count<WtPin>() == 0);
+        REQUIRE(world.count<WtScroll>() == 0);
+        REQUIRE(world.entities_with<WtPin>().begin() == world.entities_with<WtPin>().end());
+        world.NotifyObservers();
+        REQUIRE(points_added == 0);
+    };
+    auto read_file = [&]
+    {
+        std::string bytes;
+        auto file = std::fopen(path, "rb");
+        char chunk[4096];
+        for (std::size_t n; (n = std::fread(chunk, 1, sizeof(chunk), file)) != 0;)
+        {
+            bytes.append(chunk, n);
+        }
+        std::fclose(file);
+        return bytes;
+    };
+    auto write_file = [&](const std::string & bytes)
+    {
+        auto file = std::fopen(path, "wb");
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+    };
+
+    SECTION("lengths of serialized components are checked before loading")
+    {
+        save("second scroll");
+        auto bytes = read_file();
+        // the first scroll claims bytes of the second one.
+        auto at = bytes.find("first scroll") - sizeof(std::uint64_t);
+        std::uint64_t length = 20;
+        std::memcpy(&bytes[at], &length, sizeof(length));
+        write_file(bytes);
+
+        bent::World loaded;
+        std::size_t points_added = 0;
+        loaded.Observe<WtPin>(bent::ComponentEvent::Add, [&](const std::uint64_t *, std::size_t count)
+        {
+            points_added += count;
+        });
+        REQUIRE_THROWS_AS(loaded.LoadSnapshot(path), std::runtime_error);
+        check_empty(loaded, points_added);
+        REQUIRE(loaded.Create().id() == 0);
+    }
+    SECTION("free lists and records are checked for duplicates before loading")
+    {
+        {
+            bent::World world;
+            std::vector<bent::EntityHandle> entities;
+            world.Create(100, std::back_inserter(entities));
+            for (auto & entity : entities)
+            {
+                entity.Add<WtPin>(WtPin { 1.0f, 2.0f });
+            }
+            entities[30].Destroy();
+            entities[40].Destroy();
+            entities[50].Add<WtPeg>(WtPeg { 3.0f, 4.0f });
+            world.SaveSnapshot(path);
+        }
+        auto bytes = read_file();
+        auto align = [](std::size_t offset)
+        {
+            return (offset + bent::SNAPSHOT_ALIGNMENT - 1) / bent::SNAPSHOT_ALIGNMENT * bent::SNAPSHOT_ALIGNMENT;
+        };
+        auto free = align(align(align(sizeof(bent::SnapshotHeader)) + 100 * sizeof(std::uint32_t)) + 2 * sizeof(std::uint64_t));
+
+        bent::World loaded;
+        std::size_t points_added = 0;
+        loaded.Observe<WtPin>(bent::ComponentEvent::Add, [&](const std::uint64_t *, std::size_t count)
+        {
+            points_added += count;
+        });
+        SECTION("an index freed twice")
+        {
+            std::memcpy(&bytes[free + sizeof(std::uint32_t)], &bytes[free], sizeof(std::uint32_t));
+        }
+        SECTION("a component recorded twice")
+        {
+            auto name = bytes.find("WtPeg");
+            std::memcpy(&bytes[name], "WtPin", 5);
+        }
+        write_file(bytes);
+        REQUIRE_THROWS_AS(loaded.LoadSnapshot(path), std::runtime_error);
+        check_empty(loaded, points_added);
+    }
+    SECTION("entities are unloaded when a serializer throws")
+    {
+        save("cursed");
+        bent::World loaded;
+        auto cached = loaded.cached_query<bent::With<WtPin>>();
+        std::size_t points_added = 0;
+        loaded.Observe<WtPin>(bent::ComponentEvent::Add, [&](const std::uint64_t *, std::size_t count)
+        {
+            points_added += count;
+        });
+        REQUIRE_THROWS_AS(loaded.LoadSnapshot(path), std::invalid_argument);
+        REQUIRE(cached.count() == 0);
+        check_empty(loaded, points_added);
+
+        // the world can load again once the serializer accepts the file.
+        save("second scroll");
+        loaded.LoadSnapshot(path);
+        REQUIRE(loaded.count<WtPin>() == 100);
+        REQUIRE(loaded.count<WtScroll>() == 2);
+    }
+    std::remove(path);
+}